@@ -0,0 +1,65 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/* Compares the insertion modes of the open62541 backend. Every round loads
+ * all given nodesets into a fresh server. E.g.
+ * benchInsertion 5 Opc.Ua.Di.NodeSet2.xml \
+ *     euromap/Opc.Ua.PlasticsRubber.GeneralTypes.NodeSet2.xml \
+ *     euromap/Opc.Ua.PlasticsRubber.IMM2MES.NodeSet2.xml */
+
+#include <open62541/server.h>
+#include <open62541/server_config_default.h>
+
+#include <NodesetLoader/backendOpen62541.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static double
+loadAll(NodesetLoader_InsertionMode mode, int fileCnt, char *files[]) {
+    UA_Server *server = UA_Server_new();
+    UA_ServerConfig_setDefault(UA_Server_getConfig(server));
+
+    NodesetLoader_Options options;
+    memset(&options, 0, sizeof(NodesetLoader_Options));
+    options.insertionMode = mode;
+
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    for(int i = 0; i < fileCnt; i++) {
+        if(!NodesetLoader_loadFileWithOptions(server, files[i], &options)) {
+            printf("nodeset %s could not be loaded\n", files[i]);
+            UA_Server_delete(server);
+            return -1.0;
+        }
+    }
+    double ms = (double)(UA_DateTime_nowMonotonic() - start) / UA_DATETIME_MSEC;
+    UA_Server_delete(server);
+    return ms;
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 3) {
+        printf("usage: benchInsertion <rounds> <nodeset1> [<nodeset2> ...]\n");
+        return 1;
+    }
+    int rounds = atoi(argv[1]);
+    const char *names[2] = {"fused", "threepass"};
+    NodesetLoader_InsertionMode modes[2] = {NODESETLOADER_INSERTION_FUSED,
+                                            NODESETLOADER_INSERTION_THREEPASS};
+    for(size_t m = 0; m < 2; m++) {
+        double best = -1.0;
+        double sum = 0.0;
+        for(int r = 0; r < rounds; r++) {
+            double ms = loadAll(modes[m], argc - 2, &argv[2]);
+            if(ms < 0.0)
+                return 1;
+            sum += ms;
+            if(best < 0.0 || ms < best)
+                best = ms;
+        }
+        printf("%-10s best %10.2f ms  mean %10.2f ms  (%d rounds)\n",
+               names[m], best, sum / rounds, rounds);
+    }
+    return 0;
+}
@@ -10,6 +10,7 @@
 
 #include <open62541/server.h>
 #include "NodesetLoader/Extension.h"
+#include "NodesetLoader/NodesetLoader.h"
 
 #include <stdbool.h>
 #include <stdio.h>
@@ -22,6 +23,187 @@ UA_EXPORT bool
 NodesetLoader_loadFile(struct UA_Server *, const char *path,
                        NodesetLoader_ExtensionInterface *extensionHandling);
 
+// In both modes a node that cannot be added is skipped, the other nodes are
+// added and the import returns false.
+typedef enum {
+    // Three passes over all nodes: begin, references, finish
+    NODESETLOADER_INSERTION_THREEPASS = 0,
+    // Stream once through the sorted nodes. Begin, references and finish are
+    // issued per window of nodes that do not reference later nodes. The
+    // phase times are summed over the windows, the trace has no phase events.
+    NODESETLOADER_INSERTION_FUSED
+} NodesetLoader_InsertionMode;
+
+/* Keeps the xml of large Variable values that are decoded on the first read,
+ * see NodesetLoader_Options.lazyValueThreshold. The decoded values are cached
+ * in the store. It can be shared by several imports and servers and must be
+ * deleted after the servers using it. */
+typedef struct NodesetLoader_ValueStore NodesetLoader_ValueStore;
+
+UA_EXPORT NodesetLoader_ValueStore *
+NodesetLoader_ValueStore_new(void);
+
+UA_EXPORT void
+NodesetLoader_ValueStore_delete(NodesetLoader_ValueStore *store);
+
+typedef struct {
+    NodesetLoader_ExtensionInterface *extensionHandling;
+    NodesetLoader_InsertionMode insertionMode;
+    // Threads to decode the Variable values ahead of the insertion.
+    // 0 starts one thread per CPU.
+    size_t valueDecodeThreads;
+    // Log a summary of the phase timings and counts at the end of the import
+    bool logStats;
+    // Can be NULL. Receives the phase timings and counts of the import.
+    NL_Stats *stats;
+    // Write a Chrome trace JSON of the import to this file (NULL: no trace)
+    const char *tracePath;
+    // Also trace the backend steps of nodes that take at least this long
+    // (0: no node events)
+    UA_DateTime traceSlowNodeThreshold;
+    // The node context is a UA_String* with the raw <Extensions> xml of the
+    // node (or NULL) instead of the parsed extension. Parse it on demand with
+    // NodesetLoader_parseExtensions. The strings of the added nodes belong
+    // to the application, free them with NodesetLoader_deleteRawExtension in
+    // the node destructor of the server. The strings of the nodes that were
+    // not added are freed by the import. With a model or the lazy nodestore
+    // the strings are freed with the model or the server instead.
+    bool captureRawExtensions;
+    // Variables with a <Value> of at least this many bytes of xml get a data
+    // source that decodes the value on the first read (0: all values are
+    // decoded during the import). Requires valueStore. Variables with an
+    // extension keep it as node context and are decoded during the import.
+    size_t lazyValueThreshold;
+    NodesetLoader_ValueStore *valueStore;
+    // Can be NULL. Reports the parsing, the sort and the insertion and
+    // cancels the import if it returns false. Nodes that were added before
+    // the cancellation stay in the server. With the async import it is called
+    // from the worker thread until the file is sorted. For a model, the
+    // inserted nodes of all applies are counted.
+    NL_ProgressCallback progress;
+    void *progressContext;
+} NodesetLoader_Options;
+
+// Options can be NULL for the defaults (all fields zeroed). The DataTypes of
+// the nodeset are added to the config of the server without its lock, so no
+// other thread may use the server during the import: call it before the
+// server runs or from the thread that runs it. The same holds for
+// NodesetLoader_Model_apply and NodesetLoader_loadFileLazy.
+UA_EXPORT bool
+NodesetLoader_loadFileWithOptions(struct UA_Server *, const char *path,
+                                  const NodesetLoader_Options *options);
+
+// Frees the node context of a node imported with captureRawExtensions, e.g.
+// in the destructor of UA_ServerConfig.nodeLifecycle. NULL is ignored.
+UA_EXPORT void
+NodesetLoader_deleteRawExtension(void *nodeContext);
+
+/* Asynchronous import into a running server. The file is parsed and sorted
+ * in a worker thread, then the nodes are added in batches from a repeated
+ * callback of the server, so the server keeps serving clients. The server has
+ * to run (UA_Server_run or UA_Server_run_iterate) until done is called. The
+ * namespaces of the nodeset are added with the first batch; no other
+ * namespaces may be added to the server in the meantime. The values are
+ * decoded when their node is added. The DataTypes are added without the lock
+ * of the server in the callback that starts the insertion, other threads must
+ * not use the server while the server runs its callbacks. */
+typedef void (*NodesetLoader_AsyncProgressCallback)(struct UA_Server *server,
+                                                   void *context,
+                                                   size_t nodesAdded,
+                                                   size_t nodesTotal);
+
+typedef void (*NodesetLoader_AsyncDoneCallback)(struct UA_Server *server,
+                                               void *context, bool success);
+
+typedef struct {
+    // Time the node insertion may take per callback (0: 10 ms)
+    UA_Double budgetMs;
+    // Interval of the repeated callback (0: 50 ms)
+    UA_Double intervalMs;
+    // Called after every batch with the nodes that were added so far, failed
+    // nodes are not counted. Can be NULL.
+    NodesetLoader_AsyncProgressCallback progress;
+    // Called once when the import ended. Can be NULL.
+    NodesetLoader_AsyncDoneCallback done;
+    void *context;
+} NodesetLoader_AsyncOptions;
+
+typedef struct NodesetLoader_AsyncImport NodesetLoader_AsyncImport;
+
+// The options and asyncOptions are copied. The path, the extension interface
+// and the stats and trace targets must stay valid until done is called.
+// Returns NULL if the import could not be started (done is not called). The
+// handle is freed before done is called.
+UA_EXPORT NodesetLoader_AsyncImport *
+NodesetLoader_loadFileAsync(struct UA_Server *, const char *path,
+                            const NodesetLoader_Options *options,
+                            const NodesetLoader_AsyncOptions *asyncOptions);
+
+// Ends an import before done was called, e.g. before the server is deleted.
+// Waits for the parsing thread and removes the callback, done is called with
+// false. Call it from the thread that runs the server and never while
+// UA_Server_run_iterate runs in another thread: the callback could end the
+// import at the same time. NULL is ignored.
+UA_EXPORT void
+NodesetLoader_abortAsync(NodesetLoader_AsyncImport *import);
+
+/* A nodeset that is parsed and sorted once and then inserted into several
+ * servers. Its DataTypes are built and the values decoded once, every apply
+ * only adds the nodes. The nodes, DataTypes, decoded values and extensions are
+ * shared by all servers, so delete the model after them.
+ *
+ * The model is created for the namespaces and DataTypes of the given server,
+ * the namespaces of the nodeset are added to it. The servers the model is
+ * applied to must have the same namespaces in the same order (e.g. the same
+ * configuration and the same models applied before), else apply fails
+ * without adding anything to the server. The options are copied,
+ * the stats and trace accumulate over all applies. The model keeps copies of
+ * the custom DataTypes of the creating server and logs to a server only
+ * during new and apply, so the creating server can be deleted first. */
+typedef struct NodesetLoader_Model NodesetLoader_Model;
+
+// Returns NULL if the file cannot be imported
+UA_EXPORT NodesetLoader_Model *
+NodesetLoader_Model_new(struct UA_Server *, const char *path,
+                        const NodesetLoader_Options *options);
+
+// Add the DataTypes and the nodes of the model to the server
+UA_EXPORT bool
+NodesetLoader_Model_apply(NodesetLoader_Model *model, struct UA_Server *);
+
+UA_EXPORT void
+NodesetLoader_Model_delete(NodesetLoader_Model *model);
+
+/* Lazy nodestore. The Objects, Variables, Methods and Views of a nodeset
+ * loaded with NodesetLoader_loadFileLazy stay in the parsed model and are
+ * inserted into the nodestore when the server accesses them the first time
+ * (read, browse, ...). Their constructors are not called and mandatory
+ * children missing in the nodeset are not instantiated. The other node
+ * classes and the DataTypes are added as with NodesetLoader_loadFile.
+ *
+ * Wraps the nodestore of the config, so call it after
+ * UA_ServerConfig_setDefault and before UA_Server_newWithConfig. The parsed
+ * models are deleted with the server. Returns false if the nodestore plugin
+ * interface of this open62541 version is not supported (only 1.4). */
+UA_EXPORT bool
+NodesetLoader_useLazyNodestore(UA_ServerConfig *config);
+
+// Loads the nodeset as NodesetLoader_loadFileWithOptions if the server does
+// not use the lazy nodestore. insertionMode and valueDecodeThreads are not
+// used, the values are decoded on demand.
+UA_EXPORT bool
+NodesetLoader_loadFileLazy(struct UA_Server *, const char *path,
+                           const NodesetLoader_Options *options);
+
+typedef struct {
+    size_t nodes;        // Indexed instance nodes of all loaded files
+    size_t materialized; // Inserted into the nodestore so far
+} NodesetLoader_LazyStats;
+
+// Returns false if the server does not use the lazy nodestore
+UA_EXPORT bool
+NodesetLoader_getLazyStats(struct UA_Server *, NodesetLoader_LazyStats *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,339 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <open62541/server.h>
+
+#include <NodesetLoader/backendOpen62541.h>
+#include "internal.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#define ASYNC_DEFAULT_BUDGET_MS 10.0
+#define ASYNC_DEFAULT_INTERVAL_MS 50.0
+#define ASYNC_STEPS 3
+
+typedef enum {
+    ASYNC_PARSING,  // The worker thread parses and sorts
+    ASYNC_INSERTING // The server callback adds the nodes
+} AsyncState;
+
+typedef struct {
+    NL_Node **nodes;
+    size_t nodesSize;
+} AsyncWindow;
+
+typedef struct NodesetLoader_AsyncImport {
+    UA_Server *server;
+    char *path;
+    NodesetLoader_Options options;
+    NodesetLoader_AsyncOptions asyncOptions;
+    NodesetLoader_Logger *logger;
+    NodesetLoader *loader;
+    AddNodeContext ctx;
+    UA_UInt64 callbackId;
+    AsyncState state;
+
+    // Worker thread
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+    pthread_mutex_t lock;
+    bool parsed; // Set by the worker under the lock
+#endif
+    bool parseStatus;
+
+    // Insertion position: the step of the node in the window
+    AsyncWindow *windows;
+    size_t windowsSize;
+    size_t windowsCapacity;
+    size_t window;
+    size_t step;
+    size_t node;
+    size_t nodesAdded; // Finished without a failed step
+    size_t nodesTotal;
+} AsyncImport;
+
+typedef bool (*AsyncStep)(AddNodeContext *context, NL_Node *node);
+
+// The steps of the windowed insertion
+static const AsyncStep asyncSteps[ASYNC_STEPS] = {addNodeImpl, addAllRefs,
+                                                  addNodeFinish};
+static const NL_Phase asyncPhases[ASYNC_STEPS] = {
+    NL_PHASE_ADDNODES, NL_PHASE_ADDREFS, NL_PHASE_FINISHNODES};
+
+static void
+AsyncImport_delete(AsyncImport *ai) {
+    free(ai->windows);
+    if(ai->loader)
+        NodesetLoader_delete(ai->loader);
+    AddNodeContext_clear(&ai->ctx);
+    free(ai->logger);
+    free(ai->path);
+#ifndef _WIN32
+    pthread_mutex_destroy(&ai->lock);
+#endif
+    free(ai);
+}
+
+static void
+parseFile(AsyncImport *ai) {
+    bool status = parseAndSort(ai->loader, &ai->ctx, ai->path, &ai->options);
+#ifdef _WIN32
+    ai->parseStatus = status; // Read after the thread ended
+#else
+    pthread_mutex_lock(&ai->lock);
+    ai->parseStatus = status;
+    ai->parsed = true;
+    pthread_mutex_unlock(&ai->lock);
+#endif
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+parseThread(LPVOID ai) {
+    parseFile((AsyncImport *)ai);
+    return 0;
+}
+#else
+static void *
+parseThread(void *ai) {
+    parseFile((AsyncImport *)ai);
+    return NULL;
+}
+#endif
+
+static bool
+startWorker(AsyncImport *ai) {
+#ifdef _WIN32
+    ai->thread = CreateThread(NULL, 0, parseThread, ai, 0, NULL);
+    return (ai->thread != NULL);
+#else
+    return (pthread_create(&ai->thread, NULL, parseThread, ai) == 0);
+#endif
+}
+
+// Joins the worker if it is done
+static bool
+workerDone(AsyncImport *ai) {
+#ifdef _WIN32
+    if(WaitForSingleObject(ai->thread, 0) != WAIT_OBJECT_0)
+        return false;
+    CloseHandle(ai->thread);
+#else
+    pthread_mutex_lock(&ai->lock);
+    bool parsed = ai->parsed;
+    pthread_mutex_unlock(&ai->lock);
+    if(!parsed)
+        return false;
+    pthread_join(ai->thread, NULL);
+#endif
+    return true;
+}
+
+static void
+joinWorker(AsyncImport *ai) {
+#ifdef _WIN32
+    WaitForSingleObject(ai->thread, INFINITE);
+    CloseHandle(ai->thread);
+#else
+    pthread_join(ai->thread, NULL);
+#endif
+}
+
+static bool
+collectWindow(AsyncImport *ai, NL_Node **nodes, size_t nodesSize) {
+    if(ai->windowsSize == ai->windowsCapacity) {
+        size_t capacity = (ai->windowsCapacity > 0) ? 2 * ai->windowsCapacity : 64;
+        AsyncWindow *windows = (AsyncWindow *)
+            realloc(ai->windows, capacity * sizeof(AsyncWindow));
+        if(!windows)
+            return false;
+        ai->windows = windows;
+        ai->windowsCapacity = capacity;
+    }
+    AsyncWindow *w = &ai->windows[ai->windowsSize++];
+    w->nodes = nodes;
+    w->nodesSize = nodesSize;
+    ai->nodesTotal += nodesSize;
+    return true;
+}
+
+// Runs in the server thread once the file is sorted
+static bool
+startInsertion(AsyncImport *ai) {
+    if(!AddNodeContext_addPendingNamespaces(&ai->ctx))
+        return false;
+    NodesetLoader_startPhase(ai->loader, NL_PHASE_DATATYPES);
+    addCustomDataTypes(&ai->ctx, ai->loader);
+    NodesetLoader_stopPhase(ai->loader, NL_PHASE_DATATYPES);
+    if(!NodesetLoader_forEachWindow(ai->loader, ai,
+                                    (NodesetLoader_forEachWindow_Func)collectWindow))
+        return false;
+    // The windows are consecutive slices of the sorted nodes. Three passes
+    // over all nodes are one window.
+    if(ai->options.insertionMode == NODESETLOADER_INSERTION_THREEPASS &&
+       ai->windowsSize > 1) {
+        ai->windows[0].nodesSize = ai->nodesTotal;
+        ai->windowsSize = 1;
+    }
+    ai->state = ASYNC_INSERTING;
+    return true;
+}
+
+// Returns true when all nodes are added or the import is canceled. At least
+// one node is processed per batch.
+static bool
+insertBatch(AsyncImport *ai, UA_DateTime deadline) {
+    bool traceNodes = NodesetLoader_tracesNodes(ai->loader);
+    while(ai->window < ai->windowsSize) {
+        const AsyncWindow *w = &ai->windows[ai->window];
+        NL_Phase phase = asyncPhases[ai->step];
+        NodesetLoader_startPhase(ai->loader, phase);
+        bool outOfTime = false;
+        while(ai->node < w->nodesSize && !outOfTime) {
+            NL_Node *node = w->nodes[ai->node++];
+            UA_DateTime begin = 0;
+            if(traceNodes)
+                begin = UA_DateTime_nowMonotonic();
+            bool res = asyncSteps[ai->step](&ai->ctx, node);
+            if(traceNodes)
+                NodesetLoader_traceNode(ai->loader, node, phase, begin);
+            // As the synchronous insertion, skip the node and fail at the end
+            if(!res)
+                ai->ctx.failedSteps++;
+            bool last = (ai->step == ASYNC_STEPS - 1);
+            if(last && res)
+                ai->nodesAdded++;
+            if(!NodesetLoader_reportStep(ai->loader, (last && res) ? 1 : 0)) {
+                NodesetLoader_stopPhase(ai->loader, phase);
+                return true;
+            }
+            outOfTime = (UA_DateTime_nowMonotonic() >= deadline);
+        }
+        NodesetLoader_stopPhase(ai->loader, phase);
+        if(ai->node < w->nodesSize)
+            return false;
+        ai->node = 0;
+        if(++ai->step == ASYNC_STEPS) {
+            ai->step = 0;
+            ai->window++;
+        }
+        if(outOfTime)
+            return (ai->window == ai->windowsSize);
+    }
+    return true;
+}
+
+static void
+finishAsync(AsyncImport *ai, bool status) {
+    UA_Server_removeCallback(ai->server, ai->callbackId);
+    if(!status)
+        ai->logger->log(ai->logger->context, NODESETLOADER_LOGLEVEL_ERROR,
+                        "Importing the nodeset failed");
+    finishImport(ai->loader, ai->logger, &ai->options);
+    if(ai->ctx.rawExtensions)
+        RawExtensions_handOver(ai->server, ai->loader);
+    UA_Server *server = ai->server;
+    NodesetLoader_AsyncOptions asyncOptions = ai->asyncOptions;
+    AsyncImport_delete(ai);
+    if(asyncOptions.done)
+        asyncOptions.done(server, asyncOptions.context, status);
+}
+
+static void
+asyncTick(UA_Server *server, void *data) {
+    AsyncImport *ai = (AsyncImport *)data;
+    if(ai->state == ASYNC_PARSING) {
+        if(!workerDone(ai))
+            return;
+        if(!ai->parseStatus || !startInsertion(ai)) {
+            finishAsync(ai, false);
+            return;
+        }
+    }
+
+    UA_DateTime budget =
+        (UA_DateTime)(ai->asyncOptions.budgetMs * (UA_Double)UA_DATETIME_MSEC);
+    bool done = insertBatch(ai, UA_DateTime_nowMonotonic() + budget);
+    if(ai->asyncOptions.progress)
+        ai->asyncOptions.progress(server, ai->asyncOptions.context,
+                                  ai->nodesAdded, ai->nodesTotal);
+    if(done)
+        finishAsync(ai, NodesetLoader_reportProgress(ai->loader) &&
+                            checkFailedSteps(&ai->ctx));
+}
+
+NodesetLoader_AsyncImport *
+NodesetLoader_loadFileAsync(struct UA_Server *server, const char *path,
+                            const NodesetLoader_Options *options,
+                            const NodesetLoader_AsyncOptions *asyncOptions) {
+    if(!server || !path)
+        return NULL;
+    AsyncImport *ai = (AsyncImport *)calloc(1, sizeof(AsyncImport));
+    if(!ai)
+        return NULL;
+#ifndef _WIN32
+    pthread_mutex_init(&ai->lock, NULL);
+#endif
+    if(options)
+        ai->options = *options;
+    if(asyncOptions)
+        ai->asyncOptions = *asyncOptions;
+    if(ai->asyncOptions.budgetMs <= 0)
+        ai->asyncOptions.budgetMs = ASYNC_DEFAULT_BUDGET_MS;
+    if(ai->asyncOptions.intervalMs <= 0)
+        ai->asyncOptions.intervalMs = ASYNC_DEFAULT_INTERVAL_MS;
+    ai->server = server;
+    size_t pathLen = strlen(path);
+    ai->path = (char *)malloc(pathLen + 1);
+    ai->logger = newLogger(server);
+    if(ai->logger)
+        ai->loader = NodesetLoader_new(ai->logger);
+    if(!ai->path || !ai->loader) {
+        AsyncImport_delete(ai);
+        return NULL;
+    }
+    memcpy(ai->path, path, pathLen + 1);
+
+    // Everything that reads the server is done here, the worker only parses
+    AddNodeContext_init(&ai->ctx, server, ai->logger);
+    ai->ctx.serverNamespacesSize = ai->ctx.nsMapping.namespaceUrisSize;
+    ai->ctx.deferNamespaces = true;
+    ai->ctx.valueStore = ai->options.valueStore;
+    ai->ctx.lazyValueThreshold = ai->options.lazyValueThreshold;
+    prepareImport(ai->loader, server, &ai->options);
+
+    if(!startWorker(ai)) {
+        AsyncImport_delete(ai);
+        return NULL;
+    }
+    // The callback may end the import in another thread right away, ai is not
+    // touched afterwards
+    if(UA_Server_addRepeatedCallback(server, asyncTick, ai,
+                                     ai->asyncOptions.intervalMs,
+                                     &ai->callbackId) != UA_STATUSCODE_GOOD) {
+        joinWorker(ai);
+        AsyncImport_delete(ai);
+        return NULL;
+    }
+    return ai;
+}
+
+void
+NodesetLoader_abortAsync(NodesetLoader_AsyncImport *ai) {
+    if(!ai)
+        return;
+    // The parser cannot be interrupted, wait for it
+    if(ai->state == ASYNC_PARSING)
+        joinWorker(ai);
+    ai->logger->log(ai->logger->context, NODESETLOADER_LOGLEVEL_WARNING,
+                    "The import was aborted");
+    finishAsync(ai, false);
+}
@@ -6,56 +6,52 @@
  */
 
 #include "internal.h"
+#include "NodeIdMap.h"
 
 #include <assert.h>
 
-static UA_NodeId
-getBinaryEncodingId(const NL_DataTypeNode *node) {
-    UA_NodeId encodingRefType = UA_NODEID_NUMERIC(0, 38);
-    for(NL_Reference *ref = node->refs; ref; ref = ref->next) {
-        if(!UA_NodeId_equal(&encodingRefType, &ref->refType))
-            continue;
-        if(!ref->targetPtr)
-            continue;
-        UA_String binaryStr = UA_STRING("Default Binary");
-        if(!UA_String_equal(&ref->targetPtr->browseName.name, &binaryStr))
-            continue;
-        UA_NodeId idCopy;
-        UA_NodeId_copy(&ref->target, &idCopy);
-        return idCopy;
-    }
-    return UA_NODEID_NULL;
-}
+// Types that are built in one batch and added to the server together. The
+// array is allocated for all types up front, so members can point to types
+// earlier in the same batch.
+typedef struct {
+    AddNodeContext *ctx;
+    UA_DataType *types;
+    size_t typesSize;
+    size_t typesCapacity;
+    // Resolved types, the types of the batch are added when they are built.
+    // Saves walking the server's type arrays for every member.
+    NodeIdMap resolved;
+} TypeBatch;
 
-static UA_NodeId
-getXmlEncodingId(const NL_DataTypeNode *node) {
-    UA_NodeId encodingRefType = UA_NODEID_NUMERIC(0, 38);
-    for(NL_Reference *ref = node->refs; ref; ref = ref->next) {
-        if(!UA_NodeId_equal(&encodingRefType, &ref->refType))
-            continue;
-        if(!ref->targetPtr)
-            continue;
-        UA_String xmlStr = UA_STRING("Default XML");
-        if(!UA_String_equal(&ref->targetPtr->browseName.name, &xmlStr))
-            continue;
-        UA_NodeId idCopy;
-        UA_NodeId_copy(&ref->target, &idCopy);
-        return idCopy;
-    }
-    return UA_NODEID_NULL;
+static const UA_DataType *
+getDataType(TypeBatch *batch, const UA_NodeId *id) {
+    const UA_DataType *type =
+        (const UA_DataType *)NodeIdMap_get(&batch->resolved, id);
+    if(type)
+        return type;
+    type = UA_Server_findDataType(batch->ctx->server, id);
+    if(type)
+        NodeIdMap_insert(&batch->resolved, id, (void *)(uintptr_t)type);
+    return type;
 }
 
-static const UA_DataType *
-getDataType(AddNodeContext *ctx, const UA_NodeId *id) {
-    return UA_Server_findDataType(ctx->server, id);
+static char *
+copyName(const char *name) {
+    size_t nameLen = strlen(name);
+    char *copy = (char *)UA_calloc(1, nameLen + 1);
+    if(copy)
+        memcpy(copy, name, nameLen);
+    return copy;
 }
 
+// The padding, memSize, pointerFree and overlayable flags of structured types
+// are computed afterwards by setDataTypeLayout
 static UA_StatusCode
-addDataTypeMembers(AddNodeContext *ctx, UA_DataType *type,
+addDataTypeMembers(TypeBatch *batch, UA_DataType *type,
                    const NL_DataTypeNode *node,
                    const UA_NodeId *parent) {
     // Get the parent type
-    const UA_DataType *parentType = getDataType(ctx, parent);
+    const UA_DataType *parentType = getDataType(batch, parent);
     size_t memberSize = 0;
     if(node->definition)
         memberSize += node->definition->fieldCnt;
@@ -75,27 +71,14 @@ addDataTypeMembers(AddNodeContext *ctx, UA_DataType *type,
         for(; i < parentType->membersSize; i++) {
             const UA_DataTypeMember *src = &parentType->members[i];
             UA_DataTypeMember *dst = &type->members[i];
-            size_t nameLen = strlen(src->memberName);
-            char *memberName = (char *)UA_calloc(1, nameLen + 1);
-            memcpy(memberName, src->memberName, nameLen);
-            dst->memberName = memberName;
+            dst->memberName = copyName(src->memberName);
             dst->memberType = src->memberType;
-
-            // Pointer free??
-            if(!dst->memberType->pointerFree)
-                type->pointerFree = false;
-
-            // Array?
             dst->isArray = src->isArray;
-            if(dst->isArray)
-                type->pointerFree = false;
 
             // Optional?
             dst->isOptional = src->isOptional;
-            if(dst->isOptional) {
-                type->pointerFree = false;
+            if(dst->isOptional)
                 type->typeKind = UA_DATATYPEKIND_OPTSTRUCT;
-            }
         }
     }
 
@@ -104,43 +87,31 @@ addDataTypeMembers(AddNodeContext *ctx, UA_DataType *type,
         UA_DataTypeMember *member = &type->members[i];
         NL_DataTypeDefinitionField *field = &node->definition->fields[j];
 
-        // Member name
-        size_t nameLen = strlen(field->name);
-        char *memberName = (char *)UA_calloc(1, nameLen + 1);
-        memcpy(memberName, field->name, nameLen);
-        member->memberName = memberName;
+        member->memberName = copyName(field->name);
 
         // Member type
-        member->memberType = getDataType(ctx, &field->dataType);
+        member->memberType = getDataType(batch, &field->dataType);
         if(!member->memberType) {
-            ctx->logger->log(ctx->logger->context, NODESETLOADER_LOGLEVEL_WARNING,
-                             "Cannot find member type %N of datatype %N",
-                             field->dataType, type->typeId);
+            NodesetLoader_Logger *logger = batch->ctx->logger;
+            logger->log(logger->context, NODESETLOADER_LOGLEVEL_WARNING,
+                        "Cannot find member type %N of datatype %N",
+                        field->dataType, type->typeId);
             return UA_STATUSCODE_BADINTERNALERROR;
         }
 
-        // Pointer free??
-        if(!member->memberType->pointerFree)
-            type->pointerFree = false;
-
-        // Array?
         member->isArray = (field->valueRank >= 0);
-        if(member->isArray)
-            type->pointerFree = false;
 
         // Optional?
         member->isOptional = field->isOptional;
-        if(member->isOptional) {
-            type->pointerFree = false;
+        if(member->isOptional)
             type->typeKind = UA_DATATYPEKIND_OPTSTRUCT;
-        }
     }
 
     return UA_STATUSCODE_GOOD;
 }
 
 static UA_StatusCode
-StructureDataType_init(AddNodeContext *ctx, UA_DataType *type,
+StructureDataType_init(TypeBatch *batch, UA_DataType *type,
                        const NL_DataTypeNode *node,
                        const UA_NodeId *parent) {
     if(node->definition->isUnion) {
@@ -148,15 +119,11 @@ StructureDataType_init(AddNodeContext *ctx, UA_DataType *type,
     } else {
         type->typeKind = UA_DATATYPEKIND_STRUCTURE;
     }
-    type->typeId = node->id;
-    type->pointerFree = true; // Gets overridden if necessary
-    type->overlayable = false;
-    return addDataTypeMembers(ctx, type, node, parent);
+    return addDataTypeMembers(batch, type, node, parent);
 }
 
 static UA_StatusCode
-addEnumMembers(AddNodeContext *ctx, UA_DataType *type,
-               const NL_DataTypeNode *node) {
+addEnumMembers(UA_DataType *type, const NL_DataTypeNode *node) {
     if(node->definition->fieldCnt == 0)
         return UA_STATUSCODE_GOOD;
 
@@ -172,16 +139,13 @@ addEnumMembers(AddNodeContext *ctx, UA_DataType *type,
         UA_DataTypeMember *member = &type->members[i];
         NL_DataTypeDefinitionField *field = &node->definition->fields[i];
         member->memberType = (const UA_DataType*)(uintptr_t)field->value;
-        size_t nameLen = strlen(field->name);
-        char *memberName = (char *)UA_calloc(1, nameLen + 1);
-        memcpy(memberName, field->name, nameLen);
-        member->memberName = memberName;
+        member->memberName = copyName(field->name);
     }
     return UA_STATUSCODE_GOOD;
 }
 
 static UA_StatusCode
-EnumDataType_init(AddNodeContext *ctx, UA_DataType *enumType,
+EnumDataType_init(TypeBatch *batch, UA_DataType *enumType,
                   const NL_DataTypeNode *node,
                   const UA_NodeId *parent) {
     enumType->typeKind = UA_DATATYPEKIND_ENUM;
@@ -189,21 +153,21 @@ EnumDataType_init(AddNodeContext *ctx, UA_DataType *enumType,
     enumType->overlayable = UA_BINARY_OVERLAYABLE_INTEGER;
     enumType->memSize = sizeof(UA_Int32);
     if(node->definition->isOptionSet) {
-        const UA_DataType *parentType = getDataType(ctx, parent);
+        const UA_DataType *parentType = getDataType(batch, parent);
         if(parentType && parentType->typeKind <= UA_DATATYPEKIND_DOUBLE) {
             enumType->typeKind = parentType->typeKind;
             enumType->overlayable = parentType->overlayable;
             enumType->memSize = parentType->memSize;
         }
     }
-    return addEnumMembers(ctx, enumType, node);
+    return addEnumMembers(enumType, node);
 }
 
 static UA_StatusCode
-SubtypeOfBase_init(AddNodeContext *ctx,
+SubtypeOfBase_init(TypeBatch *batch,
                    UA_DataType *type, const NL_DataTypeNode *node,
                    const UA_NodeId *parent) {
-    const UA_DataType *parentType = getDataType(ctx, parent);
+    const UA_DataType *parentType = getDataType(batch, parent);
     if(!parentType)
         return UA_STATUSCODE_BADINTERNALERROR;
     type->memSize = parentType->memSize;
@@ -213,63 +177,205 @@ SubtypeOfBase_init(AddNodeContext *ctx,
     if(parentType->typeKind == UA_DATATYPEKIND_STRUCTURE ||
        parentType->typeKind == UA_DATATYPEKIND_OPTSTRUCT ||
        parentType->typeKind == UA_DATATYPEKIND_UNION) {
-        return addDataTypeMembers(ctx, type, node, parent);
+        return addDataTypeMembers(batch, type, node, parent);
     } else {
         type->binaryEncodingId = parentType->binaryEncodingId;
     }
     return UA_STATUSCODE_GOOD;
 }
 
-void
-addCustomDataType(AddNodeContext *ctx, const NL_DataTypeNode *node) {
-    UA_DataType type;
-    memset(&type, 0, sizeof(UA_DataType));
+// Build the type with the members
+static UA_StatusCode
+buildDataType(TypeBatch *batch, UA_DataType *type,
+              const NL_DataTypeNode *node) {
+    memset(type, 0, sizeof(UA_DataType));
 
-    UA_NodeId_copy(&node->id, &type.typeId);
+    UA_NodeId_copy(&node->id, &type->typeId);
 
     size_t len = node->browseName.name.length;
-    type.typeName = (char *)calloc(len + 1, sizeof(char));
-    memcpy((void*)(uintptr_t)type.typeName, node->browseName.name.data, len);
+    type->typeName = (char *)calloc(len + 1, sizeof(char));
+    memcpy((void*)(uintptr_t)type->typeName, node->browseName.name.data, len);
 
-    UA_NodeId tmp = getBinaryEncodingId(node);
-    UA_NodeId_copy(&tmp, &type.binaryEncodingId);
-    tmp = getXmlEncodingId(node);
-    UA_NodeId_copy(&tmp, &type.xmlEncodingId);
+    // The encodings are resolved by NodesetLoader_sort
+    UA_NodeId_copy(&node->binaryEncodingId, &type->binaryEncodingId);
+    UA_NodeId_copy(&node->xmlEncodingId, &type->xmlEncodingId);
 
-    UA_StatusCode res;
-    UA_ExtensionObject eo;
-    UA_NodeId parent = getParentId(ctx, (const NL_Node*)node, NULL);
+    UA_NodeId parent = getParentId((const NL_Node*)node, NULL);
 
     if(node->definition &&
        (node->definition->isEnum ||
         node->definition->isOptionSet)) {
         // Enum and OptionSet
-        res = EnumDataType_init(ctx, &type, node, &parent);
-    } else if(node->definition && node->definition->fieldCnt > 0) {
+        return EnumDataType_init(batch, type, node, &parent);
+    }
+    if(node->definition && node->definition->fieldCnt > 0) {
         // Structure and Union
-        res = StructureDataType_init(ctx, &type, node, &parent);
-    } else {
-        // Opaque subtype
-        res = SubtypeOfBase_init(ctx, &type, node, &parent);
+        return StructureDataType_init(batch, type, node, &parent);
     }
-    if(res != UA_STATUSCODE_GOOD)
-        goto cleanup;
-
-    // Convert type to description. This generates the correct padding between
-    // member fields in UA_Server_addDataTypeFromDescription.
+    // Opaque subtype
+    return SubtypeOfBase_init(batch, type, node, &parent);
+}
 
-    res = UA_DataType_toDescription(&type, &eo);
-    if(res != UA_STATUSCODE_GOOD)
-        goto cleanup;
+static void
+logDataTypeError(AddNodeContext *ctx, const NL_DataTypeNode *node,
+                 UA_StatusCode res) {
+    ctx->logger->log(ctx->logger->context, NODESETLOADER_LOGLEVEL_WARNING,
+                     "Cannot create datatype %Ni (%s)",
+                     node->id, UA_StatusCode_name(res));
+}
 
-    UA_Server_addDataTypeFromDescription(ctx->server, &eo);
-    UA_ExtensionObject_clear(&eo);
+static bool
+countDataType(TypeBatch *batch, NL_Node *node) {
+    if(node->nodeClass == NODECLASS_DATATYPE)
+        batch->typesCapacity++;
+    return true;
+}
 
- cleanup:
+// Build the type and compute its layout in the next slot of the batch
+static bool
+addToBatch(TypeBatch *batch, NL_Node *node) {
+    if(node->nodeClass != NODECLASS_DATATYPE)
+        return true;
+    const NL_DataTypeNode *dtNode = (const NL_DataTypeNode *)node;
+
+    UA_DataType *type = &batch->types[batch->typesSize];
+    UA_StatusCode res = buildDataType(batch, type, dtNode);
+    if(res == UA_STATUSCODE_GOOD)
+        res = setDataTypeLayout(type);
     if(res != UA_STATUSCODE_GOOD) {
-        ctx->logger->log(ctx->logger->context, NODESETLOADER_LOGLEVEL_WARNING,
-                         "Cannot create datatype description for %Ni (%s)",
-                         node->id, UA_StatusCode_name(res));
+        logDataTypeError(batch->ctx, dtNode, res);
+        UA_DataType_clear(type);
+        memset(type, 0, sizeof(UA_DataType));
+        return true;
+    }
+    NodeIdMap_insert(&batch->resolved, &type->typeId, type);
+    batch->typesSize++;
+    return true;
+}
+
+size_t
+buildCustomDataTypes(AddNodeContext *ctx, NodesetLoader *loader,
+                     UA_DataType **types) {
+    *types = NULL;
+    TypeBatch batch;
+    memset(&batch, 0, sizeof(TypeBatch));
+    batch.ctx = ctx;
+    NodesetLoader_forEachNode(loader, &batch,
+                              (NodesetLoader_forEachNode_Func)countDataType);
+    if(batch.typesCapacity == 0)
+        return 0;
+    batch.types = (UA_DataType *)
+        calloc(batch.typesCapacity, sizeof(UA_DataType));
+    if(!batch.types)
+        return 0;
+    if(!NodeIdMap_init(&batch.resolved, batch.typesCapacity)) {
+        free(batch.types);
+        return 0;
+    }
+    NodesetLoader_forEachNode(loader, &batch,
+                              (NodesetLoader_forEachNode_Func)addToBatch);
+    NodeIdMap_clear(&batch.resolved);
+    if(batch.typesSize == 0) {
+        free(batch.types);
+        return 0;
+    }
+    *types = batch.types;
+    return batch.typesSize;
+}
+
+static bool
+containsType(const UA_DataType *types, size_t typesSize, const UA_DataType *t) {
+    return typesSize > 0 && t >= types && t < types + typesSize;
+}
+
+// Point the members that use a type of the server to the copy of the type
+static void
+remapMembers(UA_DataType *types, size_t typesSize, const UA_DataType *copies,
+             size_t copiesSize, const NodeIdMap *byId) {
+    for(size_t i = 0; i < typesSize; i++) {
+        for(size_t m = 0; m < types[i].membersSize; m++) {
+            UA_DataTypeMember *member = &types[i].members[m];
+            const UA_DataType *t = member->memberType;
+            if(!t || containsType(UA_TYPES, UA_TYPES_COUNT, t) ||
+               containsType(types, typesSize, t) ||
+               containsType(copies, copiesSize, t))
+                continue;
+            const UA_DataType *copy =
+                (const UA_DataType *)NodeIdMap_get(byId, &t->typeId);
+            if(copy)
+                member->memberType = copy;
+        }
+    }
+}
+
+bool
+copyServerDataTypes(UA_Server *server, UA_DataType *types, size_t typesSize,
+                    UA_DataType **copies, size_t *copiesSize) {
+    *copies = NULL;
+    *copiesSize = 0;
+    size_t capacity = 0;
+    for(const UA_DataTypeArray *a = UA_Server_getDataTypes(server); a;
+        a = a->next)
+        capacity += a->typesSize;
+    if(capacity == 0)
+        return true;
+    UA_DataType *c = (UA_DataType *)calloc(capacity, sizeof(UA_DataType));
+    NodeIdMap byId;
+    if(!c || !NodeIdMap_init(&byId, capacity)) {
+        free(c);
+        return false;
+    }
+    // The first type of an id is found by the server, keep only that one
+    size_t n = 0;
+    for(const UA_DataTypeArray *a = UA_Server_getDataTypes(server); a;
+        a = a->next) {
+        for(size_t i = 0; i < a->typesSize; i++) {
+            if(NodeIdMap_contains(&byId, &a->types[i].typeId))
+                continue;
+            if(UA_DataType_copy(&a->types[i], &c[n]) != UA_STATUSCODE_GOOD) {
+                for(size_t j = 0; j < n; j++)
+                    UA_DataType_clear(&c[j]);
+                free(c);
+                NodeIdMap_clear(&byId);
+                return false;
+            }
+            NodeIdMap_insert(&byId, &c[n].typeId, &c[n]);
+            n++;
+        }
+    }
+    remapMembers(c, n, c, n, &byId);
+    remapMembers(types, typesSize, c, n, &byId);
+    NodeIdMap_clear(&byId);
+    *copies = c;
+    *copiesSize = n;
+    return true;
+}
+
+void
+prependCustomDataTypes(UA_Server *server, UA_DataTypeArray *array,
+                       UA_DataType *types, size_t typesSize, bool cleanup) {
+    UA_ServerConfig *config = UA_Server_getConfig(server);
+    UA_DataTypeArray init = {config->customDataTypes, typesSize, types,
+                             cleanup};
+    memcpy(array, &init, sizeof(UA_DataTypeArray));
+    config->customDataTypes = array;
+}
+
+void
+addCustomDataTypes(AddNodeContext *ctx, NodesetLoader *loader) {
+    UA_DataType *types = NULL;
+    size_t typesSize = buildCustomDataTypes(ctx, loader, &types);
+    if(typesSize == 0)
+        return;
+
+    // Prepend all types as one array. The server frees it on shutdown.
+    UA_DataTypeArray *array =
+        (UA_DataTypeArray *)calloc(1, sizeof(UA_DataTypeArray));
+    if(!array) {
+        for(size_t i = 0; i < typesSize; i++)
+            UA_DataType_clear(&types[i]);
+        free(types);
+        return;
     }
-    UA_DataType_clear(&type);
+    prependCustomDataTypes(ctx->server, array, types, typesSize, true);
 }
@@ -0,0 +1,203 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "internal.h"
+
+#include <stddef.h>
+
+/* Computes the memory layout of custom structured types the same way the C
+ * compiler lays out the structs generated for open62541. Arrays are stored as
+ * a size_t length followed by a pointer, optional scalars as a pointer. Unions
+ * start with the UInt32 switch field; the padding of union members includes
+ * the switch field. */
+
+#define ALIGNMENT_STRUCT(T)                                                   \
+    typedef struct {                                                          \
+        char c;                                                               \
+        T t;                                                                  \
+    } Align_##T
+#define ALIGNMENT(T) offsetof(Align_##T, t)
+
+typedef void *UA_Pointer;
+
+ALIGNMENT_STRUCT(UA_UInt16);
+ALIGNMENT_STRUCT(UA_UInt32);
+ALIGNMENT_STRUCT(UA_Int64);
+ALIGNMENT_STRUCT(UA_Float);
+ALIGNMENT_STRUCT(UA_Double);
+ALIGNMENT_STRUCT(UA_Guid);
+ALIGNMENT_STRUCT(UA_String);
+ALIGNMENT_STRUCT(UA_NodeId);
+ALIGNMENT_STRUCT(UA_ExpandedNodeId);
+ALIGNMENT_STRUCT(UA_QualifiedName);
+ALIGNMENT_STRUCT(UA_LocalizedText);
+ALIGNMENT_STRUCT(UA_ExtensionObject);
+ALIGNMENT_STRUCT(UA_DataValue);
+ALIGNMENT_STRUCT(UA_Variant);
+ALIGNMENT_STRUCT(UA_DiagnosticInfo);
+ALIGNMENT_STRUCT(size_t);
+ALIGNMENT_STRUCT(UA_Pointer);
+
+static size_t
+maxSize(size_t a, size_t b) {
+    return (a > b) ? a : b;
+}
+
+static size_t
+alignUp(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+// Length and pointer of an array member
+static size_t
+arrayAlignment(void) {
+    return maxSize(ALIGNMENT(size_t), ALIGNMENT(UA_Pointer));
+}
+
+static size_t
+typeAlignment(const UA_DataType *type);
+
+static size_t
+memberAlignment(const UA_DataTypeMember *m) {
+    if(m->isArray)
+        return arrayAlignment();
+    if(m->isOptional)
+        return ALIGNMENT(UA_Pointer);
+    return typeAlignment(m->memberType);
+}
+
+static size_t
+memberSize(const UA_DataTypeMember *m) {
+    if(m->isArray)
+        return sizeof(size_t) + sizeof(void *);
+    if(m->isOptional)
+        return sizeof(void *);
+    return m->memberType->memSize;
+}
+
+static size_t
+typeAlignment(const UA_DataType *type) {
+    switch(type->typeKind) {
+    case UA_DATATYPEKIND_BOOLEAN:
+    case UA_DATATYPEKIND_SBYTE:
+    case UA_DATATYPEKIND_BYTE:
+        return 1;
+    case UA_DATATYPEKIND_INT16:
+    case UA_DATATYPEKIND_UINT16:
+        return ALIGNMENT(UA_UInt16);
+    case UA_DATATYPEKIND_INT32:
+    case UA_DATATYPEKIND_UINT32:
+    case UA_DATATYPEKIND_STATUSCODE:
+    case UA_DATATYPEKIND_ENUM:
+        return ALIGNMENT(UA_UInt32);
+    case UA_DATATYPEKIND_INT64:
+    case UA_DATATYPEKIND_UINT64:
+    case UA_DATATYPEKIND_DATETIME:
+        return ALIGNMENT(UA_Int64);
+    case UA_DATATYPEKIND_FLOAT:
+        return ALIGNMENT(UA_Float);
+    case UA_DATATYPEKIND_DOUBLE:
+        return ALIGNMENT(UA_Double);
+    case UA_DATATYPEKIND_GUID:
+        return ALIGNMENT(UA_Guid);
+    case UA_DATATYPEKIND_STRING:
+    case UA_DATATYPEKIND_BYTESTRING:
+    case UA_DATATYPEKIND_XMLELEMENT:
+        return ALIGNMENT(UA_String);
+    case UA_DATATYPEKIND_NODEID:
+        return ALIGNMENT(UA_NodeId);
+    case UA_DATATYPEKIND_EXPANDEDNODEID:
+        return ALIGNMENT(UA_ExpandedNodeId);
+    case UA_DATATYPEKIND_QUALIFIEDNAME:
+        return ALIGNMENT(UA_QualifiedName);
+    case UA_DATATYPEKIND_LOCALIZEDTEXT:
+        return ALIGNMENT(UA_LocalizedText);
+    case UA_DATATYPEKIND_EXTENSIONOBJECT:
+        return ALIGNMENT(UA_ExtensionObject);
+    case UA_DATATYPEKIND_DATAVALUE:
+        return ALIGNMENT(UA_DataValue);
+    case UA_DATATYPEKIND_VARIANT:
+        return ALIGNMENT(UA_Variant);
+    case UA_DATATYPEKIND_DIAGNOSTICINFO:
+        return ALIGNMENT(UA_DiagnosticInfo);
+    case UA_DATATYPEKIND_STRUCTURE:
+    case UA_DATATYPEKIND_OPTSTRUCT:
+    case UA_DATATYPEKIND_UNION: {
+        size_t alignment = 1;
+        if(type->typeKind == UA_DATATYPEKIND_UNION)
+            alignment = ALIGNMENT(UA_UInt32);
+        for(size_t i = 0; i < type->membersSize; i++)
+            alignment = maxSize(alignment, memberAlignment(&type->members[i]));
+        return alignment;
+    }
+    default:
+        return maxSize(arrayAlignment(), ALIGNMENT(UA_Int64));
+    }
+}
+
+static UA_StatusCode
+setMemberPadding(UA_DataTypeMember *m, size_t padding) {
+    // The padding is a 6 bit field
+    if(padding > 63)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    m->padding = (UA_Byte)(padding & 0x3f);
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+setDataTypeLayout(UA_DataType *type) {
+    if(type->typeKind != UA_DATATYPEKIND_STRUCTURE &&
+       type->typeKind != UA_DATATYPEKIND_OPTSTRUCT &&
+       type->typeKind != UA_DATATYPEKIND_UNION)
+        return UA_STATUSCODE_GOOD;
+
+    bool pointerFree = true;
+    bool overlayable = (type->typeKind == UA_DATATYPEKIND_STRUCTURE);
+    size_t offset = 0;
+    UA_StatusCode res = UA_STATUSCODE_GOOD;
+
+    if(type->typeKind == UA_DATATYPEKIND_UNION) {
+        // All members start behind the switch field
+        size_t fieldsAlignment = 1;
+        for(size_t i = 0; i < type->membersSize; i++)
+            fieldsAlignment = maxSize(fieldsAlignment,
+                                      memberAlignment(&type->members[i]));
+        size_t start = alignUp(sizeof(UA_UInt32), fieldsAlignment);
+        offset = start;
+        for(size_t i = 0; i < type->membersSize; i++) {
+            UA_DataTypeMember *m = &type->members[i];
+            res |= setMemberPadding(m, start);
+            offset = maxSize(offset, start + memberSize(m));
+        }
+    }
+
+    for(size_t i = 0;
+        type->typeKind != UA_DATATYPEKIND_UNION && i < type->membersSize; i++) {
+        UA_DataTypeMember *m = &type->members[i];
+        size_t aligned = alignUp(offset, memberAlignment(m));
+        res |= setMemberPadding(m, aligned - offset);
+        if(m->isArray || m->isOptional || aligned != offset ||
+           !m->memberType->overlayable)
+            overlayable = false;
+        offset = aligned + memberSize(m);
+    }
+
+    for(size_t i = 0; i < type->membersSize; i++) {
+        const UA_DataTypeMember *m = &type->members[i];
+        if(m->isArray || m->isOptional || !m->memberType->pointerFree)
+            pointerFree = false;
+    }
+
+    size_t memSize = alignUp(offset, typeAlignment(type));
+    if(memSize != offset)
+        overlayable = false;
+    // The memSize is a 16 bit field
+    if(memSize > 0xffff || res != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    type->memSize = (UA_UInt32)memSize & 0xffff;
+    type->pointerFree = pointerFree;
+    type->overlayable = overlayable;
+    return UA_STATUSCODE_GOOD;
+}
@@ -0,0 +1,683 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <open62541/plugin/nodestore.h>
+#include <open62541/server.h>
+
+#include <NodesetLoader/backendOpen62541.h>
+#include "internal.h"
+
+bool
+LazyNodestore_isLazyNodeClass(NL_NodeClass nodeClass) {
+    return nodeClass == NODECLASS_OBJECT || nodeClass == NODECLASS_VARIABLE ||
+           nodeClass == NODECLASS_METHOD || nodeClass == NODECLASS_VIEW;
+}
+
+// The nodestore plugin interface differs between the open62541 versions
+#if UA_OPEN62541_VER_MAJOR == 1 && UA_OPEN62541_VER_MINOR == 4
+
+// A parsed nodeset. The nodes point into the loader.
+typedef struct LazyModel {
+    NodesetLoader *loader;
+    AddNodeContext ctx; // To decode the values
+    struct LazyModel *next;
+} LazyModel;
+
+// A reference of another node that targets a pending node. It is added in the
+// inverse direction when the pending node is materialized.
+typedef struct LazyIncoming {
+    const NL_Node *source;
+    const NL_Reference *ref;
+    struct LazyIncoming *next;
+} LazyIncoming;
+
+#define LAZY_INCOMING_BLOCKSIZE 4096
+
+typedef struct LazyIncomingBlock {
+    struct LazyIncomingBlock *next;
+    size_t used;
+    LazyIncoming refs[LAZY_INCOMING_BLOCKSIZE];
+} LazyIncomingBlock;
+
+typedef struct {
+    NL_Node *node; // NULL for a free slot
+    UA_UInt32 hash;
+    bool pending; // Not yet inserted into the inner nodestore
+    LazyModel *model;
+    LazyIncoming *incoming;
+} LazyEntry;
+
+struct LazyNodestore {
+    UA_Nodestore inner;
+    // Open addressing by the NodeId hash
+    LazyEntry *entries;
+    size_t entriesSize;
+    size_t capacity;
+    size_t materialized;
+    LazyIncomingBlock *blocks;
+    LazyModel *models;
+};
+
+static const UA_NodeId hasTypeDefinition =
+    {0, UA_NODEIDTYPE_NUMERIC, {UA_NS0ID_HASTYPEDEFINITION}};
+
+static LazyEntry *
+findEntry(LazyEntry *entries, size_t capacity, const UA_NodeId *id,
+          UA_UInt32 hash) {
+    size_t mask = capacity - 1;
+    for(size_t i = hash & mask;; i = (i + 1) & mask) {
+        LazyEntry *e = &entries[i];
+        if(!e->node)
+            return e;
+        if(e->hash == hash && UA_NodeId_equal(&e->node->id, id))
+            return e;
+    }
+}
+
+static bool
+grow(LazyNodestore *ls) {
+    size_t capacity = (ls->capacity > 0) ? ls->capacity * 2 : 1024;
+    LazyEntry *entries = (LazyEntry *)calloc(capacity, sizeof(LazyEntry));
+    if(!entries)
+        return false;
+    for(size_t i = 0; i < ls->capacity; i++) {
+        LazyEntry *e = &ls->entries[i];
+        if(e->node)
+            *findEntry(entries, capacity, &e->node->id, e->hash) = *e;
+    }
+    free(ls->entries);
+    ls->entries = entries;
+    ls->capacity = capacity;
+    return true;
+}
+
+static LazyEntry *
+getPending(LazyNodestore *ls, const UA_NodeId *id) {
+    if(ls->entriesSize == 0)
+        return NULL;
+    LazyEntry *e = findEntry(ls->entries, ls->capacity, id, UA_NodeId_hash(id));
+    return (e->node && e->pending) ? e : NULL;
+}
+
+bool
+LazyNodestore_isPending(LazyNodestore *ls, const UA_NodeId *id) {
+    return getPending(ls, id) != NULL;
+}
+
+static const UA_Node *
+getStoredNode(LazyNodestore *ls, const UA_NodeId *id) {
+    return ls->inner.getNode(ls->inner.context, id, UA_NODEATTRIBUTESMASK_ALL,
+                             UA_REFERENCETYPESET_NONE,
+                             UA_BROWSEDIRECTION_INVALID);
+}
+
+static UA_StatusCode
+addReference(LazyNodestore *ls, UA_Node *node, const UA_NodeId *refType,
+             bool isForward, const UA_NodeId *target) {
+    // The ReferenceTypes are added through the server, never lazily
+    const UA_Node *refTypeNode = getStoredNode(ls, refType);
+    if(!refTypeNode)
+        return UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
+    if(refTypeNode->head.nodeClass != UA_NODECLASS_REFERENCETYPE) {
+        ls->inner.releaseNode(ls->inner.context, refTypeNode);
+        return UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
+    }
+    UA_Byte refTypeIndex = refTypeNode->referenceTypeNode.referenceTypeIndex;
+    ls->inner.releaseNode(ls->inner.context, refTypeNode);
+
+    UA_UInt32 browseNameHash = 0;
+    LazyEntry *e = getPending(ls, target);
+    if(e) {
+        browseNameHash = UA_QualifiedName_hash(&e->node->browseName);
+    } else {
+        const UA_Node *targetNode = getStoredNode(ls, target);
+        if(!targetNode)
+            return UA_STATUSCODE_BADNODEIDUNKNOWN;
+        browseNameHash = UA_QualifiedName_hash(&targetNode->head.browseName);
+        ls->inner.releaseNode(ls->inner.context, targetNode);
+    }
+
+    UA_ExpandedNodeId targetId = UA_EXPANDEDNODEID_NULL;
+    targetId.nodeId = *target;
+    UA_StatusCode res =
+        UA_Node_addReference(node, refTypeIndex, isForward, &targetId,
+                             browseNameHash);
+    if(res == UA_STATUSCODE_BADDUPLICATEREFERENCENOTALLOWED)
+        res = UA_STATUSCODE_GOOD;
+    return res;
+}
+
+static void
+logNodeFailure(NodesetLoader_Logger *logger, const char *message,
+               const UA_NodeId *id, UA_StatusCode res) {
+    char buf[128];
+    memset(buf, 0, 128);
+    UA_String idBuf = {127, (UA_Byte*)buf};
+    UA_NodeId_print(id, &idBuf);
+    logger->log(logger->context, NODESETLOADER_LOGLEVEL_WARNING, "%s %s: %s",
+                message, buf, UA_StatusCode_name(res));
+}
+
+// Add the reference to a node in the inner nodestore
+static void
+addReferenceToStoredNode(LazyNodestore *ls, NodesetLoader_Logger *logger,
+                         const UA_NodeId *nodeId, const UA_NodeId *refType,
+                         bool isForward, const UA_NodeId *target) {
+    UA_Node *node = NULL;
+    UA_StatusCode res = ls->inner.getNodeCopy(ls->inner.context, nodeId, &node);
+    if(res != UA_STATUSCODE_GOOD) {
+        logNodeFailure(logger, "Cannot add a reference to", nodeId, res);
+        return;
+    }
+    res = addReference(ls, node, refType, isForward, target);
+    if(res != UA_STATUSCODE_GOOD) {
+        ls->inner.deleteNode(ls->inner.context, node);
+        logNodeFailure(logger, "Cannot add a reference to", nodeId, res);
+        return;
+    }
+    // The node is deleted if replacing fails
+    res = ls->inner.replaceNode(ls->inner.context, node);
+    if(res != UA_STATUSCODE_GOOD)
+        logNodeFailure(logger, "Cannot add a reference to", nodeId, res);
+}
+
+static UA_StatusCode
+setAttributes(AddNodeContext *ctx, const NL_Node *nlNode, UA_Node *node) {
+    switch(nlNode->nodeClass) {
+    case NODECLASS_OBJECT: {
+        UA_ObjectAttributes attr;
+        getObjectAttributes((const NL_ObjectNode *)nlNode, &attr);
+        return UA_Node_setAttributes(node, &attr,
+                                     &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES]);
+    }
+    case NODECLASS_VARIABLE: {
+        UA_VariableAttributes attr;
+        DecodedValue *decoded = NULL;
+        getVariableAttributes(ctx, (const NL_VariableNode *)nlNode, &attr,
+                              &decoded);
+        UA_StatusCode res =
+            UA_Node_setAttributes(node, &attr,
+                                  &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES]);
+        clearVariableAttributes(&attr, decoded);
+        return res;
+    }
+    case NODECLASS_METHOD: {
+        UA_MethodAttributes attr;
+        getMethodAttributes((const NL_MethodNode *)nlNode, &attr);
+        return UA_Node_setAttributes(node, &attr,
+                                     &UA_TYPES[UA_TYPES_METHODATTRIBUTES]);
+    }
+    case NODECLASS_VIEW: {
+        UA_ViewAttributes attr;
+        getViewAttributes((const NL_ViewNode *)nlNode, &attr);
+        return UA_Node_setAttributes(node, &attr,
+                                     &UA_TYPES[UA_TYPES_VIEWATTRIBUTES]);
+    }
+    default:
+        return UA_STATUSCODE_BADNODECLASSINVALID;
+    }
+}
+
+static UA_NodeClass
+toNodeClass(NL_NodeClass nodeClass) {
+    switch(nodeClass) {
+    case NODECLASS_OBJECT:
+        return UA_NODECLASS_OBJECT;
+    case NODECLASS_VARIABLE:
+        return UA_NODECLASS_VARIABLE;
+    case NODECLASS_METHOD:
+        return UA_NODECLASS_METHOD;
+    case NODECLASS_VIEW:
+        return UA_NODECLASS_VIEW;
+    default:
+        return UA_NODECLASS_UNSPECIFIED;
+    }
+}
+
+// Build the node from the model and insert it into the inner nodestore.
+// Constructors are not called, as for the nodes added by addNode_begin.
+static void
+materialize(LazyNodestore *ls, LazyEntry *e) {
+    // Lookups of the node while it is built do not recurse
+    e->pending = false;
+    ls->materialized++;
+
+    const NL_Node *nlNode = e->node;
+    NodesetLoader_Logger *logger = e->model->ctx.logger;
+    UA_Node *node =
+        ls->inner.newNode(ls->inner.context, toNodeClass(nlNode->nodeClass));
+    if(!node) {
+        logNodeFailure(logger, "Cannot materialize", &nlNode->id,
+                       UA_STATUSCODE_BADOUTOFMEMORY);
+        return;
+    }
+    UA_StatusCode res = UA_NodeId_copy(&nlNode->id, &node->head.nodeId);
+    res |= UA_QualifiedName_copy(&nlNode->browseName, &node->head.browseName);
+    if(res == UA_STATUSCODE_GOOD)
+        res = setAttributes(&e->model->ctx, nlNode, node);
+    if(res != UA_STATUSCODE_GOOD) {
+        ls->inner.deleteNode(ls->inner.context, node);
+        logNodeFailure(logger, "Cannot materialize", &nlNode->id, res);
+        return;
+    }
+    node->head.context = nlNode->extension;
+
+    // References to unknown nodes are skipped
+    for(NL_Reference *ref = nlNode->refs; ref != NULL; ref = ref->next) {
+        res = addReference(ls, node, &ref->refType, ref->isForward,
+                           &ref->target);
+        if(res != UA_STATUSCODE_GOOD)
+            logNodeFailure(logger, "Skipping a reference of", &nlNode->id, res);
+    }
+    for(LazyIncoming *in = e->incoming; in != NULL; in = in->next) {
+        res = addReference(ls, node, &in->ref->refType, !in->ref->isForward,
+                           &in->source->id);
+        if(res != UA_STATUSCODE_GOOD)
+            logNodeFailure(logger, "Skipping a reference of", &nlNode->id, res);
+    }
+
+    // The node is deleted if the insertion fails
+    res = ls->inner.insertNode(ls->inner.context, node, NULL);
+    if(res != UA_STATUSCODE_GOOD)
+        logNodeFailure(logger, "Cannot materialize", &nlNode->id, res);
+}
+
+/* Nodestore plugin. Every access by NodeId materializes a pending node first,
+ * everything else is forwarded to the inner nodestore. */
+
+static void
+lazyClear(void *nsCtx) {
+    LazyNodestore *ls = (LazyNodestore *)nsCtx;
+    ls->inner.clear(ls->inner.context);
+    while(ls->models) {
+        LazyModel *model = ls->models;
+        ls->models = model->next;
+        if(model->ctx.rawExtensions)
+            RawExtensions_delete(model->loader);
+        NodesetLoader_delete(model->loader);
+        UA_NamespaceMapping_clear(&model->ctx.nsMapping);
+        free(model->ctx.logger);
+        free(model);
+    }
+    while(ls->blocks) {
+        LazyIncomingBlock *block = ls->blocks;
+        ls->blocks = block->next;
+        free(block);
+    }
+    free(ls->entries);
+    free(ls);
+}
+
+static UA_Node *
+lazyNewNode(void *nsCtx, UA_NodeClass nodeClass) {
+    LazyNodestore *ls = (LazyNodestore *)nsCtx;
+    return ls->inner.newNode(ls->inner.context, nodeClass);
+}
+
+static void
+lazyDeleteNode(void *nsCtx, UA_Node *node) {
+    LazyNodestore *ls = (LazyNodestore *)nsCtx;
+    ls->inner.deleteNode(ls->inner.context, node);
+}
+
+static const UA_Node *
+lazyGetNode(void *nsCtx, const UA_NodeId *nodeId, UA_UInt32 attributeMask,
+            UA_ReferenceTypeSet references,
+            UA_BrowseDirection referenceDirections) {
+    LazyNodestore *ls = (LazyNodestore *)nsCtx;
+    LazyEntry *e = getPending(ls, nodeId);
+    if(e)
+        materialize(ls, e);
+    return ls->inner.getNode(ls->inner.context, nodeId, attributeMask,
+                             references, referenceDirections);
+}
+
+static const UA_Node *
+lazyGetNodeFromPtr(void *nsCtx, UA_NodePointer ptr, UA_UInt32 attributeMask,
+                   UA_ReferenceTypeSet references,
+                   UA_BrowseDirection referenceDirections) {
+    LazyNodestore *ls = (LazyNodestore *)nsCtx;
+    if(ls->entriesSize > 0) {
+        UA_NodeId id = UA_NodePointer_toNodeId(ptr);
+        LazyEntry *e = getPending(ls, &id);
+        if(e)
+            materialize(ls, e);
+    }
+    return ls->inner.getNodeFromPtr(ls->inner.context, ptr, attributeMask,
+                                    references, referenceDirections);
+}
+
+static void
+lazyReleaseNode(void *nsCtx, const UA_Node *node) {
+    LazyNodestore *ls = (LazyNodestore *)nsCtx;
+    ls->inner.releaseNode(ls->inner.context, node);
+}
+
+static UA_StatusCode
+lazyGetNodeCopy(void *nsCtx, const UA_NodeId *nodeId, UA_Node **outNode) {
+    LazyNodestore *ls = (LazyNodestore *)nsCtx;
+    LazyEntry *e = getPending(ls, nodeId);
+    if(e)
+        materialize(ls, e);
+    return ls->inner.getNodeCopy(ls->inner.context, nodeId, outNode);
+}
+
+static UA_StatusCode
+lazyInsertNode(void *nsCtx, UA_Node *node, UA_NodeId *addedNodeId) {
+    LazyNodestore *ls = (LazyNodestore *)nsCtx;
+    // The inner nodestore rejects the NodeId of a pending node then
+    LazyEntry *e = getPending(ls, &node->head.nodeId);
+    if(e)
+        materialize(ls, e);
+    return ls->inner.insertNode(ls->inner.context, node, addedNodeId);
+}
+
+static UA_StatusCode
+lazyReplaceNode(void *nsCtx, UA_Node *node) {
+    LazyNodestore *ls = (LazyNodestore *)nsCtx;
+    return ls->inner.replaceNode(ls->inner.context, node);
+}
+
+static UA_StatusCode
+lazyRemoveNode(void *nsCtx, const UA_NodeId *nodeId) {
+    LazyNodestore *ls = (LazyNodestore *)nsCtx;
+    LazyEntry *e = getPending(ls, nodeId);
+    if(e) {
+        // Never materialized. The entry stays, it is not pending anymore.
+        // References to it from the stored nodes are not removed.
+        e->pending = false;
+        return UA_STATUSCODE_GOOD;
+    }
+    return ls->inner.removeNode(ls->inner.context, nodeId);
+}
+
+static const UA_NodeId *
+lazyGetReferenceTypeId(void *nsCtx, UA_Byte refTypeIndex) {
+    LazyNodestore *ls = (LazyNodestore *)nsCtx;
+    return ls->inner.getReferenceTypeId(ls->inner.context, refTypeIndex);
+}
+
+// Visits the materialized nodes only
+static void
+lazyIterate(void *nsCtx, UA_NodestoreVisitor visitor, void *visitorCtx) {
+    LazyNodestore *ls = (LazyNodestore *)nsCtx;
+    ls->inner.iterate(ls->inner.context, visitor, visitorCtx);
+}
+
+bool
+NodesetLoader_useLazyNodestore(UA_ServerConfig *config) {
+    UA_Nodestore *ns = &config->nodestore;
+    if(ns->getNode == lazyGetNode)
+        return true;
+    if(!ns->getNode)
+        return false; // Nothing to wrap
+    LazyNodestore *ls = (LazyNodestore *)calloc(1, sizeof(LazyNodestore));
+    if(!ls)
+        return false;
+    ls->inner = *ns;
+    ns->context = ls;
+    ns->clear = lazyClear;
+    ns->newNode = lazyNewNode;
+    ns->deleteNode = lazyDeleteNode;
+    ns->getNode = lazyGetNode;
+    ns->getNodeFromPtr = lazyGetNodeFromPtr;
+    ns->releaseNode = lazyReleaseNode;
+    ns->getNodeCopy = lazyGetNodeCopy;
+    ns->insertNode = lazyInsertNode;
+    ns->replaceNode = lazyReplaceNode;
+    ns->removeNode = lazyRemoveNode;
+    ns->getReferenceTypeId = lazyGetReferenceTypeId;
+    ns->iterate = lazyIterate;
+    return true;
+}
+
+LazyNodestore *
+LazyNodestore_get(UA_Server *server) {
+    UA_ServerConfig *config = UA_Server_getConfig(server);
+    if(config->nodestore.getNode != lazyGetNode)
+        return NULL;
+    return (LazyNodestore *)config->nodestore.context;
+}
+
+bool
+NodesetLoader_getLazyStats(UA_Server *server, NodesetLoader_LazyStats *stats) {
+    LazyNodestore *ls = LazyNodestore_get(server);
+    if(!ls)
+        return false;
+    stats->nodes = ls->entriesSize;
+    stats->materialized = ls->materialized;
+    return true;
+}
+
+/* Index of the models */
+
+typedef struct {
+    LazyNodestore *ls;
+    LazyModel *model;
+    bool failed;
+} IndexContext;
+
+static bool
+indexNode(IndexContext *ic, NL_Node *node) {
+    if(!LazyNodestore_isLazyNodeClass(node->nodeClass))
+        return true;
+    LazyNodestore *ls = ic->ls;
+    if((ls->entriesSize + 1) * 2 > ls->capacity && !grow(ls)) {
+        ic->failed = true;
+        return false;
+    }
+    UA_UInt32 hash = UA_NodeId_hash(&node->id);
+    LazyEntry *e = findEntry(ls->entries, ls->capacity, &node->id, hash);
+    if(e->node) {
+        logNodeFailure(ic->model->ctx.logger, "Skipping the duplicate node",
+                       &node->id, UA_STATUSCODE_BADNODEIDEXISTS);
+        return true;
+    }
+    // Nodes that exist already are skipped, as addNode would reject them
+    const UA_Node *stored = getStoredNode(ls, &node->id);
+    if(stored) {
+        ls->inner.releaseNode(ls->inner.context, stored);
+        logNodeFailure(ic->model->ctx.logger, "Skipping the existing node",
+                       &node->id, UA_STATUSCODE_BADNODEIDEXISTS);
+        return true;
+    }
+    e->node = node;
+    e->hash = hash;
+    e->pending = true;
+    e->model = ic->model;
+    ls->entriesSize++;
+    return true;
+}
+
+static LazyIncoming *
+newIncoming(LazyNodestore *ls) {
+    if(!ls->blocks || ls->blocks->used == LAZY_INCOMING_BLOCKSIZE) {
+        LazyIncomingBlock *block =
+            (LazyIncomingBlock *)malloc(sizeof(LazyIncomingBlock));
+        if(!block)
+            return NULL;
+        block->used = 0;
+        block->next = ls->blocks;
+        ls->blocks = block;
+    }
+    return &ls->blocks->refs[ls->blocks->used++];
+}
+
+static bool
+indexIncoming(IndexContext *ic, NL_Node *node) {
+    for(NL_Reference *ref = node->refs; ref != NULL; ref = ref->next) {
+        LazyEntry *e = getPending(ic->ls, &ref->target);
+        if(!e)
+            continue;
+        LazyIncoming *in = newIncoming(ic->ls);
+        if(!in) {
+            ic->failed = true;
+            return false;
+        }
+        in->source = node;
+        in->ref = ref;
+        in->next = e->incoming;
+        e->incoming = in;
+    }
+    return true;
+}
+
+// The incoming references added since the mark are in the blocks before the
+// mark block and behind markUsed in it
+static bool
+isNewIncoming(const LazyNodestore *ls, const LazyIncomingBlock *markBlock,
+              size_t markUsed, const LazyIncoming *in) {
+    for(const LazyIncomingBlock *b = ls->blocks; b; b = b->next) {
+        size_t first = (b == markBlock) ? markUsed : 0;
+        if(in >= &b->refs[first] && in < &b->refs[b->used])
+            return true;
+        if(b == markBlock)
+            break;
+    }
+    return false;
+}
+
+// Removes the entry of slot i and moves the following entries of its probe
+// sequence back
+static void
+removeEntry(LazyNodestore *ls, size_t i) {
+    size_t mask = ls->capacity - 1;
+    memset(&ls->entries[i], 0, sizeof(LazyEntry));
+    ls->entriesSize--;
+    for(size_t j = (i + 1) & mask; ls->entries[j].node; j = (j + 1) & mask) {
+        size_t home = ls->entries[j].hash & mask;
+        // Keep the entry if its home slot is in (i, j]
+        if((i < j) ? (home > i && home <= j) : (home > i || home <= j))
+            continue;
+        ls->entries[i] = ls->entries[j];
+        memset(&ls->entries[j], 0, sizeof(LazyEntry));
+        i = j;
+    }
+}
+
+// Remove the entries of the model and the incoming references that were
+// added for it. The new references are the first ones of every list.
+static void
+rollbackModel(LazyNodestore *ls, const LazyModel *model,
+              LazyIncomingBlock *markBlock, size_t markUsed) {
+    for(size_t i = 0; i < ls->capacity; i++) {
+        LazyEntry *e = &ls->entries[i];
+        while(e->incoming && isNewIncoming(ls, markBlock, markUsed, e->incoming))
+            e->incoming = e->incoming->next;
+    }
+    for(size_t i = 0; i < ls->capacity;) {
+        // Check the slot again, removing moves the next entry into it
+        if(ls->entries[i].node && ls->entries[i].model == model)
+            removeEntry(ls, i);
+        else
+            i++;
+    }
+    while(ls->blocks != markBlock) {
+        LazyIncomingBlock *block = ls->blocks;
+        ls->blocks = block->next;
+        free(block);
+    }
+    if(markBlock)
+        markBlock->used = markUsed;
+}
+
+bool
+LazyNodestore_addModel(LazyNodestore *ls, NodesetLoader *loader,
+                       const AddNodeContext *ctx) {
+    LazyModel *model = (LazyModel *)calloc(1, sizeof(LazyModel));
+    if(!model)
+        return false;
+    model->loader = loader;
+    model->ctx = *ctx;
+    model->ctx.decodedValues = NULL;
+    model->ctx.lazy = NULL;
+    model->ctx.valueStore = NULL; // Materialized nodes decode their value
+    LazyIncomingBlock *markBlock = ls->blocks;
+    size_t markUsed = markBlock ? markBlock->used : 0;
+    IndexContext ic = {ls, model, false};
+    NodesetLoader_forEachNode(loader, &ic,
+                              (NodesetLoader_forEachNode_Func)indexNode);
+    if(!ic.failed)
+        NodesetLoader_forEachNode(loader, &ic,
+                                  (NodesetLoader_forEachNode_Func)indexIncoming);
+    // Nothing points into the loader after a failure, the caller keeps it
+    if(ic.failed) {
+        rollbackModel(ls, model, markBlock, markUsed);
+        free(model);
+        return false;
+    }
+    model->next = ls->models;
+    ls->models = model;
+    return true;
+}
+
+typedef struct {
+    LazyNodestore *ls;
+    NodesetLoader_Logger *logger;
+} AttachContext;
+
+static bool
+attachNode(AttachContext *ac, NL_Node *node) {
+    bool pending = LazyNodestore_isPending(ac->ls, &node->id);
+    for(NL_Reference *ref = node->refs; ref != NULL; ref = ref->next) {
+        bool targetPending = LazyNodestore_isPending(ac->ls, &ref->target);
+        // References between two pending nodes are added when they are
+        // materialized. Between two other nodes by the server.
+        if(pending == targetPending)
+            continue;
+        if(targetPending) {
+            addReferenceToStoredNode(ac->ls, ac->logger, &node->id,
+                                     &ref->refType, ref->isForward,
+                                     &ref->target);
+            continue;
+        }
+        // The server does not add the inverse HasTypeDefinition either
+        if(ref->isForward && UA_NodeId_equal(&ref->refType, &hasTypeDefinition))
+            continue;
+        addReferenceToStoredNode(ac->ls, ac->logger, &ref->target,
+                                 &ref->refType, !ref->isForward, &node->id);
+    }
+    return true;
+}
+
+void
+LazyNodestore_attach(LazyNodestore *ls, NodesetLoader *loader) {
+    AttachContext ac = {ls, ls->models->ctx.logger};
+    NodesetLoader_forEachNode(loader, &ac,
+                              (NodesetLoader_forEachNode_Func)attachNode);
+}
+
+#else
+
+bool
+NodesetLoader_useLazyNodestore(UA_ServerConfig *config) {
+    return false;
+}
+
+LazyNodestore *
+LazyNodestore_get(UA_Server *server) {
+    return NULL;
+}
+
+bool
+NodesetLoader_getLazyStats(UA_Server *server, NodesetLoader_LazyStats *stats) {
+    return false;
+}
+
+bool
+LazyNodestore_addModel(LazyNodestore *ls, NodesetLoader *loader,
+                       const AddNodeContext *ctx) {
+    return false;
+}
+
+bool
+LazyNodestore_isPending(LazyNodestore *ls, const UA_NodeId *id) {
+    return false;
+}
+
+void
+LazyNodestore_attach(LazyNodestore *ls, NodesetLoader *loader) {}
+
+#endif
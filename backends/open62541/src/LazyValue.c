@@ -0,0 +1,285 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <open62541/server.h>
+
+#include <NodesetLoader/backendOpen62541.h>
+#include "internal.h"
+
+// The value of a Variable, decoded on the first access
+typedef struct LazyValue {
+    UA_String xml; // Cleared once decoded
+    const UA_NamespaceMapping *nsMapping;
+    bool decoded;
+    UA_StatusCode status;
+    UA_Variant value;
+    struct LazyValue *next;
+} LazyValue;
+
+// The namespace mapping of an import, to decode its values
+typedef struct StoredMapping {
+    UA_NamespaceMapping mapping;
+    struct StoredMapping *next;
+} StoredMapping;
+
+struct NodesetLoader_ValueStore {
+    LazyValue *values;
+    StoredMapping *mappings;
+};
+
+NodesetLoader_ValueStore *
+NodesetLoader_ValueStore_new(void) {
+    return (NodesetLoader_ValueStore *)calloc(1, sizeof(NodesetLoader_ValueStore));
+}
+
+void
+NodesetLoader_ValueStore_delete(NodesetLoader_ValueStore *store) {
+    if(!store)
+        return;
+    while(store->values) {
+        LazyValue *v = store->values;
+        store->values = v->next;
+        UA_String_clear(&v->xml);
+        UA_Variant_clear(&v->value);
+        free(v);
+    }
+    while(store->mappings) {
+        StoredMapping *m = store->mappings;
+        store->mappings = m->next;
+        UA_NamespaceMapping_clear(&m->mapping);
+        free(m);
+    }
+    free(store);
+}
+
+bool
+LazyValue_isLazy(const AddNodeContext *ctx, const NL_Node *node) {
+    if(!ctx->valueStore || ctx->lazyValueThreshold == 0)
+        return false;
+    if(node->nodeClass != NODECLASS_VARIABLE)
+        return false;
+    // The node context is used for the value, keep the extension
+    if(node->extension)
+        return false;
+    return ((const NL_VariableNode *)node)->value.length >=
+           ctx->lazyValueThreshold;
+}
+
+// Skips to the end of the markup that begins at p. Returns the position after
+// it and sets the local name of a tag. Quoted attribute values may contain '>'.
+static const char *
+skipMarkup(const char *p, const char *end, const char **name, size_t *nameLen,
+           bool *selfClosing) {
+    *nameLen = 0;
+    *selfClosing = false;
+    if(end - p >= 4 && !strncmp(p, "<!--", 4)) {
+        for(p += 4; end - p >= 3; p++) {
+            if(!strncmp(p, "-->", 3))
+                return p + 3;
+        }
+        return end;
+    }
+    if(end - p >= 9 && !strncmp(p, "<![CDATA[", 9)) {
+        for(p += 9; end - p >= 3; p++) {
+            if(!strncmp(p, "]]>", 3))
+                return p + 3;
+        }
+        return end;
+    }
+    const char *n = ++p;
+    if(p < end && *p == '/')
+        n = ++p;
+    while(p < end && *p != '>' && *p != '/' && *p != ' ' && *p != '\t' &&
+          *p != '\r' && *p != '\n') {
+        if(*p == ':')
+            n = p + 1; // Drop the namespace prefix
+        p++;
+    }
+    *name = n;
+    *nameLen = (size_t)(p - n);
+    char quote = 0;
+    for(; p < end; p++) {
+        if(quote) {
+            if(*p == quote)
+                quote = 0;
+        } else if(*p == '"' || *p == '\'') {
+            quote = *p;
+        } else if(*p == '>') {
+            *selfClosing = (p[-1] == '/');
+            return p + 1;
+        }
+    }
+    return end;
+}
+
+static bool
+nameIs(const char *name, size_t nameLen, const char *prefix, bool exact) {
+    size_t len = strlen(prefix);
+    if(nameLen < len || (exact && nameLen != len))
+        return false;
+    return !strncmp(name, prefix, len);
+}
+
+size_t
+LazyValue_arrayLength(const NL_VariableNode *node) {
+    const char *p = (const char *)node->value.data;
+    const char *end = p + node->value.length;
+    // Depth 0 is <Value>, depth 1 the value. The elements of a <ListOf...>
+    // are at depth 2, those of a <Matrix> in its <Elements> at depth 3.
+    size_t depth = 0;
+    size_t elementsDepth = 0; // 0: no array found yet
+    bool matrix = false;
+    size_t length = 0;
+    while(p < end) {
+        if(*p != '<') {
+            p++;
+            continue;
+        }
+        bool endTag = (end - p >= 2 && p[1] == '/');
+        bool declaration = (end - p >= 2 && (p[1] == '?' || p[1] == '!'));
+        const char *name = NULL;
+        size_t nameLen = 0;
+        bool selfClosing = false;
+        p = skipMarkup(p, end, &name, &nameLen, &selfClosing);
+        if(declaration)
+            continue;
+        if(endTag) {
+            if(depth == 0)
+                break;
+            depth--;
+            if(elementsDepth > 0 && depth < elementsDepth)
+                break; // The array ended
+            if(depth < 2 && !elementsDepth)
+                break; // The value is not an array
+            continue;
+        }
+        if(elementsDepth > 0 && depth == elementsDepth)
+            length++;
+        else if(depth == 1 && nameIs(name, nameLen, "ListOf", false))
+            elementsDepth = 2;
+        else if(depth == 1 && nameIs(name, nameLen, "Matrix", true))
+            matrix = true;
+        else if(depth == 2 && matrix && nameIs(name, nameLen, "Elements", true))
+            elementsDepth = 3;
+        if(!selfClosing)
+            depth++;
+    }
+    return length;
+}
+
+static UA_StatusCode
+LazyValue_decode(UA_Server *server, LazyValue *v) {
+    if(v->decoded)
+        return v->status;
+    UA_DecodeXmlOptions opts;
+    memset(&opts, 0, sizeof(UA_DecodeXmlOptions));
+    opts.unwrapped = true;
+    opts.customTypes = UA_Server_getDataTypes(server);
+    opts.namespaceMapping = (UA_NamespaceMapping *)(uintptr_t)v->nsMapping;
+    v->status = UA_decodeXml(&v->xml, &v->value, &UA_TYPES[UA_TYPES_VARIANT],
+                             &opts);
+    v->decoded = true;
+    UA_String_clear(&v->xml);
+    return v->status;
+}
+
+static UA_StatusCode
+readLazyValue(UA_Server *server, const UA_NodeId *sessionId,
+              void *sessionContext, const UA_NodeId *nodeId, void *nodeContext,
+              UA_Boolean includeSourceTimeStamp, const UA_NumericRange *range,
+              UA_DataValue *value) {
+    LazyValue *v = (LazyValue *)nodeContext;
+    UA_StatusCode res = LazyValue_decode(server, v);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+    if(range)
+        res = UA_Variant_copyRange(&v->value, &value->value, *range);
+    else
+        res = UA_Variant_copy(&v->value, &value->value);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+    value->hasValue = true;
+    if(includeSourceTimeStamp) {
+        value->sourceTimestamp = UA_DateTime_now();
+        value->hasSourceTimestamp = true;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+writeLazyValue(UA_Server *server, const UA_NodeId *sessionId,
+               void *sessionContext, const UA_NodeId *nodeId, void *nodeContext,
+               const UA_NumericRange *range, const UA_DataValue *value) {
+    LazyValue *v = (LazyValue *)nodeContext;
+    if(!value->hasValue)
+        return UA_STATUSCODE_BADTYPEMISMATCH;
+    if(range) {
+        // Only a part is replaced, the rest comes from the nodeset
+        UA_StatusCode res = LazyValue_decode(server, v);
+        if(res != UA_STATUSCODE_GOOD)
+            return res;
+        return UA_Variant_setRangeCopy(&v->value, value->value.data,
+                                       value->value.arrayLength, *range);
+    }
+    UA_Variant copy;
+    UA_StatusCode res = UA_Variant_copy(&value->value, &copy);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+    UA_Variant_clear(&v->value);
+    UA_String_clear(&v->xml);
+    v->value = copy;
+    v->decoded = true;
+    v->status = UA_STATUSCODE_GOOD;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+LazyValue_attach(AddNodeContext *ctx, const NL_VariableNode *node) {
+    NodesetLoader_ValueStore *store = ctx->valueStore;
+    // One copy of the namespace mapping per import
+    if(!ctx->storedMapping) {
+        StoredMapping *m = (StoredMapping *)calloc(1, sizeof(StoredMapping));
+        if(!m)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        const UA_NamespaceMapping *src = &ctx->nsMapping;
+        UA_StatusCode res =
+            UA_Array_copy(src->namespaceUris, src->namespaceUrisSize,
+                          (void **)&m->mapping.namespaceUris,
+                          &UA_TYPES[UA_TYPES_STRING]);
+        m->mapping.namespaceUrisSize = src->namespaceUrisSize;
+        res |= UA_Array_copy(src->local2remote, src->local2remoteSize,
+                             (void **)&m->mapping.local2remote,
+                             &UA_TYPES[UA_TYPES_UINT16]);
+        m->mapping.local2remoteSize = src->local2remoteSize;
+        res |= UA_Array_copy(src->remote2local, src->remote2localSize,
+                             (void **)&m->mapping.remote2local,
+                             &UA_TYPES[UA_TYPES_UINT16]);
+        m->mapping.remote2localSize = src->remote2localSize;
+        m->next = store->mappings;
+        store->mappings = m;
+        if(res != UA_STATUSCODE_GOOD)
+            return res;
+        ctx->storedMapping = &m->mapping;
+    }
+
+    LazyValue *v = (LazyValue *)calloc(1, sizeof(LazyValue));
+    if(!v)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    v->nsMapping = ctx->storedMapping;
+    v->next = store->values;
+    store->values = v;
+    UA_StatusCode res = UA_String_copy(&node->value, &v->xml);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+
+    UA_DataSource dataSource;
+    dataSource.read = readLazyValue;
+    dataSource.write = writeLazyValue;
+    res = UA_Server_setNodeContext(ctx->server, node->id, v);
+    if(res == UA_STATUSCODE_GOOD)
+        res = UA_Server_setVariableNode_dataSource(ctx->server, node->id,
+                                                   dataSource);
+    return res;
+}
@@ -0,0 +1,54 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <NodesetLoader/backendOpen62541.h>
+#include <open62541/server.h>
+
+#include "internal.h"
+
+/* With captureRawExtensions the raw <Extensions> xml of a node is its node
+ * context. The strings of the nodes in the server belong to the application,
+ * which frees them with NodesetLoader_deleteRawExtension in its node
+ * destructor. The strings that did not become a node context are freed by the
+ * loader. */
+
+void
+NodesetLoader_deleteRawExtension(void *nodeContext) {
+    UA_String_delete((UA_String *)nodeContext);
+}
+
+static bool
+handOverNode(UA_Server *server, NL_Node *node) {
+    UA_String *raw = (UA_String *)node->extension;
+    if(!raw)
+        return true;
+    node->extension = NULL;
+    void *context = NULL;
+    // Not added, e.g. the add failed, the import was canceled before the node
+    // or the node already existed
+    if(UA_Server_getNodeContext(server, node->id, &context) !=
+           UA_STATUSCODE_GOOD || context != raw)
+        UA_String_delete(raw);
+    return true;
+}
+
+void
+RawExtensions_handOver(UA_Server *server, NodesetLoader *loader) {
+    NodesetLoader_forEachParsedNode(loader, server,
+                                    (NodesetLoader_forEachNode_Func)handOverNode);
+}
+
+static bool
+deleteNodeExtension(void *context, NL_Node *node) {
+    UA_String_delete((UA_String *)node->extension);
+    node->extension = NULL;
+    return true;
+}
+
+void
+RawExtensions_delete(NodesetLoader *loader) {
+    NodesetLoader_forEachParsedNode(
+        loader, NULL, (NodesetLoader_forEachNode_Func)deleteNodeExtension);
+}
@@ -0,0 +1,133 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "internal.h"
+
+// A reference in canonical (forward) direction. Points into the NL_Node and
+// NL_Reference structures, nothing is copied.
+typedef struct {
+    const UA_NodeId *source;
+    const UA_NodeId *refType;
+    const UA_NodeId *target;
+    UA_UInt32 hash;
+} RefKey;
+
+typedef struct {
+    RefKey *keys;
+    size_t size;
+    size_t capacity;
+    ReferenceFilterStats stats;
+} ReferenceFilter;
+
+static const UA_NodeId hasTypeDefinition =
+    {0, UA_NODEIDTYPE_NUMERIC, {UA_NS0ID_HASTYPEDEFINITION}};
+
+static RefKey
+makeKey(const NL_Node *node, const NL_Reference *ref) {
+    RefKey key;
+    key.source = ref->isForward ? &node->id : &ref->target;
+    key.target = ref->isForward ? &ref->target : &node->id;
+    key.refType = &ref->refType;
+    key.hash = UA_NodeId_hash(key.source);
+    key.hash = key.hash * 31 + UA_NodeId_hash(key.refType);
+    key.hash = key.hash * 31 + UA_NodeId_hash(key.target);
+    return key;
+}
+
+static RefKey *
+findKey(RefKey *keys, size_t capacity, const RefKey *key) {
+    size_t mask = capacity - 1;
+    for(size_t i = key->hash & mask;; i = (i + 1) & mask) {
+        RefKey *k = &keys[i];
+        if(!k->source)
+            return k;
+        if(k->hash == key->hash &&
+           UA_NodeId_equal(k->source, key->source) &&
+           UA_NodeId_equal(k->refType, key->refType) &&
+           UA_NodeId_equal(k->target, key->target))
+            return k;
+    }
+}
+
+static bool
+grow(ReferenceFilter *f) {
+    size_t capacity = (f->capacity > 0) ? f->capacity * 2 : 1024;
+    RefKey *keys = (RefKey *)calloc(capacity, sizeof(RefKey));
+    if(!keys)
+        return false;
+    for(size_t i = 0; i < f->capacity; i++) {
+        if(f->keys[i].source)
+            *findKey(keys, capacity, &f->keys[i]) = f->keys[i];
+    }
+    free(f->keys);
+    f->keys = keys;
+    f->capacity = capacity;
+    return true;
+}
+
+// Returns true if the reference was added before
+static bool
+ReferenceFilter_seen(ReferenceFilter *f, const NL_Node *node,
+                     const NL_Reference *ref) {
+    if((f->size + 1) * 2 > f->capacity && !grow(f))
+        return false; // Out of memory, the server will detect duplicates
+    RefKey key = makeKey(node, ref);
+    RefKey *k = findKey(f->keys, f->capacity, &key);
+    if(k->source)
+        return true;
+    *k = key;
+    f->size++;
+    return false;
+}
+
+// The reference to the parent and the type definition are created by
+// addNode_begin
+static bool
+markCreatedWithNode(ReferenceFilter *f, NL_Node *node) {
+    for(NL_Reference *ref = node->refs; ref != NULL; ref = ref->next)
+        ref->isImplied = false;
+
+    if(node->parentRef) {
+        node->parentRef->isImplied = true;
+        ReferenceFilter_seen(f, node, node->parentRef);
+    }
+
+    if(node->nodeClass != NODECLASS_OBJECT &&
+       node->nodeClass != NODECLASS_VARIABLE)
+        return true;
+    for(NL_Reference *ref = node->refs; ref != NULL; ref = ref->next) {
+        if(!ref->isForward || !UA_NodeId_equal(&ref->refType, &hasTypeDefinition))
+            continue;
+        ref->isImplied = true;
+        ReferenceFilter_seen(f, node, ref);
+        break; // Only the first type definition is used
+    }
+    return true;
+}
+
+// The inverse copy of a reference and duplicates are marked as implied
+static bool
+markDuplicates(ReferenceFilter *f, NL_Node *node) {
+    for(NL_Reference *ref = node->refs; ref != NULL; ref = ref->next) {
+        f->stats.references++;
+        if(ref->isImplied || ReferenceFilter_seen(f, node, ref)) {
+            ref->isImplied = true;
+            f->stats.implied++;
+        }
+    }
+    return true;
+}
+
+ReferenceFilterStats
+markImpliedReferences(NodesetLoader *loader) {
+    ReferenceFilter f;
+    memset(&f, 0, sizeof(ReferenceFilter));
+    NodesetLoader_forEachNode(loader, &f,
+                              (NodesetLoader_forEachNode_Func)markCreatedWithNode);
+    NodesetLoader_forEachNode(loader, &f,
+                              (NodesetLoader_forEachNode_Func)markDuplicates);
+    free(f.keys);
+    return f.stats;
+}
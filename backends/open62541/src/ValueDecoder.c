@@ -0,0 +1,271 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "internal.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+typedef struct {
+    DecodedValue **jobs;
+    size_t jobsSize;
+    UA_DecodeXmlOptions opts;
+    size_t worker;
+    size_t workersSize;
+} DecodeWorker;
+
+static bool
+collectNode(DecodedValues *dv, NL_Node *node) {
+    dv->nodesSize++;
+    if(node->nodeClass != NODECLASS_VARIABLE)
+        return true;
+    if(((NL_VariableNode *)node)->value.length == 0 ||
+       LazyValue_isLazy(dv->ctx, node))
+        return true;
+    dv->valuesSize++;
+    return true;
+}
+
+static bool
+addJob(DecodedValues *dv, NL_Node *node) {
+    if(node->nodeClass != NODECLASS_VARIABLE)
+        return true;
+    const NL_VariableNode *varNode = (const NL_VariableNode *)node;
+    if(varNode->value.length == 0 || LazyValue_isLazy(dv->ctx, node))
+        return true;
+    DecodedValue *v = &dv->values[dv->valuesSize++];
+    v->node = varNode;
+    v->hash = UA_ByteString_hash(UA_NodeId_hash(&varNode->datatype),
+                                 varNode->value.data, varNode->value.length);
+    dv->bySortIndex[node->sortIndex] = v;
+    return true;
+}
+
+// Bytes of the arrays that live until DecodedValues_clear
+static size_t
+arraysBytes(const DecodedValues *dv) {
+    size_t bytes = 0;
+    if(dv->values)
+        bytes += dv->valuesSize * sizeof(DecodedValue);
+    if(dv->bySortIndex)
+        bytes += dv->nodesSize * sizeof(DecodedValue *);
+    return bytes;
+}
+
+static bool
+samePayload(const DecodedValue *a, const DecodedValue *b) {
+    return a->hash == b->hash &&
+           UA_String_equal(&a->node->value, &b->node->value) &&
+           UA_NodeId_equal(&a->node->datatype, &b->node->datatype);
+}
+
+// Point every value to the first value with the same payload and DataType.
+// Returns the values that have to be decoded. All values of one import share
+// the namespace mapping, so it is not part of the key.
+static DecodedValue **
+deduplicate(DecodedValues *dv, size_t *jobsSize) {
+    size_t capacity = 16;
+    while(capacity < dv->valuesSize * 2)
+        capacity *= 2;
+    size_t tableBytes = capacity * sizeof(DecodedValue *);
+    size_t jobsBytes = dv->valuesSize * sizeof(DecodedValue *);
+    DecodedValue **table = (DecodedValue **)calloc(capacity, sizeof(DecodedValue *));
+    DecodedValue **jobs = (DecodedValue **)calloc(dv->valuesSize, sizeof(DecodedValue *));
+    if(!table || !jobs) {
+        free(table);
+        free(jobs);
+        return NULL;
+    }
+    NodesetLoader_trackAlloc(dv->loader, NL_MEMORY_DECODE, tableBytes + jobsBytes);
+    size_t mask = capacity - 1;
+    *jobsSize = 0;
+    for(size_t i = 0; i < dv->valuesSize; i++) {
+        DecodedValue *v = &dv->values[i];
+        size_t j = v->hash & mask;
+        while(table[j] && !samePayload(table[j], v))
+            j = (j + 1) & mask;
+        if(!table[j]) {
+            table[j] = v;
+            jobs[(*jobsSize)++] = v;
+            dv->cacheMisses++;
+        } else {
+            dv->cacheHits++;
+        }
+        v->source = table[j];
+        v->source->users++;
+    }
+    free(table);
+    NodesetLoader_trackFree(dv->loader, NL_MEMORY_DECODE, tableBytes);
+    return jobs;
+}
+
+// Every worker decodes every n-th payload. Payloads are independent and the
+// type table is not modified while the workers run.
+static void
+decodeStripe(DecodeWorker *w) {
+    for(size_t i = w->worker; i < w->jobsSize; i += w->workersSize) {
+        DecodedValue *v = w->jobs[i];
+        v->status = UA_decodeXml(&v->node->value, &v->value,
+                                 &UA_TYPES[UA_TYPES_VARIANT], &w->opts);
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+decodeThread(LPVOID w) {
+    decodeStripe((DecodeWorker *)w);
+    return 0;
+}
+#else
+static void *
+decodeThread(void *w) {
+    decodeStripe((DecodeWorker *)w);
+    return NULL;
+}
+#endif
+
+static size_t
+defaultThreadCount(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (size_t)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (size_t)n : 1;
+#endif
+}
+
+static void
+runWorkers(DecodeWorker *workers, size_t workersSize) {
+    // The calling thread decodes the first stripe itself
+#ifdef _WIN32
+    HANDLE *threads = (HANDLE *)calloc(workersSize, sizeof(HANDLE));
+#else
+    pthread_t *threads = (pthread_t *)calloc(workersSize, sizeof(pthread_t));
+#endif
+    bool *started = (bool *)calloc(workersSize, sizeof(bool));
+    if(threads && started) {
+        for(size_t i = 1; i < workersSize; i++) {
+#ifdef _WIN32
+            threads[i] = CreateThread(NULL, 0, decodeThread, &workers[i], 0, NULL);
+            started[i] = (threads[i] != NULL);
+#else
+            started[i] = (pthread_create(&threads[i], NULL, decodeThread,
+                                         &workers[i]) == 0);
+#endif
+        }
+    }
+    decodeStripe(&workers[0]);
+    for(size_t i = 1; i < workersSize; i++) {
+        if(!started || !started[i]) {
+            decodeStripe(&workers[i]); // No thread, decode here
+            continue;
+        }
+#ifdef _WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+    free(started);
+    free(threads);
+}
+
+bool
+DecodedValues_decode(DecodedValues *dv, NodesetLoader *loader,
+                     AddNodeContext *ctx,
+                     const UA_DataTypeArray *customTypes, size_t threads) {
+    memset(dv, 0, sizeof(DecodedValues));
+    dv->loader = loader;
+    dv->ctx = ctx;
+    NodesetLoader_forEachNode(loader, dv,
+                              (NodesetLoader_forEachNode_Func)collectNode);
+    if(dv->valuesSize == 0)
+        return true;
+
+    dv->values = (DecodedValue *)calloc(dv->valuesSize, sizeof(DecodedValue));
+    dv->bySortIndex = (DecodedValue **)calloc(dv->nodesSize, sizeof(DecodedValue *));
+    NodesetLoader_trackAlloc(loader, NL_MEMORY_DECODE, arraysBytes(dv));
+    if(!dv->values || !dv->bySortIndex) {
+        DecodedValues_clear(dv);
+        return false;
+    }
+    dv->valuesSize = 0;
+    NodesetLoader_forEachNode(loader, dv,
+                              (NodesetLoader_forEachNode_Func)addJob);
+
+    size_t jobsSize = 0;
+    DecodedValue **jobs = deduplicate(dv, &jobsSize);
+    if(!jobs) {
+        DecodedValues_clear(dv);
+        return false;
+    }
+
+    if(threads == 0)
+        threads = defaultThreadCount();
+    if(threads > jobsSize)
+        threads = jobsSize;
+
+    DecodeWorker *workers = (DecodeWorker *)calloc(threads, sizeof(DecodeWorker));
+    if(!workers) {
+        free(jobs);
+        NodesetLoader_trackFree(loader, NL_MEMORY_DECODE,
+                                dv->valuesSize * sizeof(DecodedValue *));
+        DecodedValues_clear(dv);
+        return false;
+    }
+    for(size_t i = 0; i < threads; i++) {
+        workers[i].jobs = jobs;
+        workers[i].jobsSize = jobsSize;
+        workers[i].opts.unwrapped = true;
+        workers[i].opts.customTypes = customTypes;
+        workers[i].opts.namespaceMapping = &ctx->nsMapping;
+        workers[i].worker = i;
+        workers[i].workersSize = threads;
+    }
+    runWorkers(workers, threads);
+    free(workers);
+    free(jobs);
+    NodesetLoader_trackFree(loader, NL_MEMORY_DECODE,
+                            dv->valuesSize * sizeof(DecodedValue *));
+    return true;
+}
+
+DecodedValue *
+DecodedValues_get(const DecodedValues *dv, const NL_Node *node) {
+    if(!dv->bySortIndex || node->sortIndex >= dv->nodesSize)
+        return NULL;
+    return dv->bySortIndex[node->sortIndex];
+}
+
+void
+DecodedValues_release(DecodedValue *v) {
+    DecodedValue *source = v->source;
+    if(source->users > 0 && --source->users == 0)
+        UA_Variant_clear(&source->value);
+}
+
+void
+DecodedValues_keep(DecodedValues *dv) {
+    for(size_t i = 0; i < dv->valuesSize; i++)
+        dv->values[i].users = 0;
+}
+
+void
+DecodedValues_clear(DecodedValues *dv) {
+    for(size_t i = 0; i < dv->valuesSize; i++)
+        UA_Variant_clear(&dv->values[i].value);
+    if(dv->loader)
+        NodesetLoader_trackFree(dv->loader, NL_MEMORY_DECODE, arraysBytes(dv));
+    free(dv->values);
+    free(dv->bySortIndex);
+    memset(dv, 0, sizeof(DecodedValues));
+}
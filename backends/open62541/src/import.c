@@ -9,10 +9,64 @@
 
 #include <open62541/server.h>
 
+#include <time.h>
+
 #include <NodesetLoader/backendOpen62541.h>
 #include "internal.h"
 #include "Node.h"
 
+static UA_UInt16
+addServerNamespace(UA_Server *server, const UA_String *nsUri) {
+    char namebuf[512];
+    memcpy(namebuf, nsUri->data, nsUri->length);
+    namebuf[nsUri->length] = 0;
+    return UA_Server_addNamespace(server, namebuf);
+}
+
+// The index the namespace gets in the server. With deferNamespaces the server
+// is not touched, new namespaces get the next free indices and are added with
+// AddNodeContext_addPendingNamespaces.
+static UA_UInt16
+getServerNamespace(AddNodeContext *ctx, const UA_String *nsUri) {
+    if(!ctx->deferNamespaces)
+        return addServerNamespace(ctx->server, nsUri);
+    // The first entries of the mapping are the namespaces of the server
+    for(size_t i = 0; i < ctx->serverNamespacesSize; i++) {
+        if(UA_String_equal(&ctx->nsMapping.namespaceUris[i], nsUri))
+            return (UA_UInt16)i;
+    }
+    for(size_t i = 0; i < ctx->pendingNamespacesSize; i++) {
+        if(UA_String_equal(&ctx->pendingNamespaces[i], nsUri))
+            return (UA_UInt16)(ctx->serverNamespacesSize + i);
+    }
+    UA_StatusCode res =
+        UA_Array_appendCopy((void **)&ctx->pendingNamespaces,
+                            &ctx->pendingNamespacesSize, nsUri,
+                            &UA_TYPES[UA_TYPES_STRING]);
+    (void)res;
+    return (UA_UInt16)(ctx->serverNamespacesSize +
+                       ctx->pendingNamespacesSize - 1);
+}
+
+bool
+AddNodeContext_addPendingNamespaces(AddNodeContext *ctx) {
+    bool status = true;
+    for(size_t i = 0; i < ctx->pendingNamespacesSize; i++) {
+        UA_UInt16 idx = addServerNamespace(ctx->server, &ctx->pendingNamespaces[i]);
+        if(idx != ctx->serverNamespacesSize + i)
+            status = false;
+    }
+    UA_Array_delete(ctx->pendingNamespaces, ctx->pendingNamespacesSize,
+                    &UA_TYPES[UA_TYPES_STRING]);
+    ctx->pendingNamespaces = NULL;
+    ctx->pendingNamespacesSize = 0;
+    ctx->deferNamespaces = false;
+    if(!status)
+        ctx->logger->log(ctx->logger->context, NODESETLOADER_LOGLEVEL_ERROR,
+                         "Namespaces were added to the server during the import");
+    return status;
+}
+
 // Use AddNodeContext_addNamespaceIdx to sequentially add namespaces as they
 // appear in the nodeset file. This adds the namespaces to the server also.
 // Returns the local mapping index, not the in-server mapping index.
@@ -20,10 +74,7 @@ static void
 AddNodeContext_addNamespace(AddNodeContext *ctx, const UA_String nsUri,
                             bool localOnly) {
     // Get the index / add to the server if required
-    char namebuf[512];
-    memcpy(namebuf, nsUri.data, nsUri.length);
-    namebuf[nsUri.length] = 0;
-    UA_UInt16 localIdx = UA_Server_addNamespace(ctx->server, namebuf);
+    UA_UInt16 localIdx = getServerNamespace(ctx, &nsUri);
 
     // Add to the local mapping
     UA_StatusCode res =
@@ -49,7 +100,7 @@ AddNodeContext_addNamespace(AddNodeContext *ctx, const UA_String nsUri,
     // We don't need local2remote since we are only parsing the remote
 }
 
-static void
+void
 AddNodeContext_init(AddNodeContext *ctx,
                     struct UA_Server *server,
                     NodesetLoader_Logger *logger) {
@@ -71,32 +122,31 @@ AddNodeContext_init(AddNodeContext *ctx,
         UA_String_clear(&nsUri);
         idx++;
     }
-    
-    // Get all ReferenceTypes that can point to the parent
+}
+
+void
+AddNodeContext_clear(AddNodeContext *ctx) {
+    UA_NamespaceMapping_clear(&ctx->nsMapping);
+    UA_Array_delete(ctx->pendingNamespaces, ctx->pendingNamespacesSize,
+                    &UA_TYPES[UA_TYPES_STRING]);
+}
+
+// Register the subtypes of HasChild already known to the server with the
+// loader. Subtypes from the imported files are resolved while sorting.
+static void
+addServerParentRefTypes(NodesetLoader *loader, UA_Server *server) {
     UA_BrowseDescription bd;
     UA_BrowseDescription_init(&bd);
     bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
     bd.referenceTypeId = UA_NS0ID(HASSUBTYPE);
     bd.nodeId = UA_NS0ID(HASCHILD);
 
-    UA_Server_browseRecursive(server, &bd,
-                              &ctx->parentRefTypesSize,
-                              &ctx->parentRefTypes);
-
-    // Include HasChild itself
-    UA_ExpandedNodeId hasChildExp;
-    UA_ExpandedNodeId_init(&hasChildExp);
-    hasChildExp.nodeId = UA_NS0ID(HASCHILD);
-    UA_Array_append((void**)&ctx->parentRefTypes,
-                    &ctx->parentRefTypesSize, &hasChildExp,
-                    &UA_TYPES[UA_TYPES_EXPANDEDNODEID]);
-}
-
-static void
-AddNodeContext_clear(AddNodeContext *ctx) {
-    UA_NamespaceMapping_clear(&ctx->nsMapping);
-    UA_Array_delete(ctx->parentRefTypes, ctx->parentRefTypesSize,
-                    &UA_TYPES[UA_TYPES_EXPANDEDNODEID]);
+    size_t refTypesSize = 0;
+    UA_ExpandedNodeId *refTypes = NULL;
+    UA_Server_browseRecursive(server, &bd, &refTypesSize, &refTypes);
+    for(size_t i = 0; i < refTypesSize; i++)
+        NodesetLoader_addParentReferenceType(loader, &refTypes[i].nodeId);
+    UA_Array_delete(refTypes, refTypesSize, &UA_TYPES[UA_TYPES_EXPANDEDNODEID]);
 }
 
 static inline UA_Boolean isValTrue(const char *s) {
@@ -108,24 +158,17 @@ static inline UA_Boolean isValTrue(const char *s) {
 }
 
 UA_NodeId
-getParentId(const AddNodeContext *ctx, const NL_Node *node, UA_NodeId *parentRefId) {
-    for(NL_Reference *ref = node->refs; ref != NULL; ref = ref->next) {
-        if(ref->isForward)
-            continue;
-        for(size_t i = 0; i < ctx->parentRefTypesSize; i++) {
-            if(UA_NodeId_equal(&ref->refType, &ctx->parentRefTypes[i].nodeId)) {
-                if(parentRefId)
-                    *parentRefId = ref->refType;
-                return ref->target;
-            }
-        }
-    }
-    return UA_NODEID_NULL;
+getParentId(const NL_Node *node, UA_NodeId *parentRefId) {
+    if(!node->parentRef)
+        return UA_NODEID_NULL;
+    if(parentRefId)
+        *parentRefId = node->parentRef->refType;
+    return node->parentRef->target;
 }
 
 static UA_NodeId
 getTypeDefId(const NL_Node *node) {
-    static UA_NodeId typeDefId = {0, UA_NODEIDTYPE_NUMERIC, {UA_NS0ID_HASTYPEDEFINITION}};
+    static const UA_NodeId typeDefId = {0, UA_NODEIDTYPE_NUMERIC, {UA_NS0ID_HASTYPEDEFINITION}};
     for(NL_Reference *ref = node->refs; ref != NULL; ref = ref->next) {
         if(!ref->isForward)
             continue;
@@ -135,15 +178,39 @@ getTypeDefId(const NL_Node *node) {
     return UA_NODEID_NULL;
 }
 
+void
+getObjectAttributes(const NL_ObjectNode *node, UA_ObjectAttributes *attr) {
+    *attr = UA_ObjectAttributes_default;
+    attr->displayName = node->displayName;
+    attr->description = node->description;
+    attr->eventNotifier = (UA_Byte)atoi(node->eventNotifier);
+}
+
+void
+getViewAttributes(const NL_ViewNode *node, UA_ViewAttributes *attr) {
+    *attr = UA_ViewAttributes_default;
+    attr->displayName = node->displayName;
+    attr->description = node->description;
+    attr->eventNotifier = (UA_Byte)atoi(node->eventNotifier);
+    attr->containsNoLoops = isValTrue(node->containsNoLoops);
+}
+
+void
+getMethodAttributes(const NL_MethodNode *node, UA_MethodAttributes *attr) {
+    *attr = UA_MethodAttributes_default;
+    attr->executable = isValTrue(node->executable);
+    attr->userExecutable = isValTrue(node->userExecutable);
+    attr->displayName = node->displayName;
+    attr->description = node->description;
+}
+
 static UA_StatusCode
 handleObjectNode(const NL_ObjectNode *node, UA_NodeId *id,
                  const UA_NodeId *parentId, const UA_NodeId *parentReferenceId,
                  const UA_LocalizedText *lt, const UA_QualifiedName *qn,
                  const UA_LocalizedText *description, UA_Server *server) {
-    UA_ObjectAttributes oAttr = UA_ObjectAttributes_default;
-    oAttr.displayName = *lt;
-    oAttr.description = *description;
-    oAttr.eventNotifier = (UA_Byte)atoi(node->eventNotifier);
+    UA_ObjectAttributes oAttr;
+    getObjectAttributes(node, &oAttr);
 
     UA_NodeId typeDefId = getTypeDefId((const NL_Node*)node);
 
@@ -160,11 +227,8 @@ handleViewNode(const NL_ViewNode *node, UA_NodeId *id, const UA_NodeId *parentId
                const UA_NodeId *parentReferenceId, const UA_LocalizedText *lt,
                const UA_QualifiedName *qn, const UA_LocalizedText *description,
                UA_Server *server) {
-    UA_ViewAttributes attr = UA_ViewAttributes_default;
-    attr.displayName = *lt;
-    attr.description = *description;
-    attr.eventNotifier = (UA_Byte)atoi(node->eventNotifier);
-    attr.containsNoLoops = isValTrue(node->containsNoLoops);
+    UA_ViewAttributes attr;
+    getViewAttributes(node, &attr);
     return UA_Server_addViewNode(server, *id, *parentId, *parentReferenceId,
                                  *qn, attr, node->extension, NULL);
 }
@@ -174,11 +238,8 @@ handleMethodNode(const NL_MethodNode *node, UA_NodeId *id,
                  const UA_NodeId *parentId, const UA_NodeId *parentReferenceId,
                  const UA_LocalizedText *lt, const UA_QualifiedName *qn,
                  const UA_LocalizedText *description, UA_Server *server) {
-    UA_MethodAttributes attr = UA_MethodAttributes_default;
-    attr.executable = isValTrue(node->executable);
-    attr.userExecutable = isValTrue(node->userExecutable);
-    attr.displayName = *lt;
-    attr.description = *description;
+    UA_MethodAttributes attr;
+    getMethodAttributes(node, &attr);
 
     return UA_Server_addMethodNode(server, *id, *parentId, *parentReferenceId,
                                    *qn, attr, NULL, 0, NULL, 0, NULL,
@@ -209,43 +270,59 @@ getArrayDimensions(const char *s, UA_UInt32 **dims) {
     return arrSize;
 }
 
-static UA_StatusCode
-handleVariableNode(const NL_VariableNode *node, UA_NodeId *id,
-                   const UA_NodeId *parentId,
-                   const UA_NodeId *parentReferenceId,
-                   const UA_LocalizedText *lt,
-                   const UA_QualifiedName *qn,
-                   const UA_LocalizedText *description,
-                   AddNodeContext *context) {
-    UA_Server *server = context->server;
+static void
+setSingleArrayDimension(UA_VariableAttributes *attr, UA_UInt32 dim) {
+    attr->arrayDimensions = (UA_UInt32 *)malloc(sizeof(UA_UInt32));
+    if(!attr->arrayDimensions)
+        return;
+    attr->arrayDimensions[0] = dim;
+    attr->arrayDimensionsSize = 1;
+}
 
-    UA_VariableAttributes attr = UA_VariableAttributes_default;
-    attr.displayName = *lt;
-    attr.dataType = node->datatype;
-    attr.valueRank = atoi(node->valueRank);
+void
+getVariableAttributes(AddNodeContext *context, const NL_VariableNode *node,
+                      UA_VariableAttributes *attr, DecodedValue **decoded) {
+    *attr = UA_VariableAttributes_default;
+    attr->displayName = node->displayName;
+    attr->dataType = node->datatype;
+    attr->valueRank = atoi(node->valueRank);
     UA_UInt32 *arrDims = NULL;
-    attr.arrayDimensionsSize =
+    attr->arrayDimensionsSize =
         getArrayDimensions(node->arrayDimensions, &arrDims);
-    attr.arrayDimensions = arrDims;
-    attr.accessLevel = (UA_Byte)atoi(node->accessLevel);
-    attr.userAccessLevel = (UA_Byte)atoi(node->userAccessLevel);
-    attr.description = *description;
-    attr.historizing = isValTrue(node->historizing);
-    attr.minimumSamplingInterval = atof(node->minimumSamplingInterval);
+    attr->arrayDimensions = arrDims;
+    attr->accessLevel = (UA_Byte)atoi(node->accessLevel);
+    attr->userAccessLevel = (UA_Byte)atoi(node->userAccessLevel);
+    attr->description = node->description;
+    attr->historizing = isValTrue(node->historizing);
+    attr->minimumSamplingInterval = atof(node->minimumSamplingInterval);
 
     char buf[128];
     memset(buf, 0, 128);
     UA_String idBuf = {128, (UA_Byte*)buf};
-    UA_NodeId_print(id, &idBuf);
-
-    UA_StatusCode ret = UA_STATUSCODE_GOOD;
-    if(node->value.length > 0) {
+    UA_NodeId_print(&node->id, &idBuf);
+
+    *decoded = NULL;
+    size_t lazyArrayLength = 0;
+    if(context->decodedValues)
+        *decoded = DecodedValues_get(context->decodedValues, (const NL_Node*)node);
+    if(*decoded) {
+        // Shallow copy, the value may be shared with other nodes
+        attr->value = (*decoded)->source->value;
+        if((*decoded)->source->status != UA_STATUSCODE_GOOD) {
+            context->logger->log(context->logger->context, NODESETLOADER_LOGLEVEL_WARNING,
+                                 "Failed to parse the value of %s", buf);
+        }
+    } else if(LazyValue_isLazy(context, (const NL_Node *)node)) {
+        // Same ArrayDimensions as with the decoded value
+        lazyArrayLength = LazyValue_arrayLength(node);
+    } else if(node->value.length > 0) {
         UA_DecodeXmlOptions opts;
         memset(&opts, 0, sizeof(UA_DecodeXmlOptions));
         opts.unwrapped = true;
-        opts.customTypes = UA_Server_getDataTypes(server);
+        opts.customTypes = UA_Server_getDataTypes(context->server);
         opts.namespaceMapping = &context->nsMapping;
-        ret = UA_decodeXml(&node->value, &attr.value, &UA_TYPES[UA_TYPES_VARIANT], &opts);
+        UA_StatusCode ret =
+            UA_decodeXml(&node->value, &attr->value, &UA_TYPES[UA_TYPES_VARIANT], &opts);
         if(ret != UA_STATUSCODE_GOOD) {
             context->logger->log(context->logger->context, NODESETLOADER_LOGLEVEL_WARNING,
                                  "Failed to parse the value of %s", buf);
@@ -254,33 +331,50 @@ handleVariableNode(const NL_VariableNode *node, UA_NodeId *id,
 
     // this case is only needed for the euromap83 comparison, think the nodeset
     // is not valid
-    UA_UInt32 arrayDims;
-    if (attr.arrayDimensions == NULL && attr.valueRank == 1) {
-        attr.arrayDimensionsSize = 1;
-        arrayDims = 0;
-        attr.arrayDimensions = &arrayDims;
-    }
+    if (attr->arrayDimensions == NULL && attr->valueRank == 1)
+        setSingleArrayDimension(attr, 0);
 
     // set arraydimensions of none defined but value is an array
-    if (attr.arrayDimensionsSize == 0 && attr.value.arrayLength) {
-        arrayDims = (UA_UInt32)attr.value.arrayLength;
-        attr.arrayDimensions = &arrayDims;
-        attr.arrayDimensionsSize = 1;
-    }
+    size_t arrayLength = attr->value.arrayLength + lazyArrayLength;
+    if (attr->arrayDimensionsSize == 0 && arrayLength)
+        setSingleArrayDimension(attr, (UA_UInt32)arrayLength);
+}
+
+void
+clearVariableAttributes(UA_VariableAttributes *attr, DecodedValue *decoded) {
+    if(decoded)
+        DecodedValues_release(decoded);
+    else
+        UA_Variant_clear(&attr->value);
+    free(attr->arrayDimensions);
+    attr->arrayDimensions = NULL;
+    attr->arrayDimensionsSize = 0;
+}
+
+static UA_StatusCode
+handleVariableNode(const NL_VariableNode *node, UA_NodeId *id,
+                   const UA_NodeId *parentId,
+                   const UA_NodeId *parentReferenceId,
+                   const UA_LocalizedText *lt,
+                   const UA_QualifiedName *qn,
+                   const UA_LocalizedText *description,
+                   AddNodeContext *context) {
+    UA_VariableAttributes attr;
+    DecodedValue *decoded = NULL;
+    getVariableAttributes(context, node, &attr, &decoded);
 
     UA_NodeId typeDefId = getTypeDefId((const NL_Node*)node);
 
     //value is copied by open62541
-    ret = UA_Server_addNode_begin(server, UA_NODECLASS_VARIABLE, *id, *parentId,
-                                  *parentReferenceId, *qn, typeDefId, &attr,
-                                  &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES],
-                                  node->extension, NULL);
+    UA_StatusCode ret =
+        UA_Server_addNode_begin(context->server, UA_NODECLASS_VARIABLE, *id,
+                                *parentId, *parentReferenceId, *qn, typeDefId,
+                                &attr, &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES],
+                                node->extension, NULL);
     //cannot call addNode finish, otherwise the nodes for e.g. range will be instantiated twice
     //UA_Server_addNode_finish(server, *id);
 
-    UA_Variant_clear(&attr.value);
-    if(attr.arrayDimensions && attr.arrayDimensions != &arrayDims)
-        UA_free(attr.arrayDimensions);
+    clearVariableAttributes(&attr, decoded);
     return ret;
 }
 
@@ -355,9 +449,7 @@ handleDataTypeNode(AddNodeContext *ctx,
                    const UA_LocalizedText *lt,
                    const UA_QualifiedName *qn,
                    const UA_LocalizedText *description) {
-    // Add the UA_DataType the the server
-    addCustomDataType(ctx, node);
-
+    // The UA_DataType was already added to the server in addCustomDataTypes
     // Add the DataTypeNode
     UA_DataTypeAttributes attr = UA_DataTypeAttributes_default;
     attr.displayName = *lt;
@@ -368,18 +460,20 @@ handleDataTypeNode(AddNodeContext *ctx,
                                      attr, node->extension, NULL);
 }
 
-static bool
+bool
 addNodeFinish(AddNodeContext *context, NL_Node *node) {
     UA_StatusCode res =
         UA_Server_addNode_finish(context->server, node->id);
+    if(res == UA_STATUSCODE_GOOD && LazyValue_isLazy(context, node))
+        res = LazyValue_attach(context, (const NL_VariableNode *)node);
     return (res == UA_STATUSCODE_GOOD);
 }
 
-static bool
+bool
 addNodeImpl(AddNodeContext *context, NL_Node *node) {
     UA_NodeId id = node->id;
     UA_NodeId parentReferenceId = UA_NODEID_NULL;
-    UA_NodeId parentId = getParentId(context, node, &parentReferenceId);
+    UA_NodeId parentId = getParentId(node, &parentReferenceId);
     UA_LocalizedText lt = node->displayName;
     UA_QualifiedName qn = node->browseName;
     UA_LocalizedText description = node->description;
@@ -459,14 +553,22 @@ logToOpen(void *context, enum NodesetLoader_LogLevel level,
     case NODESETLOADER_LOGLEVEL_WARNING:
         uaLevel = UA_LOGLEVEL_WARNING;
         break;
+    case NODESETLOADER_LOGLEVEL_INFO:
+        uaLevel = UA_LOGLEVEL_INFO;
+        break;
     }
     logger->log(logger->context, uaLevel, UA_LOGCATEGORY_USERLAND, message, vl);
     va_end(vl);
 }
 
-static bool
+bool
 addAllRefs(AddNodeContext *context, NL_Node *node) {
     for(NL_Reference *ref = node->refs; ref != NULL; ref = ref->next) {
+        if(ref->isImplied)
+            continue;
+        // Added when the target is materialized (LazyNodestore_attach)
+        if(context->lazy && LazyNodestore_isPending(context->lazy, &ref->target))
+            continue;
         UA_ExpandedNodeId target = UA_EXPANDEDNODEID_NULL;
         target.nodeId = ref->target;
         UA_StatusCode res =
@@ -479,64 +581,616 @@ addAllRefs(AddNodeContext *context, NL_Node *node) {
     return true;
 }
 
+// A backend step for one node, optionally traced if it is slow. The node is
+// counted for the progress, the pass stops when the import is canceled. A
+// failed step is counted in the context and the pass continues.
+typedef struct {
+    NodesetLoader *loader;
+    AddNodeContext *anc;
+    NodesetLoader_forEachNode_Func fn;
+    NL_Phase phase;
+    bool traceNodes;
+} Step;
+
+static bool
+runNodeStep(Step *step, NL_Node *node) {
+    UA_DateTime begin = 0;
+    if(step->traceNodes)
+        begin = UA_DateTime_nowMonotonic();
+    bool res = step->fn(step->anc, node);
+    if(step->traceNodes)
+        NodesetLoader_traceNode(step->loader, node, step->phase, begin);
+    if(!res)
+        step->anc->failedSteps++;
+    size_t inserted = (res && step->phase == NL_PHASE_FINISHNODES) ? 1 : 0;
+    return NodesetLoader_reportStep(step->loader, inserted);
+}
+
+// Returns false if the import was canceled
 static bool
-addNodes(NodesetLoader *loader, AddNodeContext *anc) {
+runStep(NodesetLoader *loader, AddNodeContext *anc,
+        NodesetLoader_forEachNode_Func fn, NL_Phase phase) {
+    NodesetLoader_startPhase(loader, phase);
+    Step step = {loader, anc, fn, phase, NodesetLoader_tracesNodes(loader)};
+    NodesetLoader_forEachNode(loader, &step,
+                              (NodesetLoader_forEachNode_Func)runNodeStep);
+    NodesetLoader_stopPhase(loader, phase);
+    return !NodesetLoader_isCanceled(loader);
+}
+
+static bool
+addNodesThreePass(NodesetLoader *loader, AddNodeContext *anc) {
 
     // Add all nodes with their type definition and parent
-    NodesetLoader_forEachNode(loader, anc,
-                              (NodesetLoader_forEachNode_Func)addNodeImpl);
+    if(!runStep(loader, anc, (NodesetLoader_forEachNode_Func)addNodeImpl,
+                NL_PHASE_ADDNODES))
+        return false;
 
     // Add additional non-hierarchical references
-    NodesetLoader_forEachNode(loader, anc,
-                              (NodesetLoader_forEachNode_Func)addAllRefs);
+    if(!runStep(loader, anc, (NodesetLoader_forEachNode_Func)addAllRefs,
+                NL_PHASE_ADDREFS))
+        return false;
 
     // Call AddNode_finish for all nodes
-    NodesetLoader_forEachNode(loader, anc,
-                              (NodesetLoader_forEachNode_Func)addNodeFinish);
+    return runStep(loader, anc, (NodesetLoader_forEachNode_Func)addNodeFinish,
+                   NL_PHASE_FINISHNODES);
+}
 
-    return true;
+// The three steps for a window of nodes. No node of the window is referenced
+// from a later window. So the window is complete after the three steps and
+// addNode_finish sees the same children and references as in the three-pass
+// mode. The time of a phase is summed over the windows and added to the stats
+// once per pass.
+typedef struct {
+    NodesetLoader *loader;
+    AddNodeContext *anc;
+    bool timed;
+    bool traceNodes;
+    NL_PhaseTime times[NL_PHASE_COUNT];
+} WindowContext;
+
+// Runs the step for the nodes of a window. A failed step is counted as in
+// runNodeStep. Returns false if the import was canceled.
+static bool
+runWindowStep(WindowContext *wc, NL_Node **nodes, size_t nodesSize,
+              NodesetLoader_forEachNode_Func fn, NL_Phase phase) {
+    UA_DateTime wallStart = 0;
+    clock_t cpuStart = 0;
+    if(wc->timed) {
+        wallStart = UA_DateTime_nowMonotonic();
+        cpuStart = clock();
+    }
+    for(size_t i = 0; i < nodesSize; i++) {
+        UA_DateTime begin = 0;
+        if(wc->traceNodes)
+            begin = UA_DateTime_nowMonotonic();
+        bool res = fn(wc->anc, nodes[i]);
+        if(wc->traceNodes)
+            NodesetLoader_traceNode(wc->loader, nodes[i], phase, begin);
+        if(!res)
+            wc->anc->failedSteps++;
+        size_t inserted = (res && phase == NL_PHASE_FINISHNODES) ? 1 : 0;
+        if(!NodesetLoader_reportStep(wc->loader, inserted))
+            break;
+    }
+    if(wc->timed) {
+        wc->times[phase].cpuTime +=
+            (double)(clock() - cpuStart) / CLOCKS_PER_SEC;
+        wc->times[phase].wallTime +=
+            (double)(UA_DateTime_nowMonotonic() - wallStart) / UA_DATETIME_SEC;
+    }
+    return !NodesetLoader_isCanceled(wc->loader);
+}
+
+static bool
+addWindow(WindowContext *wc, NL_Node **nodes, size_t nodesSize) {
+    if(!runWindowStep(wc, nodes, nodesSize,
+                      (NodesetLoader_forEachNode_Func)addNodeImpl,
+                      NL_PHASE_ADDNODES))
+        return false;
+    if(!runWindowStep(wc, nodes, nodesSize,
+                      (NodesetLoader_forEachNode_Func)addAllRefs,
+                      NL_PHASE_ADDREFS))
+        return false;
+    return runWindowStep(wc, nodes, nodesSize,
+                         (NodesetLoader_forEachNode_Func)addNodeFinish,
+                         NL_PHASE_FINISHNODES);
+}
+
+static bool
+addNodesFused(NodesetLoader *loader, AddNodeContext *anc) {
+    WindowContext wc;
+    memset(&wc, 0, sizeof(WindowContext));
+    wc.loader = loader;
+    wc.anc = anc;
+    wc.timed = NodesetLoader_timesPhases(loader);
+    wc.traceNodes = NodesetLoader_tracesNodes(loader);
+    bool status = NodesetLoader_forEachWindow(
+        loader, &wc, (NodesetLoader_forEachWindow_Func)addWindow);
+    NodesetLoader_addPhaseTime(loader, NL_PHASE_ADDNODES,
+                               &wc.times[NL_PHASE_ADDNODES]);
+    NodesetLoader_addPhaseTime(loader, NL_PHASE_ADDREFS,
+                               &wc.times[NL_PHASE_ADDREFS]);
+    NodesetLoader_addPhaseTime(loader, NL_PHASE_FINISHNODES,
+                               &wc.times[NL_PHASE_FINISHNODES]);
+    return status;
+}
+
+// Both insertion modes continue after a failed node and fail at the end
+bool
+checkFailedSteps(const AddNodeContext *anc) {
+    if(anc->failedSteps == 0)
+        return true;
+    anc->logger->log(anc->logger->context, NODESETLOADER_LOGLEVEL_ERROR,
+                     "%lu steps of adding the nodes failed",
+                     (unsigned long)anc->failedSteps);
+    return false;
+}
+
+static bool
+addNodes(NodesetLoader *loader, AddNodeContext *anc,
+         NodesetLoader_InsertionMode mode) {
+    bool status;
+    if(mode == NODESETLOADER_INSERTION_THREEPASS) {
+        status = addNodesThreePass(loader, anc);
+    } else {
+        status = addNodesFused(loader, anc);
+    }
+    // Report the nodes of the last interval
+    if(!NodesetLoader_reportProgress(loader))
+        return false;
+    return status && checkFailedSteps(anc);
+}
+
+static void
+logStats(NodesetLoader_Logger *logger, const NL_Stats *stats) {
+    for(size_t i = 0; i < NL_PHASE_COUNT; i++) {
+        logger->log(logger->context, NODESETLOADER_LOGLEVEL_INFO,
+                    "Phase %s: %.3f s wall, %.3f s cpu, peak rss %lu kB",
+                    NL_PHASE_NAME[i], stats->phases[i].wallTime,
+                    stats->phases[i].cpuTime,
+                    (unsigned long)stats->peakRssKb[i]);
+    }
+    for(size_t i = 0; i < NL_MEMORY_COUNT; i++) {
+        logger->log(logger->context, NODESETLOADER_LOGLEVEL_INFO,
+                    "Memory %s: %lu bytes live, %lu bytes peak", NL_MEMORY_NAME[i],
+                    (unsigned long)stats->memory[i].live,
+                    (unsigned long)stats->memory[i].peak);
+    }
+    for(size_t i = 0; i < NL_NODECLASS_COUNT; i++) {
+        logger->log(logger->context, NODESETLOADER_LOGLEVEL_INFO,
+                    "%s nodes: %lu", NL_NODECLASS_NAME[i],
+                    (unsigned long)stats->nodes[i]);
+    }
+    logger->log(logger->context, NODESETLOADER_LOGLEVEL_INFO,
+                "References: %lu, aliases: %lu, arena bytes: %lu",
+                (unsigned long)stats->references,
+                (unsigned long)stats->aliases,
+                (unsigned long)stats->charArenaBytes);
+    logger->log(logger->context, NODESETLOADER_LOGLEVEL_INFO,
+                "%.1f bytes per node, %.1f bytes per reference",
+                stats->bytesPerNode, stats->bytesPerReference);
 }
 
 bool
 NodesetLoader_loadFile(struct UA_Server *server, const char *path,
                        NodesetLoader_ExtensionInterface *extensionHandling) {
-    if(!server)
-        return false;
+    NodesetLoader_Options options;
+    memset(&options, 0, sizeof(NodesetLoader_Options));
+    options.extensionHandling = extensionHandling;
+    return NodesetLoader_loadFileWithOptions(server, path, &options);
+}
+
+static void
+logNothing(void *context, enum NodesetLoader_LogLevel level,
+           const char *message, ...) {}
 
+// The model keeps its logger, it must not log to a deleted server
+static void
+unbindLogger(NodesetLoader_Logger *logger) {
+    logger->context = NULL;
+    logger->log = &logNothing;
+}
+
+// Log to the logger of the server config
+static void
+bindLogger(NodesetLoader_Logger *logger, UA_Server *server) {
     UA_ServerConfig *config = UA_Server_getConfig(server);
-    NodesetLoader_Logger *logger =
-        (NodesetLoader_Logger *)calloc(1, sizeof(NodesetLoader_Logger));
 #if UA_OPEN62541_VER_MAJOR == 1 && UA_OPEN62541_VER_MINOR < 4
     logger->context = (void*)(uintptr_t)&config->logger;
 #else
     logger->context = (void*)(uintptr_t)config->logging;
 #endif
     logger->log = &logToOpen;
+}
 
-    AddNodeContext ctx;
-    AddNodeContext_init(&ctx, server, logger);
-    NodesetLoader *loader = NodesetLoader_new(logger);
+NodesetLoader_Logger *
+newLogger(UA_Server *server) {
+    NodesetLoader_Logger *logger =
+        (NodesetLoader_Logger *)calloc(1, sizeof(NodesetLoader_Logger));
+    if(!logger)
+        return NULL;
+    bindLogger(logger, server);
+    return logger;
+}
+
+void
+prepareImport(NodesetLoader *loader, UA_Server *server,
+              const NodesetLoader_Options *options) {
+    addServerParentRefTypes(loader, server);
+    NodesetLoader_setProgressCallback(loader, options->progress,
+                                      options->progressContext);
+    if(options->stats || options->logStats)
+        NodesetLoader_enableTiming(loader);
+    if(options->tracePath)
+        NodesetLoader_startTrace(loader, options->traceSlowNodeThreshold);
+}
 
+bool
+parseAndSort(NodesetLoader *loader, AddNodeContext *ctx, const char *path,
+             const NodesetLoader_Options *options) {
     NL_FileContext handler;
     memset(&handler, 0, sizeof(NL_FileContext));
     handler.addNamespace = NodesetLoader_BackendOpen62541_addNamespace;
-    handler.userContext = &ctx;
+    handler.userContext = ctx;
     handler.file = path;
-    handler.extensionHandling = extensionHandling;
-    handler.nsMapping = &ctx.nsMapping; // Provide the pre-filled mapping
+    handler.extensionHandling = options->extensionHandling;
+    handler.captureRawExtensions = options->captureRawExtensions;
+    ctx->rawExtensions = options->captureRawExtensions;
+    handler.nsMapping = &ctx->nsMapping; // Provide the pre-filled mapping
 
-    logger->log(logger->context, NODESETLOADER_LOGLEVEL_DEBUG,
-                "Start import nodeset: %s", path);
+    ctx->logger->log(ctx->logger->context, NODESETLOADER_LOGLEVEL_DEBUG,
+                     "Start import nodeset: %s", path);
     bool status = NodesetLoader_importFile(loader, &handler);
     if(status)
         status = NodesetLoader_sort(loader);
-    if(status)
-        status = addNodes(loader, &ctx);
-    if(!status)
+    if(status) {
+        ReferenceFilterStats refStats = markImpliedReferences(loader);
+        ctx->logger->log(ctx->logger->context, NODESETLOADER_LOGLEVEL_DEBUG,
+                         "Skipping %lu of %lu references that are created with "
+                         "the node or another reference",
+                         (unsigned long)refStats.implied,
+                         (unsigned long)refStats.references);
+    }
+    return status;
+}
+
+// Parse and sort the file. The namespaces are added to the server.
+static bool
+importAndSort(NodesetLoader *loader, AddNodeContext *ctx, const char *path,
+              const NodesetLoader_Options *options) {
+    prepareImport(loader, ctx->server, options);
+    return parseAndSort(loader, ctx, path, options);
+}
+
+// Log and return the stats, write the trace
+void
+finishImport(NodesetLoader *loader, NodesetLoader_Logger *logger,
+             const NodesetLoader_Options *options) {
+    if(options->logStats || options->stats) {
+        NL_Stats stats;
+        NodesetLoader_getStats(loader, &stats);
+        if(options->logStats)
+            logStats(logger, &stats);
+        if(options->stats)
+            *options->stats = stats;
+    }
+    if(options->tracePath && !NodesetLoader_writeTrace(loader, options->tracePath))
+        logger->log(logger->context, NODESETLOADER_LOGLEVEL_WARNING,
+                    "Cannot write the trace to %s", options->tracePath);
+}
+
+bool
+NodesetLoader_loadFileWithOptions(struct UA_Server *server, const char *path,
+                                  const NodesetLoader_Options *options) {
+    if(!server)
+        return false;
+
+    NodesetLoader_Options defaultOptions;
+    if(!options) {
+        memset(&defaultOptions, 0, sizeof(NodesetLoader_Options));
+        options = &defaultOptions;
+    }
+
+    NodesetLoader_Logger *logger = newLogger(server);
+    if(!logger)
+        return false;
+    AddNodeContext ctx;
+    AddNodeContext_init(&ctx, server, logger);
+    ctx.valueStore = options->valueStore;
+    ctx.lazyValueThreshold = options->lazyValueThreshold;
+    NodesetLoader *loader = NodesetLoader_new(logger);
+    bool status = importAndSort(loader, &ctx, path, options);
+    if(status) {
+        // Add the UA_DataTypes first, so the values of all Variables can be
+        // decoded before the insertion starts
+        NodesetLoader_startPhase(loader, NL_PHASE_DATATYPES);
+        addCustomDataTypes(&ctx, loader);
+        NodesetLoader_stopPhase(loader, NL_PHASE_DATATYPES);
+        DecodedValues decodedValues;
+        NodesetLoader_startPhase(loader, NL_PHASE_VALUES);
+        if(DecodedValues_decode(&decodedValues, loader, &ctx,
+                                UA_Server_getDataTypes(server),
+                                options->valueDecodeThreads))
+            ctx.decodedValues = &decodedValues;
+        NodesetLoader_stopPhase(loader, NL_PHASE_VALUES);
+        if(ctx.decodedValues) {
+            logger->log(logger->context, NODESETLOADER_LOGLEVEL_DEBUG,
+                        "Value decode cache: %lu hits, %lu misses",
+                        (unsigned long)decodedValues.cacheHits,
+                        (unsigned long)decodedValues.cacheMisses);
+        }
+        status = addNodes(loader, &ctx, options->insertionMode);
+        if(ctx.decodedValues)
+            DecodedValues_clear(ctx.decodedValues);
+        ctx.decodedValues = NULL;
+    }
+    if(!status && NodesetLoader_isCanceled(loader))
+        logger->log(logger->context, NODESETLOADER_LOGLEVEL_ERROR,
+                    "The import was canceled");
+    else if(!status)
         logger->log(logger->context, NODESETLOADER_LOGLEVEL_ERROR,
                     "Importing the nodeset failed, nodes were not added");
+    finishImport(loader, logger, options);
+    if(ctx.rawExtensions)
+        RawExtensions_handOver(server, loader);
     NodesetLoader_delete(loader);
     AddNodeContext_clear(&ctx);
     free(logger);
     return status;
 }
+
+// A nodeset parsed once and inserted into several servers. The nodes, the
+// DataTypes and the decoded values are shared by all servers.
+typedef struct ModelTypeArray {
+    UA_DataTypeArray array; // Prepended to the custom types of one server
+    struct ModelTypeArray *next;
+} ModelTypeArray;
+
+struct NodesetLoader_Model {
+    NodesetLoader *loader;
+    NodesetLoader_Logger *logger; // Bound to the server during new and apply
+    NodesetLoader_Options options;
+    AddNodeContext ctx; // The namespace mapping the nodes were parsed with
+    size_t serverNamespacesSize; // Leading entries of ctx.nsMapping.namespaceUris
+    UA_DataType *types;
+    size_t typesSize;
+    // Copies of the custom types of the creating server. The model types and
+    // the decoded values use them, so that server can be deleted.
+    UA_DataType *serverTypes;
+    size_t serverTypesSize;
+    UA_DataTypeArray serverTypeArray;
+    ModelTypeArray *typeArrays;
+    DecodedValues decodedValues;
+    bool decoded;
+};
+
+NodesetLoader_Model *
+NodesetLoader_Model_new(struct UA_Server *server, const char *path,
+                        const NodesetLoader_Options *options) {
+    if(!server)
+        return NULL;
+    NodesetLoader_Model *model =
+        (NodesetLoader_Model *)calloc(1, sizeof(NodesetLoader_Model));
+    if(!model)
+        return NULL;
+    if(options)
+        model->options = *options;
+    model->logger = newLogger(server);
+    if(!model->logger) {
+        free(model);
+        return NULL;
+    }
+    AddNodeContext_init(&model->ctx, server, model->logger);
+    model->serverNamespacesSize = model->ctx.nsMapping.namespaceUrisSize;
+    model->ctx.valueStore = model->options.valueStore;
+    model->ctx.lazyValueThreshold = model->options.lazyValueThreshold;
+    model->loader = NodesetLoader_new(model->logger);
+    if(!importAndSort(model->loader, &model->ctx, path, &model->options)) {
+        model->logger->log(model->logger->context, NODESETLOADER_LOGLEVEL_ERROR,
+                           "Importing the nodeset failed");
+        NodesetLoader_Model_delete(model);
+        return NULL;
+    }
+
+    // The types are added to the servers when the model is applied. The
+    // values are decoded with the types prepended to those of the server.
+    NodesetLoader_startPhase(model->loader, NL_PHASE_DATATYPES);
+    model->typesSize =
+        buildCustomDataTypes(&model->ctx, model->loader, &model->types);
+    NodesetLoader_stopPhase(model->loader, NL_PHASE_DATATYPES);
+    if(!copyServerDataTypes(server, model->types, model->typesSize,
+                            &model->serverTypes, &model->serverTypesSize)) {
+        model->logger->log(model->logger->context, NODESETLOADER_LOGLEVEL_ERROR,
+                           "Cannot copy the DataTypes of the server");
+        NodesetLoader_Model_delete(model);
+        return NULL;
+    }
+    UA_DataTypeArray serverTypes = {NULL, model->serverTypesSize,
+                                    model->serverTypes, false};
+    memcpy(&model->serverTypeArray, &serverTypes, sizeof(UA_DataTypeArray));
+    UA_DataTypeArray customTypes = {&model->serverTypeArray,
+                                    model->typesSize, model->types, false};
+    NodesetLoader_startPhase(model->loader, NL_PHASE_VALUES);
+    model->decoded =
+        DecodedValues_decode(&model->decodedValues, model->loader, &model->ctx,
+                             &customTypes, model->options.valueDecodeThreads);
+    if(model->decoded)
+        DecodedValues_keep(&model->decodedValues);
+    NodesetLoader_stopPhase(model->loader, NL_PHASE_VALUES);
+    model->ctx.server = NULL;
+    unbindLogger(model->logger);
+    return model;
+}
+
+// The namespaces of the nodeset have the same indices in the server as in the
+// server the model was created with
+static bool
+sameNamespaceIndices(const UA_NamespaceMapping *a, const UA_NamespaceMapping *b) {
+    if(a->remote2localSize != b->remote2localSize)
+        return false;
+    for(size_t i = 0; i < a->remote2localSize; i++) {
+        if(a->remote2local[i] != b->remote2local[i])
+            return false;
+    }
+    return true;
+}
+
+bool
+NodesetLoader_Model_apply(NodesetLoader_Model *model, struct UA_Server *server) {
+    if(!model || !server)
+        return false;
+    bindLogger(model->logger, server);
+    NodesetLoader_Logger *logger = model->logger;
+
+    // Map the namespaces in the order of the nodeset. They are only added to
+    // the server if the indices match, a rejected apply leaves it unchanged.
+    AddNodeContext ctx;
+    AddNodeContext_init(&ctx, server, logger);
+    ctx.serverNamespacesSize = ctx.nsMapping.namespaceUrisSize;
+    ctx.deferNamespaces = true;
+    for(size_t i = model->serverNamespacesSize;
+        i < model->ctx.nsMapping.namespaceUrisSize; i++)
+        AddNodeContext_addNamespace(&ctx, model->ctx.nsMapping.namespaceUris[i],
+                                    false);
+    bool status = sameNamespaceIndices(&ctx.nsMapping, &model->ctx.nsMapping);
+    if(!status)
+        logger->log(logger->context, NODESETLOADER_LOGLEVEL_ERROR,
+                    "The namespace indices of the server differ from the "
+                    "server the model was created with");
+    if(status)
+        status = AddNodeContext_addPendingNamespaces(&ctx);
+
+    if(status && model->typesSize > 0) {
+        ModelTypeArray *ta = (ModelTypeArray *)calloc(1, sizeof(ModelTypeArray));
+        status = (ta != NULL);
+        if(ta) {
+            prependCustomDataTypes(server, &ta->array, model->types,
+                                   model->typesSize, false);
+            ta->next = model->typeArrays;
+            model->typeArrays = ta;
+        }
+    }
+    if(status) {
+        ctx.valueStore = model->options.valueStore;
+        ctx.lazyValueThreshold = model->options.lazyValueThreshold;
+        if(model->decoded)
+            ctx.decodedValues = &model->decodedValues;
+        status = addNodes(model->loader, &ctx, model->options.insertionMode);
+    }
+    if(!status)
+        logger->log(logger->context, NODESETLOADER_LOGLEVEL_ERROR,
+                    "Applying the nodeset model failed");
+    finishImport(model->loader, logger, &model->options);
+    AddNodeContext_clear(&ctx);
+    unbindLogger(logger);
+    return status;
+}
+
+void
+NodesetLoader_Model_delete(NodesetLoader_Model *model) {
+    if(!model)
+        return;
+    if(model->decoded)
+        DecodedValues_clear(&model->decodedValues);
+    while(model->typeArrays) {
+        ModelTypeArray *ta = model->typeArrays;
+        model->typeArrays = ta->next;
+        free(ta);
+    }
+    for(size_t i = 0; i < model->typesSize; i++)
+        UA_DataType_clear(&model->types[i]);
+    free(model->types);
+    for(size_t i = 0; i < model->serverTypesSize; i++)
+        UA_DataType_clear(&model->serverTypes[i]);
+    free(model->serverTypes);
+    if(model->ctx.rawExtensions)
+        RawExtensions_delete(model->loader);
+    NodesetLoader_delete(model->loader);
+    AddNodeContext_clear(&model->ctx);
+    free(model->logger);
+    free(model);
+}
+
+// With the lazy nodestore only the type nodes are added through the server
+static bool
+addTypeNode(AddNodeContext *context, NL_Node *node) {
+    if(LazyNodestore_isLazyNodeClass(node->nodeClass))
+        return true;
+    return addNodeImpl(context, node);
+}
+
+static bool
+addTypeNodeRefs(AddNodeContext *context, NL_Node *node) {
+    if(LazyNodestore_isLazyNodeClass(node->nodeClass))
+        return true;
+    return addAllRefs(context, node);
+}
+
+static bool
+finishTypeNode(AddNodeContext *context, NL_Node *node) {
+    if(LazyNodestore_isLazyNodeClass(node->nodeClass))
+        return true;
+    return addNodeFinish(context, node);
+}
+
+bool
+NodesetLoader_loadFileLazy(struct UA_Server *server, const char *path,
+                           const NodesetLoader_Options *options) {
+    if(!server)
+        return false;
+    LazyNodestore *lazy = LazyNodestore_get(server);
+    if(!lazy)
+        return NodesetLoader_loadFileWithOptions(server, path, options);
+
+    NodesetLoader_Options defaultOptions;
+    if(!options) {
+        memset(&defaultOptions, 0, sizeof(NodesetLoader_Options));
+        options = &defaultOptions;
+    }
+
+    NodesetLoader_Logger *logger = newLogger(server);
+    if(!logger)
+        return false;
+    AddNodeContext ctx;
+    AddNodeContext_init(&ctx, server, logger);
+    NodesetLoader *loader = NodesetLoader_new(logger);
+    bool status = importAndSort(loader, &ctx, path, options);
+    if(status) {
+        NodesetLoader_startPhase(loader, NL_PHASE_DATATYPES);
+        addCustomDataTypes(&ctx, loader);
+        NodesetLoader_stopPhase(loader, NL_PHASE_DATATYPES);
+        // Index the instance nodes before the types are added, so references
+        // from the types to them are skipped
+        status = LazyNodestore_addModel(lazy, loader, &ctx);
+    }
+    if(!status) {
+        logger->log(logger->context, NODESETLOADER_LOGLEVEL_ERROR,
+                    "Importing the nodeset failed, nodes were not added");
+        finishImport(loader, logger, options);
+        if(ctx.rawExtensions)
+            RawExtensions_delete(loader);
+        NodesetLoader_delete(loader);
+        AddNodeContext_clear(&ctx);
+        free(logger);
+        return false;
+    }
+
+    // The store owns the loader, the mapping and the logger now
+    ctx.lazy = lazy;
+    status = runStep(loader, &ctx, (NodesetLoader_forEachNode_Func)addTypeNode,
+                     NL_PHASE_ADDNODES) &&
+             runStep(loader, &ctx, (NodesetLoader_forEachNode_Func)addTypeNodeRefs,
+                     NL_PHASE_ADDREFS) &&
+             runStep(loader, &ctx, (NodesetLoader_forEachNode_Func)finishTypeNode,
+                     NL_PHASE_FINISHNODES) &&
+             NodesetLoader_reportProgress(loader);
+    LazyNodestore_attach(lazy, loader);
+    if(!status)
+        logger->log(logger->context, NODESETLOADER_LOGLEVEL_ERROR,
+                    "The import was canceled");
+    else
+        status = checkFailedSteps(&ctx);
+    finishImport(loader, logger, options);
+    return status;
+}
@@ -10,6 +10,7 @@
 
 #include <open62541/server.h>
 #include "NodesetLoader/NodesetLoader.h"
+#include "NodesetLoader/backendOpen62541.h"
 
 #include <stdbool.h>
 #include <stdio.h>
@@ -18,22 +19,247 @@
 extern "C" {
 #endif
 
+// Variable values decoded ahead of the insertion
+typedef struct DecodedValue DecodedValue;
+struct DecodedValue {
+    const NL_VariableNode *node;
+    UA_UInt32 hash;
+    // Identical payloads of the same DataType are decoded once. All entries
+    // point to the entry that holds the variant (itself if decoded).
+    DecodedValue *source;
+    size_t users; // Nodes not yet inserted that share the variant
+    UA_Variant value;
+    UA_StatusCode status;
+};
+
 typedef struct {
+    DecodedValue *values;
+    size_t valuesSize;
+    DecodedValue **bySortIndex; // Lookup by NL_Node.sortIndex
+    size_t nodesSize;
+    size_t cacheHits;   // Values that reuse an identical decoded payload
+    size_t cacheMisses; // Values that were decoded
+    NodesetLoader *loader; // Accounts the arrays as NL_MEMORY_DECODE
+    const struct AddNodeContext *ctx; // Its lazy values are skipped
+} DecodedValues;
+
+typedef struct LazyNodestore LazyNodestore;
+
+typedef struct AddNodeContext {
     UA_Server *server;
     UA_NamespaceMapping nsMapping; // From the nodeset (local) to the server (remote)
     NodesetLoader_Logger *logger;
-
-    // ReferenceTypes that can point to a parent.
-    // Inherited from HasChild.
-    size_t parentRefTypesSize;
-    UA_ExpandedNodeId *parentRefTypes;
+    DecodedValues *decodedValues; // Can be NULL
+    LazyNodestore *lazy; // Can be NULL. References to its pending nodes are skipped.
+    // Values with at least lazyValueThreshold bytes of xml are decoded on the
+    // first read (see LazyValue_isLazy)
+    NodesetLoader_ValueStore *valueStore; // Can be NULL
+    size_t lazyValueThreshold;
+    const UA_NamespaceMapping *storedMapping; // Copy of nsMapping in valueStore
+    // Parsing without touching the server (e.g. in another thread). The new
+    // namespaces of the nodeset are collected in pendingNamespaces.
+    bool deferNamespaces;
+    size_t serverNamespacesSize; // Leading entries of nsMapping.namespaceUris
+    UA_String *pendingNamespaces;
+    size_t pendingNamespacesSize;
+    // Backend steps (add, references, finish) that failed. A failed node is
+    // skipped and the insertion continues, the import fails at the end.
+    size_t failedSteps;
+    // node->extension is the raw <Extensions> xml (captureRawExtensions)
+    bool rawExtensions;
 } AddNodeContext;
 
+// Fill the mapping with the namespaces of the server
+void
+AddNodeContext_init(AddNodeContext *ctx, struct UA_Server *server,
+                    NodesetLoader_Logger *logger);
+
+void
+AddNodeContext_clear(AddNodeContext *ctx);
+
+// Add the namespaces collected with deferNamespaces to the server. Returns
+// false if they do not get the predicted indices.
+bool
+AddNodeContext_addPendingNamespaces(AddNodeContext *ctx);
+
+// Logs and returns false if a backend step failed
+bool
+checkFailedSteps(const AddNodeContext *ctx);
+
+// A logger for the logger of the server config
+NodesetLoader_Logger *
+newLogger(UA_Server *server);
+
+// Register the parent ReferenceTypes of the server and start the trace
+void
+prepareImport(NodesetLoader *loader, UA_Server *server,
+              const NodesetLoader_Options *options);
+
+// Parse and sort the file and mark the implied references. Only touches the
+// server for the namespaces, not at all with ctx->deferNamespaces.
+bool
+parseAndSort(NodesetLoader *loader, AddNodeContext *ctx, const char *path,
+             const NodesetLoader_Options *options);
+
+// The steps to insert a sorted node: add it with its parent and type
+// definition, add the other references, finish it
+bool
+addNodeImpl(AddNodeContext *context, NL_Node *node);
+
+bool
+addAllRefs(AddNodeContext *context, NL_Node *node);
+
+bool
+addNodeFinish(AddNodeContext *context, NL_Node *node);
+
+// Log and return the stats, write the trace
+void
+finishImport(NodesetLoader *loader, NodesetLoader_Logger *logger,
+             const NodesetLoader_Options *options);
+
+// The parent is resolved by NodesetLoader_sort
 UA_NodeId
-getParentId(const AddNodeContext *ctx, const NL_Node *node, UA_NodeId *parentRefId);
+getParentId(const NL_Node *node, UA_NodeId *parentRefId);
+
+// The attributes of the instance nodes, shared by the insertion through the
+// server and the lazy nodestore. The strings are shallow copies of the node.
+void
+getObjectAttributes(const NL_ObjectNode *node, UA_ObjectAttributes *attr);
+
+void
+getViewAttributes(const NL_ViewNode *node, UA_ViewAttributes *attr);
+
+void
+getMethodAttributes(const NL_MethodNode *node, UA_MethodAttributes *attr);
+
+// The value is decoded or taken from context->decodedValues (then returned in
+// decoded). Release the value and the array dimensions with
+// clearVariableAttributes.
+void
+getVariableAttributes(AddNodeContext *context, const NL_VariableNode *node,
+                      UA_VariableAttributes *attr, DecodedValue **decoded);
+
+void
+clearVariableAttributes(UA_VariableAttributes *attr, DecodedValue *decoded);
 
+// Add the UA_DataTypes of all sorted DataType nodes to the server in one
+// UA_DataTypeArray, see prependCustomDataTypes
 void
-addCustomDataType(AddNodeContext *ctx, const NL_DataTypeNode *node);
+addCustomDataTypes(AddNodeContext *ctx, NodesetLoader *loader);
+
+// Build the UA_DataTypes of all sorted DataType nodes without adding them to
+// the server. Returns the number of types in the allocated array.
+size_t
+buildCustomDataTypes(AddNodeContext *ctx, NodesetLoader *loader,
+                     UA_DataType **types);
+
+// Copy the custom types of the server, e.g. to keep them after the server is
+// deleted. The members of the copies and of types that use a type of the
+// server are pointed to its copy. Returns false if the memory is missing.
+bool
+copyServerDataTypes(UA_Server *server, UA_DataType *types, size_t typesSize,
+                    UA_DataType **copies, size_t *copiesSize);
+
+// Make the types the first custom types of the server. With cleanup the
+// server frees the types and the array on shutdown, else they have to outlive
+// the server. open62541 has no locked entry point for the custom types, the
+// config is written directly. So every import adds its types here, and only
+// while no service runs: before the server runs or in the thread that runs
+// it (between UA_Server_run_iterate calls or in a server callback).
+void
+prependCustomDataTypes(UA_Server *server, UA_DataTypeArray *array,
+                       UA_DataType *types, size_t typesSize, bool cleanup);
+
+// Compute the member padding, memSize, pointerFree and overlayable flags of a
+// structured type from its members
+UA_StatusCode
+setDataTypeLayout(UA_DataType *type);
+
+// Decode the values of all sorted Variables with a pool of threads (0: one
+// per CPU). customTypes must contain all custom DataTypes of the values.
+bool
+DecodedValues_decode(DecodedValues *dv, NodesetLoader *loader,
+                     AddNodeContext *ctx,
+                     const UA_DataTypeArray *customTypes, size_t threads);
+
+// Returns NULL if the value was not decoded ahead
+DecodedValue *
+DecodedValues_get(const DecodedValues *dv, const NL_Node *node);
+
+// The decoded value is shared until the last node using it released it
+void
+DecodedValues_release(DecodedValue *v);
+
+// The values are not released by the nodes and stay until
+// DecodedValues_clear, to insert them into several servers
+void
+DecodedValues_keep(DecodedValues *dv);
+
+void
+DecodedValues_clear(DecodedValues *dv);
+
+typedef struct {
+    size_t references; // all references of the sorted nodes
+    size_t implied;    // references that need no UA_Server_addReference
+} ReferenceFilterStats;
+
+// Sets NL_Reference.isImplied for references that are created by addNode
+// (parent, type definition), that are the inverse copy of another reference
+// and for duplicates.
+ReferenceFilterStats
+markImpliedReferences(NodesetLoader *loader);
+
+// With ctx->rawExtensions: the raw extensions of the nodes that are in the
+// server with their extension as node context are left to the application.
+// The other ones (add failed, import canceled or failed before the node) are
+// freed now.
+void
+RawExtensions_handOver(UA_Server *server, NodesetLoader *loader);
+
+// Free the raw extensions of all nodes, for the loaders that keep them as the
+// node contexts of several servers (model, lazy nodestore)
+void
+RawExtensions_delete(NodesetLoader *loader);
+
+// Returns NULL if the server does not use the lazy nodestore
+LazyNodestore *
+LazyNodestore_get(UA_Server *server);
+
+// Objects, Variables, Methods and Views are materialized on demand, the other
+// node classes are added through the server
+bool
+LazyNodestore_isLazyNodeClass(NL_NodeClass nodeClass);
+
+// Index the sorted instance nodes of the loader. The store takes the loader
+// and the namespace mapping and logger of the context. On failure the index
+// is rolled back and the caller keeps them.
+bool
+LazyNodestore_addModel(LazyNodestore *ls, NodesetLoader *loader,
+                       const AddNodeContext *ctx);
+
+// The node is indexed and not yet in the inner nodestore
+bool
+LazyNodestore_isPending(LazyNodestore *ls, const UA_NodeId *id);
+
+// Add the references between the pending nodes of the loader and the nodes in
+// the inner nodestore. Call after the other nodes of the loader were added.
+void
+LazyNodestore_attach(LazyNodestore *ls, NodesetLoader *loader);
+
+// The value of the Variable is not decoded during the import but attached with
+// LazyValue_attach
+bool
+LazyValue_isLazy(const AddNodeContext *ctx, const NL_Node *node);
+
+// The number of array elements in the xml of the value without decoding it,
+// 0 for a scalar or an empty array
+size_t
+LazyValue_arrayLength(const NL_VariableNode *node);
+
+// Keep the xml of the value in the value store and decode it on the first read
+// by a data source. Call after UA_Server_addNode_finish, which reads the value.
+UA_StatusCode
+LazyValue_attach(AddNodeContext *ctx, const NL_VariableNode *node);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,173 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/* Counts the heap allocations per imported node and fails if they exceed a
+ * budget. malloc, calloc and realloc are interposed, which also covers the
+ * allocations of libxml2 and the UA_malloc, UA_calloc and UA_realloc hooks of
+ * open62541, they call the libc functions unless a build redirects them.
+ * free is not counted: the budget limits the allocation calls and every
+ * counted block is freed at most once, so the frees add no information.
+ * allocations <loaderBudget> <importBudget> <nodeset1> [<nodeset2> ...]
+ * The loader budget covers parsing and sorting, the import budget the whole
+ * import into a server. Both are allocations per node. The test prints the
+ * measured count and a budget of the count plus 20%. */
+
+#include <open62541/server.h>
+#include <open62541/server_config_default.h>
+#include <open62541/types.h>
+
+#include "check.h"
+
+#include <NodesetLoader/backendOpen62541.h>
+#include <NodesetLoader/NodesetLoader.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static size_t allocations = 0;
+
+#ifdef __GLIBC__
+#define COUNTS_ALLOCATIONS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *
+malloc(size_t size) {
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size) {
+    allocations++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size) {
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+static double loaderBudget = 0;
+static double importBudget = 0;
+static char **nodesets = NULL;
+static int nodesetsSize = 0;
+
+static void
+logNothing(void *context, enum NodesetLoader_LogLevel level,
+           const char *message, ...) {}
+
+static void
+addNamespace(void *userContext, size_t localNamespaceUrisSize,
+             UA_String *localNamespaceUris, UA_NamespaceMapping *nsMapping) {}
+
+// The measured count plus 20%, rounded up
+static double
+suggestedBudget(double perNode) {
+    return (double)(size_t)(perNode * 1.2 + 0.999);
+}
+
+static size_t
+countNodes(const NL_Stats *stats) {
+    size_t nodes = 0;
+    for(size_t i = 0; i < NL_NODECLASS_COUNT; i++)
+        nodes += stats->nodes[i];
+    return nodes;
+}
+
+// Parse and sort without a backend. The NodeIds keep the namespace indices
+// of the files.
+START_TEST(Loader_AllocationBudget) {
+    NodesetLoader_Logger logger = {NULL, logNothing};
+    NL_FileContext handler;
+    memset(&handler, 0, sizeof(NL_FileContext));
+    handler.addNamespace = addNamespace;
+
+    NodesetLoader *loader = NodesetLoader_new(&logger);
+    ck_assert(loader != NULL);
+    size_t before = allocations;
+    for(int i = 0; i < nodesetsSize; i++) {
+        handler.file = nodesets[i];
+        ck_assert(NodesetLoader_importFile(loader, &handler));
+    }
+    ck_assert(NodesetLoader_sort(loader));
+    size_t used = allocations - before;
+
+    NL_Stats stats;
+    NodesetLoader_getStats(loader, &stats);
+    NodesetLoader_delete(loader);
+    size_t nodes = countNodes(&stats);
+    ck_assert(nodes > 0);
+    double perNode = (double)used / (double)nodes;
+    printf("loader: %lu allocations for %lu nodes, %.2f per node (budget %.2f, "
+           "measured + 20%%: %.0f)\n",
+           (unsigned long)used, (unsigned long)nodes, perNode, loaderBudget,
+           suggestedBudget(perNode));
+    ck_assert(perNode <= loaderBudget);
+}
+END_TEST
+
+START_TEST(Import_AllocationBudget) {
+    UA_Server *server = UA_Server_new();
+    UA_ServerConfig_setDefault(UA_Server_getConfig(server));
+    NL_Stats stats;
+    NodesetLoader_Options options;
+    memset(&options, 0, sizeof(NodesetLoader_Options));
+    options.stats = &stats;
+    options.valueDecodeThreads = 1; // The counter is not atomic
+
+    size_t used = 0;
+    size_t nodes = 0;
+    for(int i = 0; i < nodesetsSize; i++) {
+        size_t before = allocations;
+        ck_assert(NodesetLoader_loadFileWithOptions(server, nodesets[i], &options));
+        used += allocations - before;
+        nodes += countNodes(&stats);
+    }
+    UA_Server_delete(server);
+    ck_assert(nodes > 0);
+    double perNode = (double)used / (double)nodes;
+    printf("import: %lu allocations for %lu nodes, %.2f per node (budget %.2f, "
+           "measured + 20%%: %.0f)\n",
+           (unsigned long)used, (unsigned long)nodes, perNode, importBudget,
+           suggestedBudget(perNode));
+    ck_assert(perNode <= importBudget);
+}
+END_TEST
+
+static Suite *
+testSuite_Allocations(void) {
+    Suite *s = suite_create("allocations");
+    TCase *tc = tcase_create("budget");
+    tcase_add_test(tc, Loader_AllocationBudget);
+    tcase_add_test(tc, Import_AllocationBudget);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main(int argc, char *argv[]) {
+    printf("%s", argv[0]);
+    if(argc < 4)
+        return 1;
+#ifndef COUNTS_ALLOCATIONS
+    printf("allocations cannot be counted on this platform, skipping\n");
+    return EXIT_SUCCESS;
+#endif
+    loaderBudget = atof(argv[1]);
+    importBudget = atof(argv[2]);
+    nodesets = &argv[3];
+    nodesetsSize = argc - 3;
+    Suite *s = testSuite_Allocations();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
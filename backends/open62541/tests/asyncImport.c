@@ -0,0 +1,140 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <open62541/server.h>
+#include <open62541/server_config_default.h>
+#include <open62541/types.h>
+
+#include "check.h"
+
+#include "testHelper.h"
+#include <NodesetLoader/backendOpen62541.h>
+
+UA_Server *server;
+char *nodesetPath = NULL;
+
+typedef struct {
+    bool done;
+    bool success;
+    size_t progressCalls;
+    size_t nodesAdded;
+    size_t nodesTotal;
+} ImportResult;
+
+static void setup(void) {
+    printf("path to testnodesets %s\n", nodesetPath);
+    server = UA_Server_new();
+    UA_ServerConfig *config = UA_Server_getConfig(server);
+    UA_ServerConfig_setDefault(config);
+    UA_Server_run_startup(server);
+}
+
+static void teardown(void) {
+    UA_Server_run_shutdown(server);
+    UA_Server_delete(server);
+}
+
+static void
+onProgress(UA_Server *s, void *context, size_t nodesAdded, size_t nodesTotal) {
+    ImportResult *r = (ImportResult *)context;
+    ck_assert(nodesAdded >= r->nodesAdded);
+    ck_assert(nodesAdded <= nodesTotal);
+    r->progressCalls++;
+    r->nodesAdded = nodesAdded;
+    r->nodesTotal = nodesTotal;
+}
+
+static void
+onDone(UA_Server *s, void *context, bool success) {
+    ImportResult *r = (ImportResult *)context;
+    r->done = true;
+    r->success = success;
+}
+
+struct Point {
+    UA_Int32 x;
+    UA_Int32 y;
+};
+
+// The server iterates while the nodes are added
+START_TEST(asyncImport_load) {
+    ImportResult result;
+    memset(&result, 0, sizeof(ImportResult));
+    NodesetLoader_AsyncOptions asyncOptions;
+    memset(&asyncOptions, 0, sizeof(NodesetLoader_AsyncOptions));
+    asyncOptions.budgetMs = 0.01; // Small batches
+    asyncOptions.intervalMs = 1;
+    asyncOptions.progress = onProgress;
+    asyncOptions.done = onDone;
+    asyncOptions.context = &result;
+    ck_assert(NodesetLoader_loadFileAsync(server, nodesetPath, NULL,
+                                          &asyncOptions) != NULL);
+    UA_DateTime timeout = UA_DateTime_nowMonotonic() + 30 * UA_DATETIME_SEC;
+    while(!result.done && UA_DateTime_nowMonotonic() < timeout)
+        UA_Server_run_iterate(server, true);
+    ck_assert(result.done);
+    ck_assert(result.success);
+    ck_assert_uint_gt(result.progressCalls, 0);
+    ck_assert_uint_gt(result.nodesTotal, 0);
+    ck_assert_uint_eq(result.nodesAdded, result.nodesTotal);
+
+    UA_Variant var;
+    UA_Variant_init(&var);
+    ck_assert_uint_eq(UA_Server_readValue(server, UA_NODEID_NUMERIC(2, 6019), &var),
+                      UA_STATUSCODE_GOOD);
+    struct Point *p = (struct Point *)var.data;
+    ck_assert(p->x == 20);
+    ck_assert(p->y == 30);
+    UA_Variant_clear(&var);
+}
+END_TEST
+
+// Aborted before the server runs the first batch
+START_TEST(asyncImport_abort) {
+    ImportResult result;
+    memset(&result, 0, sizeof(ImportResult));
+    NodesetLoader_AsyncOptions asyncOptions;
+    memset(&asyncOptions, 0, sizeof(NodesetLoader_AsyncOptions));
+    asyncOptions.done = onDone;
+    asyncOptions.context = &result;
+    NodesetLoader_AsyncImport *import =
+        NodesetLoader_loadFileAsync(server, nodesetPath, NULL, &asyncOptions);
+    ck_assert(import != NULL);
+    NodesetLoader_abortAsync(import);
+    ck_assert(result.done);
+    ck_assert(!result.success);
+    // Nothing runs after the abort
+    result.done = false;
+    UA_Server_run_iterate(server, false);
+    ck_assert(!result.done);
+    NodesetLoader_abortAsync(NULL);
+    ck_assert(!result.done);
+}
+END_TEST
+
+static Suite *testSuite_Client(void)
+{
+    Suite *s = suite_create("asyncImport");
+    TCase *tc_server = tcase_create("asyncImport");
+    tcase_add_unchecked_fixture(tc_server, setup, teardown);
+    tcase_add_test(tc_server, asyncImport_load);
+    tcase_add_test(tc_server, asyncImport_abort);
+    suite_add_tcase(s, tc_server);
+    return s;
+}
+
+int main(int argc, char *argv[])
+{
+    printf("%s", argv[0]);
+    if (!(argc > 1))
+        return 1;
+    nodesetPath = argv[1];
+    Suite *s = testSuite_Client();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
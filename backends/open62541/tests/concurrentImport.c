@@ -0,0 +1,93 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <open62541/server.h>
+#include <open62541/server_config_default.h>
+#include <open62541/types.h>
+
+#include <pthread.h>
+
+#include "check.h"
+
+#include <NodesetLoader/backendOpen62541.h>
+
+#define THREADS 16
+#define ROUNDS 4
+
+char **nodesetPaths = NULL;
+size_t nodesetPathsSize = 0;
+
+typedef struct {
+    size_t failed;
+} ImportThread;
+
+// Every thread imports all nodesets into its own servers
+static void *
+importAll(void *data)
+{
+    ImportThread *t = (ImportThread *)data;
+    for(size_t round = 0; round < ROUNDS; round++) {
+        for(size_t i = 0; i < nodesetPathsSize; i++) {
+            UA_Server *server = UA_Server_new();
+            UA_ServerConfig_setDefault(UA_Server_getConfig(server));
+            if(!NodesetLoader_loadFile(server, nodesetPaths[i], NULL))
+                t->failed++;
+            UA_Server_delete(server);
+        }
+    }
+    return NULL;
+}
+
+START_TEST(concurrentImport)
+{
+    pthread_t threads[THREADS];
+    ImportThread results[THREADS];
+    memset(results, 0, sizeof(results));
+    for(size_t i = 0; i < THREADS; i++)
+        ck_assert_int_eq(
+            pthread_create(&threads[i], NULL, importAll, &results[i]), 0);
+    for(size_t i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        ck_assert_uint_eq(results[i].failed, 0);
+    }
+}
+END_TEST
+
+// The libxml2 state is not cleaned up when the threads end
+START_TEST(importAfterThreads)
+{
+    UA_Server *server = UA_Server_new();
+    UA_ServerConfig_setDefault(UA_Server_getConfig(server));
+    for(size_t i = 0; i < nodesetPathsSize; i++)
+        ck_assert(NodesetLoader_loadFile(server, nodesetPaths[i], NULL));
+    UA_Server_delete(server);
+}
+END_TEST
+
+static Suite *testSuite_Client(void)
+{
+    Suite *s = suite_create("concurrentImport");
+    TCase *tc_server = tcase_create("concurrentImport");
+    tcase_set_timeout(tc_server, 120);
+    tcase_add_test(tc_server, concurrentImport);
+    tcase_add_test(tc_server, importAfterThreads);
+    suite_add_tcase(s, tc_server);
+    return s;
+}
+
+int main(int argc, char *argv[])
+{
+    printf("%s", argv[0]);
+    if (!(argc > 1))
+        return 1;
+    nodesetPaths = &argv[1];
+    nodesetPathsSize = (size_t)(argc - 1);
+    Suite *s = testSuite_Client();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
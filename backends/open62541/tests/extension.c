@@ -81,12 +81,62 @@ START_TEST(extensions)
 }
 END_TEST
 
+static void
+deleteRawExtension(UA_Server *s, const UA_NodeId *sessionId,
+                   void *sessionContext, const UA_NodeId *nodeId,
+                   void *nodeContext) {
+    NodesetLoader_deleteRawExtension(nodeContext);
+}
+
+START_TEST(rawExtensions)
+{
+    UA_Server *rawServer = UA_Server_new();
+    UA_ServerConfig *config = UA_Server_getConfig(rawServer);
+    UA_ServerConfig_setDefault(config);
+    // The application frees the strings of the added nodes
+    config->nodeLifecycle.destructor = deleteRawExtension;
+    NodesetLoader_Options options;
+    memset(&options, 0, sizeof(NodesetLoader_Options));
+    options.captureRawExtensions = true;
+    ck_assert(NodesetLoader_loadFileWithOptions(rawServer, nodesetPath, &options));
+
+    UA_String *raw = NULL;
+    ck_assert(UA_STATUSCODE_GOOD ==
+              UA_Server_getNodeContext(rawServer, UA_NODEID_NUMERIC(2, 6002),
+                                       (void **)&raw));
+    ck_assert(raw != NULL);
+    ck_assert(raw->length > 0);
+    ck_assert(!strncmp((const char *)raw->data, "<Extensions>", 12));
+
+    NodesetLoader_ExtensionInterface extIf;
+    memset(&extIf, 0, sizeof(NodesetLoader_ExtensionInterface));
+    extIf.newExtension = (NodesetLoader_newExtensionCb)Extension_new;
+    extIf.start = (NodesetLoader_startExtensionCb)startExtension;
+    extIf.end = (NodesetLoader_endExtensionCb)endExtension;
+    extIf.finish = (NodesetLoader_finishExtensionCb)finishExtension;
+    struct MyExtension *parsed =
+        (struct MyExtension *)NodesetLoader_parseExtensions(raw, &extIf);
+    ck_assert(parsed != NULL);
+    ck_assert(!strcmp(parsed->address, "demo.test"));
+    free(parsed->address);
+    free(parsed);
+
+    // The nodes exist, every add fails and the strings are freed
+    ck_assert(!NodesetLoader_loadFileWithOptions(rawServer, nodesetPath, &options));
+    // The destructor frees the string of the deleted node
+    ck_assert(UA_STATUSCODE_GOOD ==
+              UA_Server_deleteNode(rawServer, UA_NODEID_NUMERIC(2, 6002), true));
+    UA_Server_delete(rawServer);
+}
+END_TEST
+
 static Suite *testSuite_Client(void)
 {
     Suite *s = suite_create("extensions");
     TCase *tc_server = tcase_create("extensions");
     tcase_add_unchecked_fixture(tc_server, setup, teardown);
     tcase_add_test(tc_server, extensions);
+    tcase_add_test(tc_server, rawExtensions);
     suite_add_tcase(s, tc_server);
     return s;
 }
@@ -32,6 +32,75 @@ START_TEST(Server_ImportNodeset) {
 }
 END_TEST
 
+START_TEST(Server_ImportNodesetFused) {
+    UA_Server *fusedServer = UA_Server_new();
+    UA_ServerConfig_setDefault(UA_Server_getConfig(fusedServer));
+    NodesetLoader_Options options;
+    memset(&options, 0, sizeof(NodesetLoader_Options));
+    options.insertionMode = NODESETLOADER_INSERTION_FUSED;
+    ck_assert(NodesetLoader_loadFileWithOptions(fusedServer, nodesetPath,
+                                                &options));
+    UA_Server_delete(fusedServer);
+}
+END_TEST
+
+START_TEST(Server_ImportNodesetStats) {
+    UA_Server *statsServer = UA_Server_new();
+    UA_ServerConfig_setDefault(UA_Server_getConfig(statsServer));
+    NL_Stats stats;
+    NodesetLoader_Options options;
+    memset(&options, 0, sizeof(NodesetLoader_Options));
+    options.logStats = true;
+    options.stats = &stats;
+    ck_assert(NodesetLoader_loadFileWithOptions(statsServer, nodesetPath,
+                                                &options));
+    size_t nodes = 0;
+    for(size_t i = 0; i < NL_NODECLASS_COUNT; i++)
+        nodes += stats.nodes[i];
+    ck_assert(nodes > 0);
+    ck_assert(stats.references > 0);
+    ck_assert(stats.charArenaBytes > 0);
+    for(size_t i = 0; i < NL_PHASE_COUNT; i++) {
+        ck_assert(stats.phases[i].wallTime >= 0);
+        ck_assert(stats.phases[i].cpuTime >= 0);
+    }
+    // The file buffer is released after parsing, the nodes are kept
+    ck_assert(stats.memory[NL_MEMORY_FILEBUFFER].live == 0);
+    ck_assert(stats.memory[NL_MEMORY_FILEBUFFER].peak > 0);
+    ck_assert(stats.memory[NL_MEMORY_NODES].live > 0);
+    ck_assert(stats.memory[NL_MEMORY_REFERENCES].live > 0);
+    ck_assert(stats.memory[NL_MEMORY_ARENA].live >= stats.charArenaBytes);
+    size_t nodeBytes = 0;
+    for(size_t i = 0; i < NL_NODECLASS_COUNT; i++)
+        nodeBytes += stats.nodeBytes[i];
+    ck_assert(nodeBytes == stats.memory[NL_MEMORY_NODES].live);
+    ck_assert(stats.bytesPerNode > 0);
+    ck_assert(stats.bytesPerReference > 0);
+    UA_Server_delete(statsServer);
+}
+END_TEST
+
+START_TEST(Server_ImportNodesetTrace) {
+    UA_Server *traceServer = UA_Server_new();
+    UA_ServerConfig_setDefault(UA_Server_getConfig(traceServer));
+    NodesetLoader_Options options;
+    memset(&options, 0, sizeof(NodesetLoader_Options));
+    options.tracePath = "importTrace.json";
+    options.traceSlowNodeThreshold = 1; // Every node
+    ck_assert(NodesetLoader_loadFileWithOptions(traceServer, nodesetPath,
+                                                &options));
+    UA_Server_delete(traceServer);
+
+    FILE *f = fopen("importTrace.json", "r");
+    ck_assert(f != NULL);
+    char head[16];
+    memset(head, 0, sizeof(head));
+    ck_assert(fread(head, 1, 15, f) == 15);
+    ck_assert(!strncmp(head, "{\"traceEvents\"", 14));
+    fclose(f);
+    remove("importTrace.json");
+}
+END_TEST
 
 START_TEST(Server_ImportNoFile) {
     ck_assert(
@@ -50,6 +119,9 @@ static Suite *testSuite_Client(void) {
     TCase *tc_server = tcase_create("server nodeset import");
     tcase_add_unchecked_fixture(tc_server, setup, teardown);
     tcase_add_test(tc_server, Server_ImportNodeset);
+    tcase_add_test(tc_server, Server_ImportNodesetFused);
+    tcase_add_test(tc_server, Server_ImportNodesetStats);
+    tcase_add_test(tc_server, Server_ImportNodesetTrace);
     tcase_add_test(tc_server, Server_ImportNoFile);
     tcase_add_test(tc_server, Server_EmptyHandler);
     suite_add_tcase(s, tc_server);
@@ -0,0 +1,159 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <open62541/server.h>
+#include <open62541/server_config_default.h>
+#include <open62541/types.h>
+
+#include "check.h"
+
+#include "testHelper.h"
+#include <NodesetLoader/backendOpen62541.h>
+
+UA_Server *server;
+char *nodesetPath = NULL;
+// The nodestore plugin interface of the open62541 version is supported
+static bool lazy = false;
+
+static UA_Server *
+newLazyServer(void) {
+    UA_ServerConfig config;
+    memset(&config, 0, sizeof(UA_ServerConfig));
+    UA_ServerConfig_setDefault(&config);
+    lazy = NodesetLoader_useLazyNodestore(&config);
+    return UA_Server_newWithConfig(&config);
+}
+
+static void setup(void)
+{
+    printf("path to testnodesets %s\n", nodesetPath);
+    server = newLazyServer();
+}
+
+static void teardown(void)
+{
+    UA_Server_run_shutdown(server);
+    UA_Server_delete(server);
+}
+
+START_TEST(lazy_load)
+{
+    ck_assert(NodesetLoader_loadFileLazy(server, nodesetPath, NULL));
+    NodesetLoader_LazyStats stats;
+    ck_assert(NodesetLoader_getLazyStats(server, &stats) == lazy);
+    if(lazy) {
+        ck_assert_uint_gt(stats.nodes, 0);
+        ck_assert_uint_eq(stats.materialized, 0);
+    }
+    // The ReferenceType is added with the import
+    ck_assert(getNodeClass(server, UA_NODEID_NUMERIC(2, 8002)) ==
+              UA_NODECLASS_REFERENCETYPE);
+}
+END_TEST
+
+START_TEST(lazy_materializeOnRead)
+{
+    ck_assert(getNodeClass(server, UA_NODEID_NUMERIC(2, 6012)) ==
+              UA_NODECLASS_VARIABLE);
+    if(lazy) {
+        NodesetLoader_LazyStats stats;
+        ck_assert(NodesetLoader_getLazyStats(server, &stats));
+        ck_assert_uint_eq(stats.materialized, 1);
+    }
+    UA_NodeId baseDataVariableTypeId =
+        UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE);
+    UA_NodeId typeId = getTypeDefinitionId(server, UA_NODEID_NUMERIC(2, 6012));
+    ck_assert(UA_NodeId_equal(&baseDataVariableTypeId, &typeId));
+}
+END_TEST
+
+// The reference is only given in the source node, the target receives the
+// inverse reference when it is materialized
+START_TEST(lazy_references)
+{
+    ck_assert(hasReference(
+        server, UA_NODEID_NUMERIC(2, 7003), UA_NODEID_NUMERIC(2, 7002),
+        UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES), UA_BROWSEDIRECTION_INVERSE));
+    ck_assert(hasReference(
+        server, UA_NODEID_NUMERIC(2, 7002), UA_NODEID_NUMERIC(2, 7003),
+        UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES), UA_BROWSEDIRECTION_FORWARD));
+    ck_assert(hasReference(
+        server, UA_NODEID_NUMERIC(2, 7006), UA_NODEID_NUMERIC(2, 7005),
+        UA_NODEID_NUMERIC(0, UA_NS0ID_HASPROPERTY), UA_BROWSEDIRECTION_FORWARD));
+}
+END_TEST
+
+// The nodes are reachable from the existing nodes of the server
+START_TEST(lazy_browseFromObjectsFolder)
+{
+    ck_assert(hasReference(server, UA_NODEID_NUMERIC(0, 85),
+                           UA_NODEID_NUMERIC(2, 8003),
+                           UA_NODEID_NUMERIC(0, UA_NS0ID_HASPROPERTY),
+                           UA_BROWSEDIRECTION_FORWARD));
+    ck_assert(getNodeClass(server, UA_NODEID_NUMERIC(2, 8003)) ==
+              UA_NODECLASS_VARIABLE);
+}
+END_TEST
+
+// A failed import keeps nothing of the file, the next import works
+START_TEST(lazy_brokenFile)
+{
+    // The first half of the nodeset, the xml ends in the middle
+    const char *brokenPath = "lazyBroken.xml";
+    FILE *in = fopen(nodesetPath, "rb");
+    ck_assert(in != NULL);
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    char *buf = (char *)malloc((size_t)size);
+    ck_assert(buf != NULL);
+    ck_assert_uint_eq(fread(buf, 1, (size_t)size, in), (size_t)size);
+    fclose(in);
+    FILE *out = fopen(brokenPath, "wb");
+    ck_assert(out != NULL);
+    fwrite(buf, 1, (size_t)size / 2, out);
+    fclose(out);
+    free(buf);
+
+    UA_Server *brokenServer = newLazyServer();
+    ck_assert(!NodesetLoader_loadFileLazy(brokenServer, brokenPath, NULL));
+    NodesetLoader_LazyStats stats;
+    if(NodesetLoader_getLazyStats(brokenServer, &stats))
+        ck_assert_uint_eq(stats.nodes, 0);
+    ck_assert(NodesetLoader_loadFileLazy(brokenServer, nodesetPath, NULL));
+    ck_assert(getNodeClass(brokenServer, UA_NODEID_NUMERIC(2, 6012)) ==
+              UA_NODECLASS_VARIABLE);
+    UA_Server_delete(brokenServer);
+    remove(brokenPath);
+}
+END_TEST
+
+static Suite *testSuite_Client(void)
+{
+    Suite *s = suite_create("lazyNodestore");
+    TCase *tc_server = tcase_create("lazyNodestore");
+    tcase_add_unchecked_fixture(tc_server, setup, teardown);
+    tcase_add_test(tc_server, lazy_load);
+    tcase_add_test(tc_server, lazy_materializeOnRead);
+    tcase_add_test(tc_server, lazy_references);
+    tcase_add_test(tc_server, lazy_browseFromObjectsFolder);
+    tcase_add_test(tc_server, lazy_brokenFile);
+    suite_add_tcase(s, tc_server);
+    return s;
+}
+
+int main(int argc, char *argv[])
+{
+    printf("%s", argv[0]);
+    if (!(argc > 1))
+        return 1;
+    nodesetPath = argv[1];
+    Suite *s = testSuite_Client();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,126 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "check.h"
+#include <NodesetLoader/backendOpen62541.h>
+#include <open62541/server.h>
+#include <open62541/server_config_default.h>
+#include <open62541/types.h>
+
+#include "testHelper.h"
+
+UA_Server *server;
+NodesetLoader_ValueStore *valueStore;
+char *nodesetPath = NULL;
+
+static void setup(void)
+{
+    printf("path to testnodesets %s\n", nodesetPath);
+    server = UA_Server_new();
+    UA_ServerConfig *config = UA_Server_getConfig(server);
+    UA_ServerConfig_setDefault(config);
+    valueStore = NodesetLoader_ValueStore_new();
+}
+
+static void teardown(void)
+{
+    UA_Server_run_shutdown(server);
+    UA_Server_delete(server);
+    // The data sources of the server use the store
+    NodesetLoader_ValueStore_delete(valueStore);
+}
+
+START_TEST(lazyValues_load)
+{
+    NodesetLoader_Options options;
+    memset(&options, 0, sizeof(NodesetLoader_Options));
+    options.lazyValueThreshold = 1;
+    options.valueStore = valueStore;
+    ck_assert(NodesetLoader_loadFileWithOptions(server, nodesetPath, &options));
+
+    // Without declared ArrayDimensions they are taken from the value
+    // as with the eager import
+    UA_Variant dimensions;
+    ck_assert_uint_eq(
+        UA_Server_readArrayDimensions(server, UA_NODEID_NUMERIC(2, 1021), &dimensions),
+        UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(dimensions.arrayLength, 1);
+    ck_assert_uint_eq(((UA_UInt32 *)dimensions.data)[0], 3);
+    UA_Variant_clear(&dimensions);
+}
+END_TEST
+
+START_TEST(lazyValues_read)
+{
+    UA_Variant value;
+    UA_Variant_init(&value);
+    ck_assert_uint_eq(
+        UA_Server_readValue(server, UA_NODEID_NUMERIC(2, 1003), &value),
+        UA_STATUSCODE_GOOD);
+    ck_assert(value.type == &UA_TYPES[UA_TYPES_DOUBLE]);
+    ck_assert(*(UA_Double *)value.data == 3.1415);
+    UA_Variant_clear(&value);
+
+    ck_assert_uint_eq(
+        UA_Server_readValue(server, UA_NODEID_NUMERIC(2, 1004), &value),
+        UA_STATUSCODE_GOOD);
+    ck_assert(value.type == &UA_TYPES[UA_TYPES_UINT32]);
+    ck_assert_uint_eq(value.arrayLength, 3);
+    ck_assert_uint_eq(((UA_UInt32 *)value.data)[1], 130);
+    UA_Variant_clear(&value);
+
+    ck_assert_uint_eq(
+        UA_Server_readValue(server, UA_NODEID_NUMERIC(2, 1007), &value),
+        UA_STATUSCODE_GOOD);
+    ck_assert(value.type == &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+    UA_String text = UA_STRING("someText@42");
+    ck_assert(UA_String_equal(&((UA_LocalizedText *)value.data)->text, &text));
+    UA_Variant_clear(&value);
+}
+END_TEST
+
+// The written value replaces the cached value
+START_TEST(lazyValues_write)
+{
+    UA_Double d = 2.5;
+    UA_Variant value;
+    UA_Variant_setScalar(&value, &d, &UA_TYPES[UA_TYPES_DOUBLE]);
+    ck_assert_uint_eq(
+        UA_Server_writeValue(server, UA_NODEID_NUMERIC(2, 1003), value),
+        UA_STATUSCODE_GOOD);
+    UA_Variant_init(&value);
+    ck_assert_uint_eq(
+        UA_Server_readValue(server, UA_NODEID_NUMERIC(2, 1003), &value),
+        UA_STATUSCODE_GOOD);
+    ck_assert(*(UA_Double *)value.data == 2.5);
+    UA_Variant_clear(&value);
+}
+END_TEST
+
+static Suite *testSuite_Client(void)
+{
+    Suite *s = suite_create("lazyValues");
+    TCase *tc_server = tcase_create("lazyValues");
+    tcase_add_unchecked_fixture(tc_server, setup, teardown);
+    tcase_add_test(tc_server, lazyValues_load);
+    tcase_add_test(tc_server, lazyValues_read);
+    tcase_add_test(tc_server, lazyValues_write);
+    suite_add_tcase(s, tc_server);
+    return s;
+}
+
+int main(int argc, char *argv[])
+{
+    printf("%s", argv[0]);
+    if (!(argc > 1))
+        return 1;
+    nodesetPath = argv[1];
+    Suite *s = testSuite_Client();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -55,6 +55,15 @@ START_TEST(newHierachicalRef)
 }
 END_TEST
 
+// the parent reference type is defined in the same nodeset file
+START_TEST(parentWithNewHierachicalRef)
+{
+    ck_assert(hasReference(server, UA_NODEID_NUMERIC(2, 5002),
+                           UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                           UA_NODEID_NUMERIC(2, 4002), UA_BROWSEDIRECTION_INVERSE));
+}
+END_TEST
+
 // check if node is also added, if there's no hierachical reference on it
 START_TEST(noHierachicalRef)
 {
@@ -77,6 +86,7 @@ static Suite *testSuite_Client(void)
     tcase_add_unchecked_fixture(tc_server, setup, teardown);
     tcase_add_test(tc_server, loadNodeset);
     tcase_add_test(tc_server, newHierachicalRef);
+    tcase_add_test(tc_server, parentWithNewHierachicalRef);
     tcase_add_test(tc_server, noHierachicalRef);
     tcase_add_test(tc_server, otherNamespace);
     suite_add_tcase(s, tc_server);
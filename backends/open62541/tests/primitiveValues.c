@@ -30,6 +30,15 @@ static void teardown(void)
 START_TEST(loadPrimitiveValues)
 {
     ck_assert(NodesetLoader_loadFile(server, nodesetPath, NULL));
+
+    // Without declared ArrayDimensions they are taken from the value
+    UA_Variant dimensions;
+    ck_assert_uint_eq(
+        UA_Server_readArrayDimensions(server, UA_NODEID_NUMERIC(2, 1021), &dimensions),
+        UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(dimensions.arrayLength, 1);
+    ck_assert_uint_eq(((UA_UInt32 *)dimensions.data)[0], 3);
+    UA_Variant_clear(&dimensions);
 }
 END_TEST
 
@@ -0,0 +1,140 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "check.h"
+#include <NodesetLoader/backendOpen62541.h>
+#include <open62541/server.h>
+#include <open62541/server_config_default.h>
+#include <open62541/types.h>
+
+#include "testHelper.h"
+
+char *nodesetPath = NULL;
+
+typedef enum {
+    CANCEL_NEVER,
+    CANCEL_PARSING,  // At the first report
+    CANCEL_INSERTING // At the first report with inserted nodes
+} CancelAt;
+
+typedef struct {
+    CancelAt cancelAt;
+    size_t calls;
+    NL_Progress last;
+} ProgressContext;
+
+static bool
+onProgress(void *context, const NL_Progress *progress) {
+    ProgressContext *pc = (ProgressContext *)context;
+    // The counters never decrease
+    ck_assert_uint_ge(progress->bytesParsed, pc->last.bytesParsed);
+    ck_assert_uint_ge(progress->nodesCreated, pc->last.nodesCreated);
+    ck_assert_uint_ge(progress->nodesSorted, pc->last.nodesSorted);
+    ck_assert_uint_ge(progress->nodesInserted, pc->last.nodesInserted);
+    ck_assert_uint_le(progress->bytesParsed, progress->bytesTotal);
+    pc->calls++;
+    pc->last = *progress;
+    if(pc->cancelAt == CANCEL_PARSING)
+        return false;
+    if(pc->cancelAt == CANCEL_INSERTING && progress->nodesInserted > 0)
+        return false;
+    return true;
+}
+
+static UA_Server *
+newServer(void) {
+    UA_Server *server = UA_Server_new();
+    UA_ServerConfig_setDefault(UA_Server_getConfig(server));
+    return server;
+}
+
+static bool
+load(UA_Server *server, ProgressContext *pc) {
+    NodesetLoader_Options options;
+    memset(&options, 0, sizeof(NodesetLoader_Options));
+    options.progress = onProgress;
+    options.progressContext = pc;
+    return NodesetLoader_loadFileWithOptions(server, nodesetPath, &options);
+}
+
+static bool
+nodeExists(UA_Server *server, UA_UInt32 id) {
+    UA_NodeClass nodeClass;
+    return UA_Server_readNodeClass(server, UA_NODEID_NUMERIC(2, id),
+                                   &nodeClass) == UA_STATUSCODE_GOOD;
+}
+
+START_TEST(progress_complete)
+{
+    UA_Server *server = newServer();
+    ProgressContext pc;
+    memset(&pc, 0, sizeof(ProgressContext));
+    ck_assert(load(server, &pc));
+    ck_assert_uint_gt(pc.calls, 2);
+    ck_assert_uint_gt(pc.last.bytesTotal, 0);
+    ck_assert_uint_eq(pc.last.bytesParsed, pc.last.bytesTotal);
+    ck_assert_uint_gt(pc.last.nodesCreated, 0);
+    ck_assert_uint_eq(pc.last.nodesSorted, pc.last.nodesCreated);
+    ck_assert_uint_gt(pc.last.nodesInserted, 0);
+    ck_assert_uint_le(pc.last.nodesInserted, pc.last.nodesCreated);
+    ck_assert(nodeExists(server, 68));
+    UA_Server_delete(server);
+}
+END_TEST
+
+START_TEST(progress_cancelParsing)
+{
+    UA_Server *server = newServer();
+    ProgressContext pc;
+    memset(&pc, 0, sizeof(ProgressContext));
+    pc.cancelAt = CANCEL_PARSING;
+    ck_assert(!load(server, &pc));
+    ck_assert_uint_eq(pc.calls, 1);
+    ck_assert_uint_lt(pc.last.bytesParsed, pc.last.bytesTotal);
+    ck_assert_uint_eq(pc.last.nodesSorted, 0);
+    // The last node of the file
+    ck_assert(!nodeExists(server, 68));
+    UA_Server_delete(server);
+}
+END_TEST
+
+START_TEST(progress_cancelInserting)
+{
+    UA_Server *server = newServer();
+    ProgressContext pc;
+    memset(&pc, 0, sizeof(ProgressContext));
+    pc.cancelAt = CANCEL_INSERTING;
+    ck_assert(!load(server, &pc));
+    ck_assert_uint_eq(pc.last.nodesSorted, pc.last.nodesCreated);
+    ck_assert_uint_gt(pc.last.nodesInserted, 0);
+    ck_assert_uint_lt(pc.last.nodesInserted, pc.last.nodesCreated);
+    UA_Server_delete(server);
+}
+END_TEST
+
+static Suite *testSuite_Client(void)
+{
+    Suite *s = suite_create("progress");
+    TCase *tc_server = tcase_create("progress");
+    tcase_add_test(tc_server, progress_complete);
+    tcase_add_test(tc_server, progress_cancelParsing);
+    tcase_add_test(tc_server, progress_cancelInserting);
+    suite_add_tcase(s, tc_server);
+    return s;
+}
+
+int main(int argc, char *argv[])
+{
+    printf("%s", argv[0]);
+    if (!(argc > 1))
+        return 1;
+    nodesetPath = argv[1];
+    Suite *s = testSuite_Client();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,148 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <open62541/server.h>
+#include <open62541/server_config_default.h>
+#include <open62541/types.h>
+
+#include "check.h"
+
+#include "testHelper.h"
+#include <NodesetLoader/backendOpen62541.h>
+
+#define SERVERS 3
+
+UA_Server *servers[SERVERS];
+NodesetLoader_Model *model;
+char *nodesetPath = NULL;
+
+static void setup(void) {
+    printf("path to testnodesets %s\n", nodesetPath);
+    for(size_t i = 0; i < SERVERS; i++) {
+        servers[i] = UA_Server_new();
+        UA_ServerConfig *config = UA_Server_getConfig(servers[i]);
+        UA_ServerConfig_setDefault(config);
+    }
+    model = NULL;
+}
+
+static void teardown(void) {
+    for(size_t i = 0; i < SERVERS; i++)
+        UA_Server_delete(servers[i]);
+    // The servers use the DataTypes of the model
+    NodesetLoader_Model_delete(model);
+}
+
+struct Point {
+    UA_Int32 x;
+    UA_Int32 y;
+};
+
+START_TEST(sharedModel_apply) {
+    model = NodesetLoader_Model_new(servers[0], nodesetPath, NULL);
+    ck_assert(model != NULL);
+    for(size_t i = 0; i < SERVERS; i++)
+        ck_assert(NodesetLoader_Model_apply(model, servers[i]));
+}
+END_TEST
+
+// Every server has the nodes, the custom DataType and the decoded value
+START_TEST(sharedModel_readPoint) {
+    for(size_t i = 0; i < SERVERS; i++) {
+        UA_Variant var;
+        UA_Variant_init(&var);
+        UA_StatusCode retval =
+            UA_Server_readValue(servers[i], UA_NODEID_NUMERIC(2, 6019), &var);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        UA_NodeId pointId = UA_NODEID_NUMERIC(2, 3002);
+        ck_assert(UA_Server_findDataType(servers[i], &pointId) != NULL);
+        struct Point *p = (struct Point *)var.data;
+        ck_assert(p->x == 20);
+        ck_assert(p->y == 30);
+        UA_Variant_clear(&var);
+    }
+}
+END_TEST
+
+static UA_Server *
+newServer(void) {
+    UA_Server *server = UA_Server_new();
+    UA_ServerConfig_setDefault(UA_Server_getConfig(server));
+    return server;
+}
+
+// The model does not use the server it was created with after new
+START_TEST(sharedModel_creatingServerDeleted) {
+    UA_Server *creating = newServer();
+    NodesetLoader_Model *m = NodesetLoader_Model_new(creating, nodesetPath, NULL);
+    ck_assert(m != NULL);
+    UA_Server_delete(creating);
+    UA_Server *server = newServer();
+    ck_assert(NodesetLoader_Model_apply(m, server));
+    UA_Variant var;
+    UA_Variant_init(&var);
+    ck_assert_uint_eq(UA_Server_readValue(server, UA_NODEID_NUMERIC(2, 6019), &var),
+                      UA_STATUSCODE_GOOD);
+    struct Point *p = (struct Point *)var.data;
+    ck_assert(p->x == 20);
+    UA_Variant_clear(&var);
+    UA_Server_delete(server);
+    NodesetLoader_Model_delete(m);
+}
+END_TEST
+
+static size_t
+namespacesSize(UA_Server *server) {
+    size_t size = 0;
+    UA_String uri = UA_STRING_NULL;
+    while(UA_Server_getNamespaceByIndex(server, size, &uri) == UA_STATUSCODE_GOOD) {
+        UA_String_clear(&uri);
+        size++;
+    }
+    return size;
+}
+
+// A server with other namespaces is rejected and keeps its namespaces
+START_TEST(sharedModel_otherNamespaces) {
+    UA_Server *creating = newServer();
+    NodesetLoader_Model *m = NodesetLoader_Model_new(creating, nodesetPath, NULL);
+    ck_assert(m != NULL);
+    UA_Server *server = newServer();
+    UA_Server_addNamespace(server, "urn:other");
+    size_t before = namespacesSize(server);
+    ck_assert(!NodesetLoader_Model_apply(m, server));
+    ck_assert_uint_eq(namespacesSize(server), before);
+    UA_Server_delete(server);
+    UA_Server_delete(creating);
+    NodesetLoader_Model_delete(m);
+}
+END_TEST
+
+static Suite *testSuite_Client(void)
+{
+    Suite *s = suite_create("sharedModel");
+    TCase *tc_server = tcase_create("sharedModel");
+    tcase_add_unchecked_fixture(tc_server, setup, teardown);
+    tcase_add_test(tc_server, sharedModel_apply);
+    tcase_add_test(tc_server, sharedModel_readPoint);
+    tcase_add_test(tc_server, sharedModel_creatingServerDeleted);
+    tcase_add_test(tc_server, sharedModel_otherNamespaces);
+    suite_add_tcase(s, tc_server);
+    return s;
+}
+
+int main(int argc, char *argv[])
+{
+    printf("%s", argv[0]);
+    if (!(argc > 1))
+        return 1;
+    nodesetPath = argv[1];
+    Suite *s = testSuite_Client();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
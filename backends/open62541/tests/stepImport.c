@@ -0,0 +1,199 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <open62541/types.h>
+
+#include "check.h"
+
+#include <NodesetLoader/NodesetLoader.h>
+
+#define MAX_NODES 1024
+
+char *nodesetPath = NULL;
+
+typedef struct {
+    NL_Node *nodes[MAX_NODES];
+    size_t nodesSize;
+} NodeList;
+
+static void
+logNothing(void *context, enum NodesetLoader_LogLevel level,
+           const char *message, ...) {}
+
+static void
+addNamespace(void *userContext, size_t localNamespaceUrisSize,
+             UA_String *localNamespaceUris, UA_NamespaceMapping *nsMapping) {}
+
+static NodesetLoader_Logger logger = {NULL, logNothing};
+
+static bool
+collectNode(NodeList *list, NL_Node *node) {
+    ck_assert_uint_lt(list->nodesSize, MAX_NODES);
+    list->nodes[list->nodesSize++] = node;
+    return true;
+}
+
+static void
+initHandler(NL_FileContext *handler) {
+    memset(handler, 0, sizeof(NL_FileContext));
+    handler->addNamespace = addNamespace;
+    handler->file = nodesetPath;
+}
+
+// The nodes and the value spans are the same as with a single chunk
+static void
+assertSameNodes(NodesetLoader *a, NodesetLoader *b) {
+    static NodeList listA;
+    static NodeList listB;
+    listA.nodesSize = 0;
+    listB.nodesSize = 0;
+    ck_assert(NodesetLoader_forEachNode(
+        a, &listA, (NodesetLoader_forEachNode_Func)collectNode));
+    ck_assert(NodesetLoader_forEachNode(
+        b, &listB, (NodesetLoader_forEachNode_Func)collectNode));
+    ck_assert_uint_gt(listA.nodesSize, 0);
+    ck_assert_uint_eq(listA.nodesSize, listB.nodesSize);
+    for(size_t i = 0; i < listA.nodesSize; i++) {
+        const NL_Node *na = listA.nodes[i];
+        const NL_Node *nb = listB.nodes[i];
+        ck_assert(UA_NodeId_equal(&na->id, &nb->id));
+        ck_assert(UA_String_equal(&na->browseName.name, &nb->browseName.name));
+        if(na->nodeClass != NODECLASS_VARIABLE)
+            continue;
+        ck_assert(UA_String_equal(&((const NL_VariableNode *)na)->value,
+                                  &((const NL_VariableNode *)nb)->value));
+    }
+}
+
+static NodesetLoader *
+importSingleChunk(void) {
+    NL_FileContext handler;
+    initHandler(&handler);
+    NodesetLoader *loader = NodesetLoader_new(&logger);
+    ck_assert(NodesetLoader_importFile(loader, &handler));
+    ck_assert(NodesetLoader_sort(loader));
+    return loader;
+}
+
+// Small chunks split the elements and the values
+START_TEST(stepImport_bytes)
+{
+    NodesetLoader *expected = importSingleChunk();
+    NL_FileContext handler;
+    initHandler(&handler);
+    NodesetLoader *loader = NodesetLoader_new(&logger);
+    ck_assert(NodesetLoader_importBegin(loader, &handler));
+    size_t steps = 0;
+    NL_ImportStepResult res;
+    do {
+        res = NodesetLoader_importStep(loader, 7, 0);
+        steps++;
+    } while(res == NL_IMPORTSTEP_CONTINUE);
+    ck_assert_int_eq(res, NL_IMPORTSTEP_DONE);
+    ck_assert_uint_gt(steps, 1);
+    ck_assert(NodesetLoader_importEnd(loader));
+    ck_assert(NodesetLoader_sort(loader));
+    assertSameNodes(expected, loader);
+    NodesetLoader_delete(loader);
+    NodesetLoader_delete(expected);
+}
+END_TEST
+
+START_TEST(stepImport_nodes)
+{
+    NodesetLoader *expected = importSingleChunk();
+    NL_FileContext handler;
+    initHandler(&handler);
+    NodesetLoader *loader = NodesetLoader_new(&logger);
+    ck_assert(NodesetLoader_importBegin(loader, &handler));
+    NL_ImportStepResult res;
+    do {
+        res = NodesetLoader_importStep(loader, 0, 1);
+    } while(res == NL_IMPORTSTEP_CONTINUE);
+    ck_assert_int_eq(res, NL_IMPORTSTEP_DONE);
+    ck_assert(NodesetLoader_importEnd(loader));
+    ck_assert(NodesetLoader_sort(loader));
+    assertSameNodes(expected, loader);
+    NodesetLoader_delete(loader);
+    NodesetLoader_delete(expected);
+}
+END_TEST
+
+static bool
+countNode(size_t *count, NL_Node *node) {
+    (*count)++;
+    return true;
+}
+
+static size_t
+parsedNodes(NodesetLoader *loader) {
+    size_t count = 0;
+    ck_assert(NodesetLoader_forEachParsedNode(
+        loader, &count, (NodesetLoader_forEachNode_Func)countNode));
+    return count;
+}
+
+// An import that is ended early fails. Its nodes stay, the loader refuses to
+// import or sort and only a new loader can import the file.
+START_TEST(stepImport_abort)
+{
+    NodesetLoader *expected = importSingleChunk();
+    NL_FileContext handler;
+    initHandler(&handler);
+    NodesetLoader *loader = NodesetLoader_new(&logger);
+    ck_assert(NodesetLoader_importBegin(loader, &handler));
+    ck_assert(!NodesetLoader_importBegin(loader, &handler));
+    ck_assert_int_eq(NodesetLoader_importStep(loader, 64, 0),
+                     NL_IMPORTSTEP_CONTINUE);
+    ck_assert(!NodesetLoader_importEnd(loader));
+    ck_assert_int_eq(NodesetLoader_importStep(loader, 64, 0),
+                     NL_IMPORTSTEP_ERROR);
+    size_t aborted = parsedNodes(loader);
+    ck_assert(!NodesetLoader_importFile(loader, &handler));
+    ck_assert(!NodesetLoader_sort(loader));
+    ck_assert_uint_eq(parsedNodes(loader), aborted);
+    ck_assert_uint_lt(aborted, parsedNodes(expected));
+    NodesetLoader_delete(loader);
+
+    loader = NodesetLoader_new(&logger);
+    ck_assert(NodesetLoader_importFile(loader, &handler));
+    ck_assert(NodesetLoader_sort(loader));
+    ck_assert_uint_eq(parsedNodes(loader), parsedNodes(expected));
+    assertSameNodes(expected, loader);
+    NodesetLoader_delete(loader);
+    NodesetLoader_delete(expected);
+
+    // Deleted while the import runs
+    loader = NodesetLoader_new(&logger);
+    ck_assert(NodesetLoader_importBegin(loader, &handler));
+    NodesetLoader_importStep(loader, 64, 0);
+    NodesetLoader_delete(loader);
+}
+END_TEST
+
+static Suite *testSuite_Client(void)
+{
+    Suite *s = suite_create("stepImport");
+    TCase *tc = tcase_create("stepImport");
+    tcase_add_test(tc, stepImport_bytes);
+    tcase_add_test(tc, stepImport_nodes);
+    tcase_add_test(tc, stepImport_abort);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main(int argc, char *argv[])
+{
+    printf("%s", argv[0]);
+    if (!(argc > 1))
+        return 1;
+    nodesetPath = argv[1];
+    Suite *s = testSuite_Client();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,70 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/* Merges nodesets into one NodeSet2 file that loads faster, e.g. as a build
+ * step for production images. */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "NodesetLoader/backendNodesetWriter.h"
+
+static void
+NodesetLoader_Logger_printf(void *context,
+                          enum NodesetLoader_LogLevel level,
+                          const char *message, ...) {
+    va_list args;
+    va_start(args, message);
+    vfprintf(stderr, message, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+}
+
+static void
+usage(void) {
+    printf("nodesetRewrite [--strip-descriptions] [--strip-extensions] "
+           "<output.xml> <nodeset1> [<nodeset2> ...]\n");
+}
+
+int main(int argc, char *argv[]) {
+    NodesetLoader_NodesetWriterOptions options;
+    memset(&options, 0, sizeof(NodesetLoader_NodesetWriterOptions));
+    int first = 1;
+    for(; first < argc && !strncmp(argv[first], "--", 2); first++) {
+        if(!strcmp(argv[first], "--strip-descriptions")) {
+            options.stripDescriptions = true;
+        } else if(!strcmp(argv[first], "--strip-extensions")) {
+            options.stripExtensions = true;
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if(argc - first < 2) {
+        usage();
+        return 1;
+    }
+
+    FILE *out = fopen(argv[first], "wb");
+    if(!out) {
+        fprintf(stderr, "%s could not be opened\n", argv[first]);
+        return 1;
+    }
+    NodesetLoader_Logger logger;
+    logger.context = NULL;
+    logger.log = NodesetLoader_Logger_printf;
+    bool ok = NodesetLoader_writeNodesetFiles(
+        (size_t)(argc - first - 1), (const char *const *)&argv[first + 1],
+        &logger, out, &options);
+    fclose(out);
+    if(!ok) {
+        fprintf(stderr, "Nodesets could not be written\n");
+        return 1;
+    }
+    return 0;
+}
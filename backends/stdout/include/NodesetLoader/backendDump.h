@@ -0,0 +1,59 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef NODESETLOADER_BACKEND_DUMP_H
+#define NODESETLOADER_BACKEND_DUMP_H
+
+#include "NodesetLoader/NodesetLoader.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    // One JSON object per line
+    NODESETLOADER_DUMP_JSONL = 0,
+    // RFC 4180 with a header row
+    NODESETLOADER_DUMP_CSV
+} NodesetLoader_DumpFormat;
+
+/* The dump writes up to three streams, each may be NULL:
+ * - nodes: nodeId, nodeClass, browseName, displayName, description,
+ *   parentNodeId, parentReferenceType, typeDefinition, dataType, valueRank
+ * - references: source, referenceType, target, isForward
+ * - namespaces: index, uri (only written by NodesetLoader_dumpFiles)
+ * NodeIds are printed in the string encoding, BrowseNames as "ns:name". */
+typedef struct {
+    NodesetLoader_DumpFormat format;
+    // Threads formatting chunks of nodes. 0 starts one thread per CPU.
+    size_t threads;
+    // Bytes collected before a stream is written, 0 uses 4 MiB
+    size_t bufferSize;
+    FILE *nodes;
+    FILE *references;
+    FILE *namespaces;
+} NodesetLoader_DumpOptions;
+
+// Dumps the nodes of a sorted loader in the sorted order. The NodeIds keep
+// the namespace indices of the loader. Returns false if writing fails.
+LOADER_EXPORT bool
+NodesetLoader_dump(NodesetLoader *loader,
+                   const NodesetLoader_DumpOptions *options);
+
+// Imports the files into one loader and dumps it. The namespaces of all files
+// are merged into one table, index 0 is the OPC UA namespace.
+LOADER_EXPORT bool
+NodesetLoader_dumpFiles(size_t filesSize, const char *const *files,
+                        NodesetLoader_Logger *logger,
+                        const NodesetLoader_DumpOptions *options);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
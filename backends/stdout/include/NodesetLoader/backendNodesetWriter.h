@@ -0,0 +1,55 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef NODESETLOADER_BACKEND_NODESETWRITER_H
+#define NODESETLOADER_BACKEND_NODESETWRITER_H
+
+#include "NodesetLoader/NodesetLoader.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Writes a loaded nodeset back as one NodeSet2 file that loads faster:
+ * - the nodes are in the sorted order, so the sort of the loader finishes
+ *   in a single pass per node class
+ * - one namespace table and one alias table with the used aliases
+ * - of a reference that is given in both directions only the direction
+ *   is kept that the loader sorts by (the inverse one, for
+ *   HasTypeDefinition the forward one)
+ * - attributes with the default value of the loader are omitted
+ * Values and extensions are copied as they are. Namespace indices inside
+ * them are not rewritten. */
+typedef struct {
+    bool stripDescriptions;
+    bool stripExtensions;
+    // Bytes collected before the file is written, 0 uses 4 MiB
+    size_t bufferSize;
+} NodesetLoader_NodesetWriterOptions;
+
+// Writes the sorted nodes of the loader. namespaceUris is the namespace table
+// of the loader, starting with ns0. The extensions are written as raw xml,
+// so the files must be imported with captureRawExtensions unless
+// stripExtensions is set. Returns false if writing fails.
+LOADER_EXPORT bool
+NodesetLoader_writeNodeset(NodesetLoader *loader, const UA_String *namespaceUris,
+                           size_t namespaceUrisSize, FILE *out,
+                           const NodesetLoader_NodesetWriterOptions *options);
+
+// Imports the files into one loader with a merged namespace table and writes
+// them as one nodeset
+LOADER_EXPORT bool
+NodesetLoader_writeNodesetFiles(size_t filesSize, const char *const *files,
+                                NodesetLoader_Logger *logger, FILE *out,
+                                const NodesetLoader_NodesetWriterOptions *options);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,207 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "Output.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool
+Buffer_reserve(Buffer *b, size_t size) {
+    if(b->failed)
+        return false;
+    if(b->length + size <= b->capacity)
+        return true;
+    size_t capacity = (b->capacity > 0) ? b->capacity : 4096;
+    while(capacity < b->length + size)
+        capacity *= 2;
+    char *data = (char *)realloc(b->data, capacity);
+    if(!data) {
+        b->failed = true;
+        return false;
+    }
+    b->data = data;
+    b->capacity = capacity;
+    return true;
+}
+
+void
+Buffer_append(Buffer *b, const char *data, size_t size) {
+    if(size == 0 || !Buffer_reserve(b, size))
+        return;
+    memcpy(b->data + b->length, data, size);
+    b->length += size;
+}
+
+void
+Buffer_appendChar(Buffer *b, char c) {
+    if(!Buffer_reserve(b, 1))
+        return;
+    b->data[b->length++] = c;
+}
+
+void
+Buffer_appendUInt(Buffer *b, unsigned long value) {
+    char digits[24];
+    size_t pos = sizeof(digits);
+    do {
+        digits[--pos] = (char)('0' + value % 10);
+        value /= 10;
+    } while(value > 0);
+    Buffer_append(b, &digits[pos], sizeof(digits) - pos);
+}
+
+// Numeric and string identifiers are printed here, the rare Guid and
+// ByteString identifiers by open62541
+void
+Buffer_appendNodeId(Buffer *b, const UA_NodeId *id) {
+    switch(id->identifierType) {
+    case UA_NODEIDTYPE_NUMERIC:
+    case UA_NODEIDTYPE_STRING:
+        if(id->namespaceIndex != 0) {
+            Buffer_appendLiteral(b, "ns=");
+            Buffer_appendUInt(b, id->namespaceIndex);
+            Buffer_appendChar(b, ';');
+        }
+        if(id->identifierType == UA_NODEIDTYPE_NUMERIC) {
+            Buffer_appendLiteral(b, "i=");
+            Buffer_appendUInt(b, id->identifier.numeric);
+        } else {
+            Buffer_appendLiteral(b, "s=");
+            Buffer_append(b, (const char *)id->identifier.string.data,
+                          id->identifier.string.length);
+        }
+        break;
+    default: {
+        UA_String s = UA_STRING_NULL;
+        if(UA_NodeId_print(id, &s) == UA_STATUSCODE_GOOD)
+            Buffer_append(b, (const char *)s.data, s.length);
+        UA_String_clear(&s);
+        break;
+    }
+    }
+}
+
+void
+Buffer_clear(Buffer *b) {
+    free(b->data);
+    memset(b, 0, sizeof(Buffer));
+}
+
+void
+Writer_init(Writer *w, FILE *file, size_t bufferSize) {
+    memset(w, 0, sizeof(Writer));
+    w->file = file;
+    w->bufferSize = bufferSize;
+    if(file && !Buffer_reserve(&w->buf, bufferSize))
+        w->failed = true;
+}
+
+static void
+Writer_flush(Writer *w) {
+    if(w->buf.length > 0 &&
+       fwrite(w->buf.data, 1, w->buf.length, w->file) != w->buf.length)
+        w->failed = true;
+    w->buf.length = 0;
+}
+
+void
+Writer_append(Writer *w, const char *data, size_t length) {
+    if(!w->file || w->failed)
+        return;
+    if(w->buf.length + length > w->bufferSize)
+        Writer_flush(w);
+    if(length < w->bufferSize) {
+        Buffer_append(&w->buf, data, length);
+        return;
+    }
+    // Larger than the buffer, write without copying
+    if(fwrite(data, 1, length, w->file) != length)
+        w->failed = true;
+}
+
+void
+Writer_write(Writer *w, const Buffer *b) {
+    if(b->failed) {
+        w->failed = true;
+        return;
+    }
+    Writer_append(w, b->data, b->length);
+}
+
+bool
+Writer_finish(Writer *w) {
+    bool ok = true;
+    if(w->file) {
+        if(!w->failed)
+            Writer_flush(w);
+        ok = !w->failed && fflush(w->file) == 0;
+    }
+    Buffer_clear(&w->buf);
+    return ok;
+}
+
+// The namespaceUris of the mapping are the merged table of all files,
+// remote2local maps the indices of the file being imported
+static void
+addNamespace(void *userContext, size_t localNamespaceUrisSize,
+             UA_String *localNamespaceUris, UA_NamespaceMapping *nsMapping) {
+    bool *remapped = (bool *)userContext;
+    for(size_t i = 0; i < localNamespaceUrisSize; i++) {
+        size_t idx = 0;
+        while(idx < nsMapping->namespaceUrisSize &&
+              !UA_String_equal(&localNamespaceUris[i],
+                               &nsMapping->namespaceUris[idx]))
+            idx++;
+        if(idx == nsMapping->namespaceUrisSize)
+            UA_Array_appendCopy((void **)&nsMapping->namespaceUris,
+                                &nsMapping->namespaceUrisSize,
+                                &localNamespaceUris[i],
+                                &UA_TYPES[UA_TYPES_STRING]);
+        // ns0 is the first entry of every file already
+        if(idx == 0)
+            continue;
+        if(idx != nsMapping->remote2localSize)
+            *remapped = true;
+        UA_UInt16 localIdx = (UA_UInt16)idx;
+        UA_Array_appendCopy((void **)&nsMapping->remote2local,
+                            &nsMapping->remote2localSize, &localIdx,
+                            &UA_TYPES[UA_TYPES_UINT16]);
+    }
+}
+
+bool
+Output_importFiles(NodesetLoader *loader, UA_NamespaceMapping *nsMapping,
+                   size_t filesSize, const char *const *files,
+                   bool captureRawExtensions, bool *remapped) {
+    *remapped = false;
+    UA_String ns0 = UA_STRING("http://opcfoundation.org/UA/");
+    UA_Array_appendCopy((void **)&nsMapping->namespaceUris,
+                        &nsMapping->namespaceUrisSize, &ns0,
+                        &UA_TYPES[UA_TYPES_STRING]);
+
+    NL_FileContext handler;
+    memset(&handler, 0, sizeof(NL_FileContext));
+    handler.addNamespace = addNamespace;
+    handler.userContext = remapped;
+    handler.nsMapping = nsMapping;
+    handler.captureRawExtensions = captureRawExtensions;
+
+    for(size_t i = 0; i < filesSize; i++) {
+        // Every file starts with its own indices, ns0 is implied
+        UA_Array_delete(nsMapping->remote2local, nsMapping->remote2localSize,
+                        &UA_TYPES[UA_TYPES_UINT16]);
+        nsMapping->remote2local = NULL;
+        nsMapping->remote2localSize = 0;
+        UA_UInt16 zero = 0;
+        UA_Array_appendCopy((void **)&nsMapping->remote2local,
+                            &nsMapping->remote2localSize, &zero,
+                            &UA_TYPES[UA_TYPES_UINT16]);
+        handler.file = files[i];
+        if(!NodesetLoader_importFile(loader, &handler))
+            return false;
+    }
+    return NodesetLoader_sort(loader);
+}
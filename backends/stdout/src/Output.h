@@ -0,0 +1,56 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "NodesetLoader/NodesetLoader.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/* Growable byte buffer. Appending stops after a failed allocation. */
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+} Buffer;
+
+bool Buffer_reserve(Buffer *b, size_t size);
+void Buffer_append(Buffer *b, const char *data, size_t size);
+#define Buffer_appendLiteral(b, s) Buffer_append(b, s, sizeof(s) - 1)
+void Buffer_appendChar(Buffer *b, char c);
+void Buffer_appendUInt(Buffer *b, unsigned long value);
+/* The string encoding of the NodeId, without escaping */
+void Buffer_appendNodeId(Buffer *b, const UA_NodeId *id);
+void Buffer_clear(Buffer *b);
+
+/* Collects output and writes it to the file in blocks of bufferSize. A NULL
+ * file discards the output. */
+typedef struct {
+    FILE *file;
+    Buffer buf;
+    size_t bufferSize;
+    bool failed;
+} Writer;
+
+void Writer_init(Writer *w, FILE *file, size_t bufferSize);
+void Writer_append(Writer *w, const char *data, size_t length);
+void Writer_write(Writer *w, const Buffer *b);
+/* Writes the rest and releases the buffer. Returns false if a write failed. */
+bool Writer_finish(Writer *w);
+
+/* Imports the files into the loader with one namespace table. The
+ * namespaceUris of nsMapping receive the merged table, index 0 is the OPC UA
+ * namespace. remapped is set if the indices of a file differ from the merged
+ * ones. */
+bool
+Output_importFiles(NodesetLoader *loader, UA_NamespaceMapping *nsMapping,
+                   size_t filesSize, const char *const *files,
+                   bool captureRawExtensions, bool *remapped);
+
+#endif
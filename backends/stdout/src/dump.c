@@ -0,0 +1,492 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "NodesetLoader/backendDump.h"
+#include "Output.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define DUMP_DEFAULT_BUFFERSIZE (4u * 1024u * 1024u)
+// Nodes per chunk. Every chunk is formatted by one thread into its own
+// buffers, the buffers are written in the sorted order.
+#define DUMP_CHUNK_NODES 4096
+
+static const char hexDigits[] = "0123456789abcdef";
+
+// Escapes quotes, backslashes and control characters, UTF-8 passes through
+static void
+appendJsonEscaped(Buffer *b, const UA_Byte *data, size_t length) {
+    if(!Buffer_reserve(b, length * 6)) // Worst case \u00XX for every byte
+        return;
+    char *out = b->data + b->length;
+    for(size_t i = 0; i < length; i++) {
+        UA_Byte c = data[i];
+        if(c == '"' || c == '\\') {
+            *out++ = '\\';
+            *out++ = (char)c;
+        } else if(c == '\n') {
+            *out++ = '\\';
+            *out++ = 'n';
+        } else if(c == '\r') {
+            *out++ = '\\';
+            *out++ = 'r';
+        } else if(c == '\t') {
+            *out++ = '\\';
+            *out++ = 't';
+        } else if(c < 0x20) {
+            memcpy(out, "\\u00", 4);
+            out[4] = hexDigits[c >> 4];
+            out[5] = hexDigits[c & 0xf];
+            out += 6;
+        } else {
+            *out++ = (char)c;
+        }
+    }
+    b->length = (size_t)(out - b->data);
+}
+
+// Fields with separators, quotes or line breaks are quoted, inner quotes
+// are doubled
+static void
+appendCsvEscaped(Buffer *b, const UA_Byte *data, size_t length) {
+    bool quote = false;
+    for(size_t i = 0; i < length && !quote; i++)
+        quote = (data[i] == ',' || data[i] == '"' || data[i] == '\n' ||
+                 data[i] == '\r');
+    if(!quote) {
+        Buffer_append(b, (const char *)data, length);
+        return;
+    }
+    Buffer_appendChar(b, '"');
+    size_t start = 0;
+    for(size_t i = 0; i < length; i++) {
+        if(data[i] != '"')
+            continue;
+        Buffer_append(b, (const char *)&data[start], i + 1 - start);
+        Buffer_appendChar(b, '"');
+        start = i + 1;
+    }
+    Buffer_append(b, (const char *)&data[start], length - start);
+    Buffer_appendChar(b, '"');
+}
+
+/* A record is a JSON object or a CSV row. Fields are written in the order of
+ * the CSV header. */
+typedef struct {
+    Buffer *buf;
+    NodesetLoader_DumpFormat format;
+    size_t fields;
+} Record;
+
+static void
+Record_begin(Record *r, Buffer *buf, NodesetLoader_DumpFormat format) {
+    r->buf = buf;
+    r->format = format;
+    r->fields = 0;
+    if(format == NODESETLOADER_DUMP_JSONL)
+        Buffer_appendChar(buf, '{');
+}
+
+static void
+Record_field(Record *r, const char *name) {
+    if(r->fields++ > 0)
+        Buffer_appendChar(r->buf, ',');
+    if(r->format != NODESETLOADER_DUMP_JSONL)
+        return;
+    Buffer_appendChar(r->buf, '"');
+    Buffer_append(r->buf, name, strlen(name));
+    Buffer_appendLiteral(r->buf, "\":");
+}
+
+static void
+Record_end(Record *r) {
+    if(r->format == NODESETLOADER_DUMP_JSONL)
+        Buffer_appendChar(r->buf, '}');
+    Buffer_appendChar(r->buf, '\n');
+}
+
+static void
+Record_text(Record *r, const char *name, const UA_Byte *data, size_t length) {
+    Record_field(r, name);
+    if(r->format == NODESETLOADER_DUMP_JSONL) {
+        Buffer_appendChar(r->buf, '"');
+        appendJsonEscaped(r->buf, data, length);
+        Buffer_appendChar(r->buf, '"');
+    } else {
+        appendCsvEscaped(r->buf, data, length);
+    }
+}
+
+// Null in JSON, an empty field in CSV
+static void
+Record_null(Record *r, const char *name) {
+    Record_field(r, name);
+    if(r->format == NODESETLOADER_DUMP_JSONL)
+        Buffer_appendLiteral(r->buf, "null");
+}
+
+static void
+Record_cstring(Record *r, const char *name, const char *s) {
+    if(!s) {
+        Record_null(r, name);
+        return;
+    }
+    Record_text(r, name, (const UA_Byte *)s, strlen(s));
+}
+
+static void
+Record_bool(Record *r, const char *name, bool value) {
+    Record_field(r, name);
+    if(value)
+        Buffer_appendLiteral(r->buf, "true");
+    else
+        Buffer_appendLiteral(r->buf, "false");
+}
+
+static void
+Record_uint(Record *r, const char *name, unsigned long value) {
+    Record_field(r, name);
+    Buffer_appendUInt(r->buf, value);
+}
+
+typedef struct {
+    NodesetLoader_DumpFormat format;
+    bool nodes;
+    bool references;
+    Buffer nodesBuf;
+    Buffer refsBuf;
+    Buffer scratch; // Printed NodeIds and BrowseNames before escaping
+} Formatter;
+
+static void
+Record_nodeId(Record *r, Formatter *f, const char *name, const UA_NodeId *id) {
+    if(!id || UA_NodeId_isNull(id)) {
+        Record_null(r, name);
+        return;
+    }
+    f->scratch.length = 0;
+    Buffer_appendNodeId(&f->scratch, id);
+    Record_text(r, name, (const UA_Byte *)f->scratch.data, f->scratch.length);
+}
+
+static const UA_NodeId *
+typeDefinition(const NL_Node *node) {
+    for(const NL_Reference *ref = node->refs; ref; ref = ref->next) {
+        if(ref->isForward && ref->refType.namespaceIndex == 0 &&
+           ref->refType.identifierType == UA_NODEIDTYPE_NUMERIC &&
+           ref->refType.identifier.numeric == UA_NS0ID_HASTYPEDEFINITION)
+            return &ref->target;
+    }
+    return NULL;
+}
+
+static void
+formatNode(Formatter *f, const NL_Node *node) {
+    Record r;
+    Record_begin(&r, &f->nodesBuf, f->format);
+    Record_nodeId(&r, f, "nodeId", &node->id);
+    Record_cstring(&r, "nodeClass", NL_NODECLASS_NAME[node->nodeClass]);
+
+    // BrowseName as "ns:name", the namespace is omitted for ns0
+    f->scratch.length = 0;
+    if(node->browseName.namespaceIndex != 0) {
+        Buffer_appendUInt(&f->scratch, node->browseName.namespaceIndex);
+        Buffer_appendChar(&f->scratch, ':');
+    }
+    Buffer_append(&f->scratch, (const char *)node->browseName.name.data,
+                  node->browseName.name.length);
+    Record_text(&r, "browseName", (const UA_Byte *)f->scratch.data,
+                f->scratch.length);
+    Record_text(&r, "displayName", node->displayName.text.data,
+                node->displayName.text.length);
+    Record_text(&r, "description", node->description.text.data,
+                node->description.text.length);
+
+    if(node->parentRef) {
+        Record_nodeId(&r, f, "parentNodeId", &node->parentRef->target);
+        Record_nodeId(&r, f, "parentReferenceType", &node->parentRef->refType);
+    } else {
+        Record_null(&r, "parentNodeId");
+        Record_null(&r, "parentReferenceType");
+    }
+    Record_nodeId(&r, f, "typeDefinition", typeDefinition(node));
+
+    const UA_NodeId *dataType = NULL;
+    const char *valueRank = NULL;
+    if(node->nodeClass == NODECLASS_VARIABLE) {
+        dataType = &((const NL_VariableNode *)node)->datatype;
+        valueRank = ((const NL_VariableNode *)node)->valueRank;
+    } else if(node->nodeClass == NODECLASS_VARIABLETYPE) {
+        dataType = &((const NL_VariableTypeNode *)node)->datatype;
+        valueRank = ((const NL_VariableTypeNode *)node)->valueRank;
+    }
+    Record_nodeId(&r, f, "dataType", dataType);
+    Record_cstring(&r, "valueRank", valueRank);
+    Record_end(&r);
+}
+
+static void
+formatReferences(Formatter *f, const NL_Node *node) {
+    for(const NL_Reference *ref = node->refs; ref; ref = ref->next) {
+        Record r;
+        Record_begin(&r, &f->refsBuf, f->format);
+        Record_nodeId(&r, f, "source", &node->id);
+        Record_nodeId(&r, f, "referenceType", &ref->refType);
+        Record_nodeId(&r, f, "target", &ref->target);
+        Record_bool(&r, "isForward", ref->isForward);
+        Record_end(&r);
+    }
+}
+
+static void
+Formatter_clear(Formatter *f) {
+    Buffer_clear(&f->nodesBuf);
+    Buffer_clear(&f->refsBuf);
+    Buffer_clear(&f->scratch);
+}
+
+static void
+writeHeader(Writer *w, NodesetLoader_DumpFormat format, const char *header) {
+    if(format != NODESETLOADER_DUMP_CSV)
+        return;
+    Writer_append(w, header, strlen(header));
+}
+
+typedef struct {
+    NL_Node **nodes;
+    size_t nodesSize;
+    Formatter f;
+} Chunk;
+
+static void
+formatChunk(Chunk *c) {
+    c->f.nodesBuf.length = 0;
+    c->f.refsBuf.length = 0;
+    for(size_t i = 0; i < c->nodesSize; i++) {
+        if(c->f.nodes)
+            formatNode(&c->f, c->nodes[i]);
+        if(c->f.references)
+            formatReferences(&c->f, c->nodes[i]);
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+formatThread(LPVOID c) {
+    formatChunk((Chunk *)c);
+    return 0;
+}
+#else
+static void *
+formatThread(void *c) {
+    formatChunk((Chunk *)c);
+    return NULL;
+}
+#endif
+
+static size_t
+defaultThreadCount(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (size_t)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (size_t)n : 1;
+#endif
+}
+
+static void
+formatChunks(Chunk *chunks, size_t chunksSize) {
+    // The calling thread formats the first chunk itself
+#ifdef _WIN32
+    HANDLE *threads = (HANDLE *)calloc(chunksSize, sizeof(HANDLE));
+#else
+    pthread_t *threads = (pthread_t *)calloc(chunksSize, sizeof(pthread_t));
+#endif
+    bool *started = (bool *)calloc(chunksSize, sizeof(bool));
+    if(threads && started) {
+        for(size_t i = 1; i < chunksSize; i++) {
+#ifdef _WIN32
+            threads[i] = CreateThread(NULL, 0, formatThread, &chunks[i], 0, NULL);
+            started[i] = (threads[i] != NULL);
+#else
+            started[i] = (pthread_create(&threads[i], NULL, formatThread,
+                                         &chunks[i]) == 0);
+#endif
+        }
+    }
+    formatChunk(&chunks[0]);
+    for(size_t i = 1; i < chunksSize; i++) {
+        if(!started || !started[i]) {
+            formatChunk(&chunks[i]); // No thread, format here
+            continue;
+        }
+#ifdef _WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+    free(started);
+    free(threads);
+}
+
+typedef struct {
+    NL_Node **nodes;
+    size_t size;
+    size_t capacity;
+    bool failed;
+} NodeList;
+
+static bool
+collectNode(NodeList *list, NL_Node *node) {
+    if(list->size == list->capacity) {
+        size_t capacity = (list->capacity > 0) ? list->capacity * 2 : 1024;
+        NL_Node **nodes =
+            (NL_Node **)realloc(list->nodes, capacity * sizeof(NL_Node *));
+        if(!nodes) {
+            list->failed = true;
+            return false;
+        }
+        list->nodes = nodes;
+        list->capacity = capacity;
+    }
+    list->nodes[list->size++] = node;
+    return true;
+}
+
+bool
+NodesetLoader_dump(NodesetLoader *loader,
+                   const NodesetLoader_DumpOptions *options) {
+    NodeList list;
+    memset(&list, 0, sizeof(NodeList));
+    NodesetLoader_forEachNode(loader, &list,
+                              (NodesetLoader_forEachNode_Func)collectNode);
+    if(list.failed) {
+        free(list.nodes);
+        return false;
+    }
+
+    size_t bufferSize = options->bufferSize;
+    if(bufferSize == 0)
+        bufferSize = DUMP_DEFAULT_BUFFERSIZE;
+    Writer nodesWriter;
+    Writer refsWriter;
+    Writer_init(&nodesWriter, options->nodes, bufferSize);
+    Writer_init(&refsWriter, options->references, bufferSize);
+    writeHeader(&nodesWriter, options->format,
+                "nodeId,nodeClass,browseName,displayName,description,"
+                "parentNodeId,parentReferenceType,typeDefinition,dataType,"
+                "valueRank\n");
+    writeHeader(&refsWriter, options->format,
+                "source,referenceType,target,isForward\n");
+
+    size_t threads = options->threads;
+    if(threads == 0)
+        threads = defaultThreadCount();
+    size_t chunksTotal = (list.size + DUMP_CHUNK_NODES - 1) / DUMP_CHUNK_NODES;
+    if(threads > chunksTotal)
+        threads = chunksTotal;
+    if(threads == 0)
+        threads = 1;
+
+    // Every round formats one chunk per thread, then writes them in order.
+    // The chunk buffers are reused across the rounds.
+    Chunk *chunks = (Chunk *)calloc(threads, sizeof(Chunk));
+    bool ok = (chunks != NULL);
+    for(size_t i = 0; ok && i < threads; i++) {
+        chunks[i].f.format = options->format;
+        chunks[i].f.nodes = (options->nodes != NULL);
+        chunks[i].f.references = (options->references != NULL);
+    }
+    size_t pos = 0;
+    while(ok && pos < list.size) {
+        size_t used = 0;
+        for(; used < threads && pos < list.size; used++) {
+            size_t n = list.size - pos;
+            if(n > DUMP_CHUNK_NODES)
+                n = DUMP_CHUNK_NODES;
+            chunks[used].nodes = &list.nodes[pos];
+            chunks[used].nodesSize = n;
+            pos += n;
+        }
+        formatChunks(chunks, used);
+        for(size_t i = 0; i < used; i++) {
+            Writer_write(&nodesWriter, &chunks[i].f.nodesBuf);
+            Writer_write(&refsWriter, &chunks[i].f.refsBuf);
+        }
+        ok = !nodesWriter.failed && !refsWriter.failed;
+    }
+
+    for(size_t i = 0; chunks && i < threads; i++)
+        Formatter_clear(&chunks[i].f);
+    free(chunks);
+    free(list.nodes);
+    if(!Writer_finish(&nodesWriter))
+        ok = false;
+    if(!Writer_finish(&refsWriter))
+        ok = false;
+    return ok;
+}
+
+static bool
+writeNamespaces(const UA_NamespaceMapping *nsMapping,
+                const NodesetLoader_DumpOptions *options) {
+    Writer w;
+    Writer_init(&w, options->namespaces, 64 * 1024);
+    writeHeader(&w, options->format, "index,uri\n");
+    Buffer b;
+    memset(&b, 0, sizeof(Buffer));
+    for(size_t i = 0; i < nsMapping->namespaceUrisSize; i++) {
+        Record r;
+        Record_begin(&r, &b, options->format);
+        Record_uint(&r, "index", (unsigned long)i);
+        Record_text(&r, "uri", nsMapping->namespaceUris[i].data,
+                    nsMapping->namespaceUris[i].length);
+        Record_end(&r);
+    }
+    Writer_write(&w, &b);
+    Buffer_clear(&b);
+    return Writer_finish(&w);
+}
+
+static void
+logNothing(void *context, enum NodesetLoader_LogLevel level,
+           const char *message, ...) {}
+
+bool
+NodesetLoader_dumpFiles(size_t filesSize, const char *const *files,
+                        NodesetLoader_Logger *logger,
+                        const NodesetLoader_DumpOptions *options) {
+    NodesetLoader_Logger silent = {NULL, logNothing};
+    if(!logger)
+        logger = &silent;
+
+    NodesetLoader *loader = NodesetLoader_new(logger);
+    if(!loader)
+        return false;
+    UA_NamespaceMapping nsMapping;
+    memset(&nsMapping, 0, sizeof(UA_NamespaceMapping));
+    bool remapped = false;
+    bool ok = Output_importFiles(loader, &nsMapping, filesSize, files, false,
+                                 &remapped);
+    if(ok)
+        ok = NodesetLoader_dump(loader, options);
+    if(ok)
+        ok = writeNamespaces(&nsMapping, options);
+    NodesetLoader_delete(loader);
+    UA_NamespaceMapping_clear(&nsMapping);
+    return ok;
+}
@@ -0,0 +1,518 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "NodesetLoader/backendNodesetWriter.h"
+#include "Output.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define WRITER_DEFAULT_BUFFERSIZE (4u * 1024u * 1024u)
+
+static const char *const elementName[NL_NODECLASS_COUNT] = {
+    "UAObject", "UAObjectType", "UAVariable", "UADataType",
+    "UAMethod", "UAReferenceType", "UAVariableType", "UAView"};
+
+static const UA_NodeId hasTypeDefinition = {0, UA_NODEIDTYPE_NUMERIC, {40}};
+static const UA_NodeId baseDataType = {0, UA_NODEIDTYPE_NUMERIC, {24}};
+
+typedef struct {
+    const char *name;
+    UA_NodeId id;
+    bool used;
+} WriterAlias;
+
+typedef struct {
+    WriterAlias *aliases; // Sorted by the NodeId
+    size_t aliasesSize;
+    const NodesetLoader_NodesetWriterOptions *options;
+    Buffer out;
+    Buffer scratch; // Printed NodeIds and BrowseNames before escaping
+    Writer writer;
+} NodesetWriter;
+
+// Escapes the markup characters. In attributes also the quotes and the
+// whitespace that the parser would normalize.
+static void
+appendXmlEscaped(Buffer *b, const char *data, size_t length, bool attribute) {
+    size_t start = 0;
+    for(size_t i = 0; i < length; i++) {
+        const char *entity = NULL;
+        switch(data[i]) {
+        case '&': entity = "&amp;"; break;
+        case '<': entity = "&lt;"; break;
+        case '>': entity = "&gt;"; break;
+        case '"': entity = attribute ? "&quot;" : NULL; break;
+        case '\n': entity = attribute ? "&#10;" : NULL; break;
+        case '\r': entity = "&#13;"; break;
+        case '\t': entity = attribute ? "&#9;" : NULL; break;
+        default: break;
+        }
+        if(!entity)
+            continue;
+        Buffer_append(b, &data[start], i - start);
+        Buffer_append(b, entity, strlen(entity));
+        start = i + 1;
+    }
+    Buffer_append(b, &data[start], length - start);
+}
+
+static void
+appendAttribute(Buffer *b, const char *name, const char *value,
+                size_t length) {
+    Buffer_appendChar(b, ' ');
+    Buffer_append(b, name, strlen(name));
+    Buffer_appendLiteral(b, "=\"");
+    appendXmlEscaped(b, value, length, true);
+    Buffer_appendChar(b, '"');
+}
+
+// Omitted if it is the default value of the loader
+static void
+appendStringAttribute(Buffer *b, const char *name, const char *value,
+                      const char *defaultValue) {
+    if(!value || (defaultValue && !strcmp(value, defaultValue)))
+        return;
+    appendAttribute(b, name, value, strlen(value));
+}
+
+static int
+compareAlias(const void *a, const void *b) {
+    return (int)UA_NodeId_order(&((const WriterAlias *)a)->id,
+                                &((const WriterAlias *)b)->id);
+}
+
+static WriterAlias *
+findAlias(const NodesetWriter *w, const UA_NodeId *id) {
+    if(w->aliasesSize == 0)
+        return NULL;
+    WriterAlias key;
+    key.id = *id;
+    return (WriterAlias *)bsearch(&key, w->aliases, w->aliasesSize,
+                                  sizeof(WriterAlias), compareAlias);
+}
+
+// A NodeId in the text or an attribute, aliased if possible
+static void
+appendNodeId(NodesetWriter *w, const UA_NodeId *id, bool useAlias,
+             bool attribute) {
+    WriterAlias *alias = useAlias ? findAlias(w, id) : NULL;
+    if(alias) {
+        appendXmlEscaped(&w->out, alias->name, strlen(alias->name), attribute);
+        return;
+    }
+    w->scratch.length = 0;
+    Buffer_appendNodeId(&w->scratch, id);
+    appendXmlEscaped(&w->out, w->scratch.data, w->scratch.length, attribute);
+}
+
+static void
+appendNodeIdAttribute(NodesetWriter *w, const char *name, const UA_NodeId *id,
+                      bool useAlias) {
+    Buffer_appendChar(&w->out, ' ');
+    Buffer_append(&w->out, name, strlen(name));
+    Buffer_appendLiteral(&w->out, "=\"");
+    appendNodeId(w, id, useAlias, true);
+    Buffer_appendChar(&w->out, '"');
+}
+
+/* The consolidated alias table. The first alias of a name wins, as in the
+ * lookup of the loader, and every NodeId gets a single alias. */
+static bool
+collectAlias(NodesetWriter *w, const char *name, const UA_NodeId *id) {
+    if(!name || UA_NodeId_isNull(id))
+        return true;
+    for(size_t i = 0; i < w->aliasesSize; i++) {
+        if(!strcmp(w->aliases[i].name, name) ||
+           UA_NodeId_equal(&w->aliases[i].id, id))
+            return true;
+    }
+    WriterAlias *aliases = (WriterAlias *)
+        realloc(w->aliases, (w->aliasesSize + 1) * sizeof(WriterAlias));
+    if(!aliases)
+        return false;
+    w->aliases = aliases;
+    w->aliases[w->aliasesSize].name = name;
+    w->aliases[w->aliasesSize].id = *id;
+    w->aliases[w->aliasesSize].used = false;
+    w->aliasesSize++;
+    return true;
+}
+
+// A reference given in both directions is written once. The inverse
+// direction is kept, the sort of the loader finds the parent and the
+// dependencies there. Only HasTypeDefinition is sorted by the forward one.
+static bool
+isDuplicate(const NL_Node *node, const NL_Reference *ref) {
+    if(!ref->targetPtr)
+        return false;
+    bool typeDefinition = UA_NodeId_equal(&ref->refType, &hasTypeDefinition);
+    if(ref->isForward == typeDefinition)
+        return false;
+    for(const NL_Reference *r = ref->targetPtr->refs; r; r = r->next) {
+        if(r->isForward != ref->isForward &&
+           UA_NodeId_equal(&r->refType, &ref->refType) &&
+           UA_NodeId_equal(&r->target, &node->id))
+            return true;
+    }
+    return false;
+}
+
+static void
+markUsed(NodesetWriter *w, const UA_NodeId *id) {
+    WriterAlias *alias = findAlias(w, id);
+    if(alias)
+        alias->used = true;
+}
+
+static bool
+markUsedAliases(NodesetWriter *w, NL_Node *node) {
+    for(const NL_Reference *ref = node->refs; ref; ref = ref->next) {
+        if(!isDuplicate(node, ref))
+            markUsed(w, &ref->refType);
+    }
+    if(node->nodeClass == NODECLASS_VARIABLE)
+        markUsed(w, &((NL_VariableNode *)node)->datatype);
+    if(node->nodeClass == NODECLASS_VARIABLETYPE)
+        markUsed(w, &((NL_VariableTypeNode *)node)->datatype);
+    if(node->nodeClass == NODECLASS_DATATYPE &&
+       ((NL_DataTypeNode *)node)->definition) {
+        const NL_DataTypeDefinition *def = ((NL_DataTypeNode *)node)->definition;
+        for(size_t i = 0; i < def->fieldCnt; i++)
+            markUsed(w, &def->fields[i].dataType);
+    }
+    return true;
+}
+
+// QualifiedName as "ns:name", the namespace is omitted for ns0
+static void
+appendQualifiedNameAttribute(NodesetWriter *w, const char *name,
+                             const UA_QualifiedName *qn) {
+    w->scratch.length = 0;
+    if(qn->namespaceIndex != 0) {
+        Buffer_appendUInt(&w->scratch, qn->namespaceIndex);
+        Buffer_appendChar(&w->scratch, ':');
+    }
+    Buffer_append(&w->scratch, (const char *)qn->name.data, qn->name.length);
+    appendAttribute(&w->out, name, w->scratch.data, w->scratch.length);
+}
+
+static void
+appendLocalizedText(Buffer *b, const char *element, const UA_LocalizedText *lt) {
+    Buffer_appendLiteral(b, "    <");
+    Buffer_append(b, element, strlen(element));
+    if(lt->locale.length > 0)
+        appendAttribute(b, "Locale", (const char *)lt->locale.data,
+                        lt->locale.length);
+    Buffer_appendChar(b, '>');
+    appendXmlEscaped(b, (const char *)lt->text.data, lt->text.length, false);
+    Buffer_appendLiteral(b, "</");
+    Buffer_append(b, element, strlen(element));
+    Buffer_appendLiteral(b, ">\n");
+}
+
+static void
+appendDataType(NodesetWriter *w, const UA_NodeId *dataType) {
+    if(!UA_NodeId_equal(dataType, &baseDataType))
+        appendNodeIdAttribute(w, "DataType", dataType, true);
+}
+
+static void
+appendNodeAttributes(NodesetWriter *w, const NL_Node *node) {
+    Buffer *b = &w->out;
+    appendNodeIdAttribute(w, "NodeId", &node->id, false);
+    appendQualifiedNameAttribute(w, "BrowseName", &node->browseName);
+    if(node->parentRef && (node->nodeClass == NODECLASS_OBJECT ||
+                           node->nodeClass == NODECLASS_VARIABLE ||
+                           node->nodeClass == NODECLASS_METHOD))
+        appendNodeIdAttribute(w, "ParentNodeId", &node->parentRef->target, false);
+    appendStringAttribute(b, "WriteMask", node->writeMask, NULL);
+
+    switch(node->nodeClass) {
+    case NODECLASS_OBJECT:
+        appendStringAttribute(b, "EventNotifier",
+                              ((const NL_ObjectNode *)node)->eventNotifier, "0");
+        break;
+    case NODECLASS_OBJECTTYPE:
+        appendStringAttribute(b, "IsAbstract",
+                              ((const NL_ObjectTypeNode *)node)->isAbstract,
+                              "false");
+        break;
+    case NODECLASS_VARIABLE: {
+        const NL_VariableNode *v = (const NL_VariableNode *)node;
+        appendDataType(w, &v->datatype);
+        appendStringAttribute(b, "ValueRank", v->valueRank, "-1");
+        appendStringAttribute(b, "ArrayDimensions", v->arrayDimensions, "");
+        appendStringAttribute(b, "AccessLevel", v->accessLevel, "1");
+        appendStringAttribute(b, "UserAccessLevel", v->userAccessLevel, "1");
+        appendStringAttribute(b, "MinimumSamplingInterval",
+                              v->minimumSamplingInterval, "-1");
+        appendStringAttribute(b, "Historizing", v->historizing, "false");
+        break;
+    }
+    case NODECLASS_VARIABLETYPE: {
+        const NL_VariableTypeNode *vt = (const NL_VariableTypeNode *)node;
+        appendDataType(w, &vt->datatype);
+        appendStringAttribute(b, "ValueRank", vt->valueRank, "-1");
+        appendStringAttribute(b, "ArrayDimensions", vt->arrayDimensions, "");
+        appendStringAttribute(b, "IsAbstract", vt->isAbstract, "false");
+        break;
+    }
+    case NODECLASS_DATATYPE:
+        appendStringAttribute(b, "IsAbstract",
+                              ((const NL_DataTypeNode *)node)->isAbstract,
+                              "false");
+        break;
+    case NODECLASS_METHOD:
+        appendStringAttribute(b, "Executable",
+                              ((const NL_MethodNode *)node)->executable, "true");
+        appendStringAttribute(b, "UserExecutable",
+                              ((const NL_MethodNode *)node)->userExecutable,
+                              "true");
+        break;
+    case NODECLASS_REFERENCETYPE:
+        appendStringAttribute(b, "Symmetric",
+                              ((const NL_ReferenceTypeNode *)node)->symmetric,
+                              "false");
+        break;
+    case NODECLASS_VIEW:
+        appendStringAttribute(b, "ContainsNoLoops",
+                              ((const NL_ViewNode *)node)->containsNoLoops,
+                              "false");
+        appendStringAttribute(b, "EventNotifier",
+                              ((const NL_ViewNode *)node)->eventNotifier, "0");
+        break;
+    default:
+        break;
+    }
+}
+
+static void
+appendReferences(NodesetWriter *w, const NL_Node *node) {
+    Buffer *b = &w->out;
+    bool open = false;
+    for(const NL_Reference *ref = node->refs; ref; ref = ref->next) {
+        if(isDuplicate(node, ref))
+            continue;
+        if(!open) {
+            Buffer_appendLiteral(b, "    <References>\n");
+            open = true;
+        }
+        Buffer_appendLiteral(b, "      <Reference");
+        appendNodeIdAttribute(w, "ReferenceType", &ref->refType, true);
+        if(!ref->isForward)
+            Buffer_appendLiteral(b, " IsForward=\"false\"");
+        Buffer_appendChar(b, '>');
+        appendNodeId(w, &ref->target, false, false);
+        Buffer_appendLiteral(b, "</Reference>\n");
+    }
+    if(open)
+        Buffer_appendLiteral(b, "    </References>\n");
+}
+
+static void
+appendDefinition(NodesetWriter *w, const NL_DataTypeNode *node) {
+    const NL_DataTypeDefinition *def = node->definition;
+    Buffer *b = &w->out;
+    Buffer_appendLiteral(b, "    <Definition");
+    appendQualifiedNameAttribute(w, "Name", &node->browseName);
+    if(def->isUnion)
+        Buffer_appendLiteral(b, " IsUnion=\"true\"");
+    if(def->isOptionSet)
+        Buffer_appendLiteral(b, " IsOptionSet=\"true\"");
+    if(def->fieldCnt == 0) {
+        Buffer_appendLiteral(b, "/>\n");
+        return;
+    }
+    Buffer_appendLiteral(b, ">\n");
+    for(size_t i = 0; i < def->fieldCnt; i++) {
+        const NL_DataTypeDefinitionField *field = &def->fields[i];
+        Buffer_appendLiteral(b, "      <Field");
+        appendStringAttribute(b, "Name", field->name, NULL);
+        if(def->isEnum || def->isOptionSet) {
+            char value[16];
+            int len = snprintf(value, sizeof(value), "%d", field->value);
+            appendAttribute(b, "Value", value, (size_t)len);
+        } else {
+            appendDataType(w, &field->dataType);
+            if(field->valueRank != -1) {
+                char valueRank[16];
+                int len = snprintf(valueRank, sizeof(valueRank), "%d",
+                                   field->valueRank);
+                appendAttribute(b, "ValueRank", valueRank, (size_t)len);
+            }
+            if(field->isOptional)
+                Buffer_appendLiteral(b, " IsOptional=\"true\"");
+        }
+        Buffer_appendLiteral(b, "/>\n");
+    }
+    Buffer_appendLiteral(b, "    </Definition>\n");
+}
+
+static bool
+writeNode(NodesetWriter *w, NL_Node *node) {
+    Buffer *b = &w->out;
+    const char *element = elementName[node->nodeClass];
+    b->length = 0;
+    Buffer_appendLiteral(b, "  <");
+    Buffer_append(b, element, strlen(element));
+    appendNodeAttributes(w, node);
+    Buffer_appendLiteral(b, ">\n");
+
+    if(node->displayName.text.length > 0)
+        appendLocalizedText(b, "DisplayName", &node->displayName);
+    if(!w->options->stripDescriptions && node->description.text.length > 0)
+        appendLocalizedText(b, "Description", &node->description);
+    appendReferences(w, node);
+    if(!w->options->stripExtensions && node->extension) {
+        const UA_String *raw = (const UA_String *)node->extension;
+        Buffer_appendLiteral(b, "    ");
+        Buffer_append(b, (const char *)raw->data, raw->length);
+        Buffer_appendChar(b, '\n');
+    }
+    if(node->nodeClass == NODECLASS_VARIABLE) {
+        const UA_String *value = &((NL_VariableNode *)node)->value;
+        if(value->length > 0) {
+            Buffer_appendLiteral(b, "    ");
+            Buffer_append(b, (const char *)value->data, value->length);
+            Buffer_appendChar(b, '\n');
+        }
+    }
+    if(node->nodeClass == NODECLASS_DATATYPE &&
+       ((NL_DataTypeNode *)node)->definition)
+        appendDefinition(w, (NL_DataTypeNode *)node);
+    if(node->nodeClass == NODECLASS_REFERENCETYPE) {
+        const UA_LocalizedText *inverseName =
+            &((NL_ReferenceTypeNode *)node)->inverseName;
+        if(inverseName->text.length > 0)
+            appendLocalizedText(b, "InverseName", inverseName);
+    }
+
+    Buffer_appendLiteral(b, "  </");
+    Buffer_append(b, element, strlen(element));
+    Buffer_appendLiteral(b, ">\n");
+    Writer_write(&w->writer, b);
+    return !w->writer.failed;
+}
+
+static void
+writeHeader(NodesetWriter *w, const UA_String *namespaceUris,
+            size_t namespaceUrisSize) {
+    Buffer *b = &w->out;
+    b->length = 0;
+    Buffer_appendLiteral(b,
+        "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+        "<UANodeSet xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
+        "xmlns:uax=\"http://opcfoundation.org/UA/2008/02/Types.xsd\" "
+        "xmlns=\"http://opcfoundation.org/UA/2011/03/UANodeSet.xsd\">\n");
+    // Index 0 is implied
+    if(namespaceUrisSize > 1) {
+        Buffer_appendLiteral(b, "  <NamespaceUris>\n");
+        for(size_t i = 1; i < namespaceUrisSize; i++) {
+            Buffer_appendLiteral(b, "    <Uri>");
+            appendXmlEscaped(b, (const char *)namespaceUris[i].data,
+                             namespaceUris[i].length, false);
+            Buffer_appendLiteral(b, "</Uri>\n");
+        }
+        Buffer_appendLiteral(b, "  </NamespaceUris>\n");
+    }
+    bool open = false;
+    for(size_t i = 0; i < w->aliasesSize; i++) {
+        const WriterAlias *alias = &w->aliases[i];
+        if(!alias->used)
+            continue;
+        if(!open) {
+            Buffer_appendLiteral(b, "  <Aliases>\n");
+            open = true;
+        }
+        Buffer_appendLiteral(b, "    <Alias");
+        appendAttribute(b, "Alias", alias->name, strlen(alias->name));
+        Buffer_appendChar(b, '>');
+        appendNodeId(w, &alias->id, false, false);
+        Buffer_appendLiteral(b, "</Alias>\n");
+    }
+    if(open)
+        Buffer_appendLiteral(b, "  </Aliases>\n");
+    Writer_write(&w->writer, b);
+}
+
+bool
+NodesetLoader_writeNodeset(NodesetLoader *loader, const UA_String *namespaceUris,
+                           size_t namespaceUrisSize, FILE *out,
+                           const NodesetLoader_NodesetWriterOptions *options) {
+    NodesetWriter w;
+    memset(&w, 0, sizeof(NodesetWriter));
+    w.options = options;
+    size_t bufferSize = options->bufferSize;
+    if(bufferSize == 0)
+        bufferSize = WRITER_DEFAULT_BUFFERSIZE;
+    Writer_init(&w.writer, out, bufferSize);
+
+    bool ok = NodesetLoader_forEachAlias(
+        loader, &w, (NodesetLoader_forEachAlias_Func)collectAlias);
+    if(ok && w.aliasesSize > 1)
+        qsort(w.aliases, w.aliasesSize, sizeof(WriterAlias), compareAlias);
+    if(ok)
+        ok = NodesetLoader_forEachNode(
+            loader, &w, (NodesetLoader_forEachNode_Func)markUsedAliases);
+    if(ok) {
+        writeHeader(&w, namespaceUris, namespaceUrisSize);
+        ok = NodesetLoader_forEachNode(
+            loader, &w, (NodesetLoader_forEachNode_Func)writeNode);
+    }
+    if(ok)
+        Writer_append(&w.writer, "</UANodeSet>\n", 13);
+
+    Buffer_clear(&w.out);
+    Buffer_clear(&w.scratch);
+    free(w.aliases);
+    if(!Writer_finish(&w.writer))
+        ok = false;
+    return ok;
+}
+
+static void
+logNothing(void *context, enum NodesetLoader_LogLevel level,
+           const char *message, ...) {}
+
+// The raw extensions captured by the import are owned by the application
+static bool
+deleteRawExtension(void *context, NL_Node *node) {
+    UA_String_delete((UA_String *)node->extension);
+    node->extension = NULL;
+    return true;
+}
+
+bool
+NodesetLoader_writeNodesetFiles(size_t filesSize, const char *const *files,
+                                NodesetLoader_Logger *logger, FILE *out,
+                                const NodesetLoader_NodesetWriterOptions *options) {
+    NodesetLoader_Logger silent = {NULL, logNothing};
+    if(!logger)
+        logger = &silent;
+
+    NodesetLoader *loader = NodesetLoader_new(logger);
+    if(!loader)
+        return false;
+    UA_NamespaceMapping nsMapping;
+    memset(&nsMapping, 0, sizeof(UA_NamespaceMapping));
+    bool remapped = false;
+    bool ok = Output_importFiles(loader, &nsMapping, filesSize, files,
+                                 !options->stripExtensions, &remapped);
+    if(ok && remapped)
+        logger->log(logger->context, NODESETLOADER_LOGLEVEL_WARNING,
+                    "The namespace indices of the files are merged. Indices "
+                    "inside values and extensions are not rewritten.");
+    if(ok)
+        ok = NodesetLoader_writeNodeset(loader, nsMapping.namespaceUris,
+                                        nsMapping.namespaceUrisSize, out,
+                                        options);
+    if(!options->stripExtensions)
+        NodesetLoader_forEachParsedNode(
+            loader, NULL, (NodesetLoader_forEachNode_Func)deleteRawExtension);
+    NodesetLoader_delete(loader);
+    UA_NamespaceMapping_clear(&nsMapping);
+    return ok;
+}
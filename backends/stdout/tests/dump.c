@@ -0,0 +1,171 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "check.h"
+
+#include <NodesetLoader/backendDump.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const *nodesets = NULL;
+static size_t nodesetsSize = 0;
+
+typedef struct {
+    char *data;
+    size_t length;
+} Output;
+
+static Output
+readAll(FILE *f) {
+    Output out = {NULL, 0};
+    long size = ftell(f);
+    ck_assert(size >= 0);
+    rewind(f);
+    out.data = (char *)calloc((size_t)size + 1, 1);
+    ck_assert(out.data != NULL);
+    out.length = fread(out.data, 1, (size_t)size, f);
+    ck_assert_uint_eq(out.length, (size_t)size);
+    fclose(f);
+    return out;
+}
+
+// Dumps all nodesets, the streams of the options are replaced by temporary
+// files
+static void
+dump(NodesetLoader_DumpOptions *options, Output *nodes, Output *references,
+     Output *namespaces) {
+    options->nodes = tmpfile();
+    options->references = tmpfile();
+    options->namespaces = tmpfile();
+    ck_assert(options->nodes && options->references && options->namespaces);
+    ck_assert(NodesetLoader_dumpFiles(nodesetsSize, nodesets, NULL, options));
+    *nodes = readAll(options->nodes);
+    *references = readAll(options->references);
+    *namespaces = readAll(options->namespaces);
+}
+
+static size_t
+countLines(const Output *out) {
+    size_t lines = 0;
+    for(size_t i = 0; i < out->length; i++)
+        lines += (out->data[i] == '\n');
+    return lines;
+}
+
+START_TEST(Dump_Jsonl) {
+    NodesetLoader_DumpOptions options;
+    memset(&options, 0, sizeof(NodesetLoader_DumpOptions));
+    Output nodes, references, namespaces;
+    dump(&options, &nodes, &references, &namespaces);
+
+    ck_assert(countLines(&nodes) > 0);
+    ck_assert(countLines(&references) > 0);
+    // Every line is one object
+    for(char *line = nodes.data; *line; line = strchr(line, '\n') + 1) {
+        ck_assert(!strncmp(line, "{\"nodeId\":\"", 11));
+        ck_assert(strchr(line, '\n')[-1] == '}');
+    }
+    ck_assert(!strncmp(namespaces.data,
+                       "{\"index\":0,\"uri\":\"http://opcfoundation.org/UA/\"}\n",
+                       48));
+    free(nodes.data);
+    free(references.data);
+    free(namespaces.data);
+}
+END_TEST
+
+// Count of the fields per row, quoted fields may contain separators and
+// line breaks
+static void
+checkCsvFields(const Output *out, size_t fields) {
+    size_t separators = 0;
+    bool quoted = false;
+    for(size_t i = 0; i < out->length; i++) {
+        char c = out->data[i];
+        if(c == '"')
+            quoted = !quoted;
+        else if(c == ',' && !quoted)
+            separators++;
+        else if(c == '\n' && !quoted) {
+            ck_assert_uint_eq(separators + 1, fields);
+            separators = 0;
+        }
+    }
+    ck_assert(!quoted);
+}
+
+START_TEST(Dump_Csv) {
+    NodesetLoader_DumpOptions options;
+    memset(&options, 0, sizeof(NodesetLoader_DumpOptions));
+    options.format = NODESETLOADER_DUMP_CSV;
+    Output nodes, references, namespaces;
+    dump(&options, &nodes, &references, &namespaces);
+
+    const char *header = "nodeId,nodeClass,browseName,displayName,description,"
+                         "parentNodeId,parentReferenceType,typeDefinition,"
+                         "dataType,valueRank\n";
+    ck_assert(!strncmp(nodes.data, header, strlen(header)));
+    ck_assert(countLines(&nodes) > 1);
+    checkCsvFields(&nodes, 10);
+    checkCsvFields(&references, 4);
+    checkCsvFields(&namespaces, 2);
+    free(nodes.data);
+    free(references.data);
+    free(namespaces.data);
+}
+END_TEST
+
+// The chunks are formatted in parallel but written in the sorted order
+START_TEST(Dump_ThreadsSameOutput) {
+    NodesetLoader_DumpOptions options;
+    memset(&options, 0, sizeof(NodesetLoader_DumpOptions));
+    options.threads = 1;
+    Output nodes1, references1, namespaces1;
+    dump(&options, &nodes1, &references1, &namespaces1);
+
+    options.threads = 4;
+    options.bufferSize = 1000; // Smaller than a chunk
+    Output nodes4, references4, namespaces4;
+    dump(&options, &nodes4, &references4, &namespaces4);
+
+    ck_assert_uint_eq(nodes1.length, nodes4.length);
+    ck_assert(!memcmp(nodes1.data, nodes4.data, nodes1.length));
+    ck_assert_uint_eq(references1.length, references4.length);
+    ck_assert(!memcmp(references1.data, references4.data, references1.length));
+    free(nodes1.data);
+    free(references1.data);
+    free(namespaces1.data);
+    free(nodes4.data);
+    free(references4.data);
+    free(namespaces4.data);
+}
+END_TEST
+
+static Suite *
+testSuite_Dump(void) {
+    Suite *s = suite_create("dump");
+    TCase *tc = tcase_create("dump");
+    tcase_add_test(tc, Dump_Jsonl);
+    tcase_add_test(tc, Dump_Csv);
+    tcase_add_test(tc, Dump_ThreadsSameOutput);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main(int argc, char *argv[]) {
+    printf("%s", argv[0]);
+    if(argc < 2)
+        return 1;
+    nodesets = (const char *const *)&argv[1];
+    nodesetsSize = (size_t)(argc - 1);
+    Suite *s = testSuite_Dump();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,155 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "check.h"
+
+#include <NodesetLoader/backendDump.h>
+#include <NodesetLoader/backendNodesetWriter.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const *nodesets = NULL;
+static size_t nodesetsSize = 0;
+
+typedef struct {
+    char *data;
+    size_t length;
+} Output;
+
+static Output
+readAll(FILE *f) {
+    Output out = {NULL, 0};
+    long size = ftell(f);
+    ck_assert(size >= 0);
+    rewind(f);
+    out.data = (char *)calloc((size_t)size + 1, 1);
+    ck_assert(out.data != NULL);
+    out.length = fread(out.data, 1, (size_t)size, f);
+    ck_assert_uint_eq(out.length, (size_t)size);
+    fclose(f);
+    return out;
+}
+
+static Output
+rewrite(size_t filesSize, const char *const *files, const char *path) {
+    NodesetLoader_NodesetWriterOptions options;
+    memset(&options, 0, sizeof(NodesetLoader_NodesetWriterOptions));
+    FILE *f = fopen(path, "w+b");
+    ck_assert(f != NULL);
+    ck_assert(NodesetLoader_writeNodesetFiles(filesSize, files, NULL, f,
+                                              &options));
+    return readAll(f);
+}
+
+// Nodes and references as JSON Lines
+static void
+dump(size_t filesSize, const char *const *files, Output *nodes,
+     Output *references) {
+    NodesetLoader_DumpOptions options;
+    memset(&options, 0, sizeof(NodesetLoader_DumpOptions));
+    options.nodes = tmpfile();
+    options.references = tmpfile();
+    ck_assert(options.nodes && options.references);
+    ck_assert(NodesetLoader_dumpFiles(filesSize, files, NULL, &options));
+    *nodes = readAll(options.nodes);
+    *references = readAll(options.references);
+}
+
+static size_t
+countLines(const Output *out) {
+    size_t lines = 0;
+    for(size_t i = 0; i < out->length; i++)
+        lines += (out->data[i] == '\n');
+    return lines;
+}
+
+static int
+compareLines(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// The lines in lexical order, the data is split into the lines
+static char **
+sortedLines(Output *out, size_t *linesSize) {
+    *linesSize = countLines(out);
+    char **lines = (char **)calloc(*linesSize, sizeof(char *));
+    ck_assert(lines != NULL);
+    char *line = out->data;
+    for(size_t i = 0; i < *linesSize; i++) {
+        lines[i] = line;
+        line = strchr(line, '\n');
+        *line++ = 0;
+    }
+    qsort(lines, *linesSize, sizeof(char *), compareLines);
+    return lines;
+}
+
+// The rewritten nodeset has the same nodes, with the same parents, type
+// definitions and attributes
+START_TEST(Writer_SameNodes) {
+    Output written = rewrite(nodesetsSize, nodesets, "rewritten.xml");
+    free(written.data);
+
+    Output nodes, references, rewrittenNodes, rewrittenReferences;
+    dump(nodesetsSize, nodesets, &nodes, &references);
+    const char *rewritten[] = {"rewritten.xml"};
+    dump(1, rewritten, &rewrittenNodes, &rewrittenReferences);
+
+    // Duplicate directions are dropped
+    ck_assert(countLines(&rewrittenReferences) <= countLines(&references));
+    ck_assert(countLines(&rewrittenReferences) > 0);
+
+    size_t size, rewrittenSize;
+    char **lines = sortedLines(&nodes, &size);
+    char **rewrittenLines = sortedLines(&rewrittenNodes, &rewrittenSize);
+    ck_assert_uint_eq(size, rewrittenSize);
+    for(size_t i = 0; i < size; i++)
+        ck_assert_str_eq(lines[i], rewrittenLines[i]);
+    free(lines);
+    free(rewrittenLines);
+    free(nodes.data);
+    free(references.data);
+    free(rewrittenNodes.data);
+    free(rewrittenReferences.data);
+}
+END_TEST
+
+// Rewriting a rewritten nodeset does not change it anymore
+START_TEST(Writer_Canonical) {
+    Output first = rewrite(nodesetsSize, nodesets, "rewritten1.xml");
+    const char *rewritten[] = {"rewritten1.xml"};
+    Output second = rewrite(1, rewritten, "rewritten2.xml");
+    ck_assert_uint_eq(first.length, second.length);
+    ck_assert(!memcmp(first.data, second.data, first.length));
+    free(first.data);
+    free(second.data);
+}
+END_TEST
+
+static Suite *
+testSuite_NodesetWriter(void) {
+    Suite *s = suite_create("nodesetWriter");
+    TCase *tc = tcase_create("rewrite");
+    tcase_add_test(tc, Writer_SameNodes);
+    tcase_add_test(tc, Writer_Canonical);
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main(int argc, char *argv[]) {
+    printf("%s", argv[0]);
+    if(argc < 2)
+        return 1;
+    nodesets = (const char *const *)&argv[1];
+    nodesetsSize = (size_t)(argc - 1);
+    Suite *s = testSuite_NodesetWriter();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,92 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/* End-to-end import of one nodeset into a fresh server. Prints the parse,
+ * sort and insert times and the peak resident set size as one JSON line.
+ * The peak RSS is per process, so run one import per process:
+ * importBench generated100k.xml >> importBench.jsonl */
+
+#include <open62541/server.h>
+#include <open62541/server_config_default.h>
+
+#include <NodesetLoader/backendOpen62541.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+static unsigned long
+peakRssKb(void) {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return (unsigned long)(counters.PeakWorkingSetSize / 1024);
+#else
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return (unsigned long)usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    return (unsigned long)usage.ru_maxrss;
+#endif
+#endif
+}
+
+static double
+phaseMs(const NL_Stats *stats, NL_Phase first, NL_Phase last) {
+    double s = 0.0;
+    for(int p = first; p <= (int)last; p++)
+        s += stats->phases[p].wallTime;
+    return s * 1000.0;
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        printf("usage: importBench <nodeset> [threepass|fused]\n");
+        return 1;
+    }
+    NodesetLoader_Options options;
+    memset(&options, 0, sizeof(NodesetLoader_Options));
+    if(argc > 2 && !strcmp(argv[2], "fused"))
+        options.insertionMode = NODESETLOADER_INSERTION_FUSED;
+    NL_Stats stats;
+    options.stats = &stats;
+
+    UA_Server *server = UA_Server_new();
+    UA_ServerConfig_setDefault(UA_Server_getConfig(server));
+    unsigned long serverRss = peakRssKb();
+
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    bool ok = NodesetLoader_loadFileWithOptions(server, argv[1], &options);
+    double totalMs = (double)(UA_DateTime_nowMonotonic() - start) / UA_DATETIME_MSEC;
+    unsigned long rss = peakRssKb();
+    UA_Server_delete(server);
+    if(!ok) {
+        fprintf(stderr, "nodeset %s could not be loaded\n", argv[1]);
+        return 1;
+    }
+
+    size_t nodes = 0;
+    for(size_t i = 0; i < NL_NODECLASS_COUNT; i++)
+        nodes += stats.nodes[i];
+    printf("{\"file\": \"%s\", \"nodes\": %lu, \"references\": %lu, "
+           "\"parseMs\": %.2f, \"sortMs\": %.2f, \"insertMs\": %.2f, "
+           "\"totalMs\": %.2f, \"serverRssKb\": %lu, \"peakRssKb\": %lu, "
+           "\"bytesPerNode\": %.1f, \"bytesPerReference\": %.1f}\n",
+           argv[1], (unsigned long)nodes, (unsigned long)stats.references,
+           phaseMs(&stats, NL_PHASE_READ, NL_PHASE_ATTRIBUTES),
+           phaseMs(&stats, NL_PHASE_RESOLVE, NL_PHASE_SORT),
+           phaseMs(&stats, NL_PHASE_DATATYPES, NL_PHASE_FINISHNODES), totalMs,
+           serverRss, rss, stats.bytesPerNode, stats.bytesPerReference);
+    return 0;
+}
@@ -0,0 +1,301 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/* Microbenchmarks for the components of the loader. The inputs are synthetic
+ * and generated with a fixed seed, so runs are comparable between releases.
+ * Every benchmark is repeated and the fastest repetition is reported as JSON
+ * on stdout:
+ * nodesetBench [<repetitions>] > nodesetBench.json */
+
+#include "AliasList.h"
+#include "CharAllocator.h"
+#include "Nodeset.h"
+
+#include <open62541/types.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GRAPH_NODES 20000
+#define ALIASES 100
+#define ATTRIBUTE_FIELDS 5
+
+typedef struct {
+    const char *name;
+    size_t iterations;
+    UA_DateTime best;
+} BenchResult;
+
+typedef UA_DateTime (*BenchFunc)(size_t iterations);
+
+static UA_UInt32 seed = 1;
+
+static UA_UInt32
+nextRandom(void) {
+    seed = seed * 1103515245u + 12345u;
+    return (seed >> 8) & 0xffffff;
+}
+
+static void
+logNothing(void *context, enum NodesetLoader_LogLevel level,
+           const char *message, ...) {}
+
+static NodesetLoader_Logger logger = {NULL, logNothing};
+static NL_FileContext fileContext;
+
+static Nodeset *
+newNodeset(void) {
+    Nodeset *nodeset = Nodeset_new(NULL, &logger);
+    nodeset->fc = &fileContext;
+    return nodeset;
+}
+
+/* Attributes in the libxml2 SAX2 layout: localname, prefix, URI, value
+ * begin, value end */
+static void
+setAttribute(const char **attributes, size_t index, const char *name,
+             const char *value) {
+    attributes[index * ATTRIBUTE_FIELDS + 0] = name;
+    attributes[index * ATTRIBUTE_FIELDS + 1] = NULL;
+    attributes[index * ATTRIBUTE_FIELDS + 2] = NULL;
+    attributes[index * ATTRIBUTE_FIELDS + 3] = value;
+    attributes[index * ATTRIBUTE_FIELDS + 4] = value + strlen(value);
+}
+
+static UA_DateTime
+benchArenaMalloc(size_t iterations) {
+    CharArenaAllocator *arena = CharArenaAllocator_new(1024 * 1024);
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    for(size_t i = 0; i < iterations; i++)
+        CharArenaAllocator_malloc(arena, 1 + (i & 31));
+    UA_DateTime end = UA_DateTime_nowMonotonic();
+    CharArenaAllocator_delete(arena);
+    return end - start;
+}
+
+/* Text that arrives in several character callbacks */
+static UA_DateTime
+benchArenaRealloc(size_t iterations) {
+    CharArenaAllocator *arena = CharArenaAllocator_new(1024 * 1024);
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    for(size_t i = 0; i < iterations; i++) {
+        CharArenaAllocator_malloc(arena, 9);
+        for(size_t j = 0; j < 3; j++)
+            CharArenaAllocator_realloc(arena, 8);
+    }
+    UA_DateTime end = UA_DateTime_nowMonotonic();
+    CharArenaAllocator_delete(arena);
+    return end - start;
+}
+
+static UA_DateTime
+benchAliasLookup(size_t iterations) {
+    AliasList *list = AliasList_new();
+    static char names[ALIASES][16];
+    for(size_t i = 0; i < ALIASES; i++) {
+        snprintf(names[i], sizeof(names[i]), "Alias%u", (unsigned)i);
+        Alias *alias = AliasList_newAlias(list, names[i]);
+        alias->id = UA_NODEID_NUMERIC(0, (UA_UInt32)i);
+    }
+    size_t found = 0;
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    for(size_t i = 0; i < iterations; i++)
+        found += (AliasList_getNodeId(list, names[nextRandom() % ALIASES]) != NULL);
+    UA_DateTime end = UA_DateTime_nowMonotonic();
+    AliasList_delete(list);
+    return (found == iterations) ? end - start : -1;
+}
+
+/* Nodeset_newNode extracts the attributes with getAttributeValue */
+static UA_DateTime
+benchNewNode(size_t iterations) {
+    Nodeset *nodeset = newNodeset();
+    const char *attributes[5 * ATTRIBUTE_FIELDS];
+    char nodeId[32];
+    setAttribute(attributes, 0, "NodeId", nodeId);
+    setAttribute(attributes, 1, "BrowseName", "1:Temperature");
+    setAttribute(attributes, 2, "ParentNodeId", "ns=1;i=1");
+    setAttribute(attributes, 3, "DataType", "Double");
+    setAttribute(attributes, 4, "AccessLevel", "3");
+    UA_DateTime duration = 0;
+    for(size_t i = 0; i < iterations; i++) {
+        snprintf(nodeId, sizeof(nodeId), "ns=1;i=%u", (unsigned)i);
+        attributes[0 * ATTRIBUTE_FIELDS + 4] = nodeId + strlen(nodeId);
+        UA_DateTime start = UA_DateTime_nowMonotonic();
+        Nodeset_newNode(nodeset, NODECLASS_VARIABLE, 5, attributes);
+        duration += UA_DateTime_nowMonotonic() - start;
+    }
+    Nodeset_cleanup(nodeset);
+    return duration;
+}
+
+static UA_DateTime
+benchParseNodeId(size_t iterations) {
+    static const char *const ids[] = {
+        "i=85", "ns=1;i=5001", "ns=2;s=Machine.Temperature",
+        "ns=1;g=09087e75-8e5e-499b-954f-f2a9603db28a",
+        "ns=3;b=M/RbKBsRVkePCePcx24oRA=="};
+    size_t idsSize = sizeof(ids) / sizeof(ids[0]);
+    UA_StatusCode res = UA_STATUSCODE_GOOD;
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    for(size_t i = 0; i < iterations; i++) {
+        UA_NodeId id;
+        res |= UA_NodeId_parseEx(&id, UA_STRING((char *)(uintptr_t)ids[i % idsSize]),
+                                 NULL);
+        UA_NodeId_clear(&id);
+    }
+    UA_DateTime end = UA_DateTime_nowMonotonic();
+    return (res == UA_STATUSCODE_GOOD) ? end - start : -1;
+}
+
+/* A tree of objects with HasComponent children and a type definition. The
+ * nodes are created in random order so the sort has to retry. */
+static Nodeset *
+newGraph(size_t nodesSize) {
+    Nodeset *nodeset = newNodeset();
+    size_t *order = (size_t *)malloc(nodesSize * sizeof(size_t));
+    for(size_t i = 0; i < nodesSize; i++)
+        order[i] = i;
+    for(size_t i = nodesSize - 1; i > 0; i--) {
+        size_t j = nextRandom() % (i + 1);
+        size_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+    const char *attributes[2 * ATTRIBUTE_FIELDS];
+    const char *refAttributes[2 * ATTRIBUTE_FIELDS];
+    char nodeId[32];
+    char parentId[32];
+    setAttribute(attributes, 0, "NodeId", nodeId);
+    setAttribute(attributes, 1, "BrowseName", "1:Component");
+    for(size_t k = 0; k < nodesSize; k++) {
+        size_t i = order[k];
+        snprintf(nodeId, sizeof(nodeId), "ns=1;i=%u", (unsigned)(i + 1));
+        attributes[0 * ATTRIBUTE_FIELDS + 4] = nodeId + strlen(nodeId);
+        NL_Node *node = Nodeset_newNode(nodeset, NODECLASS_OBJECT, 2, attributes);
+
+        setAttribute(refAttributes, 0, "ReferenceType", "i=40");
+        setAttribute(refAttributes, 1, "IsForward", "true");
+        NL_Reference *ref = Nodeset_newReference(nodeset, node, 2, refAttributes);
+        Nodeset_newReference_finish(nodeset, ref, (char *)(uintptr_t)"i=58");
+
+        setAttribute(refAttributes, 0, "ReferenceType", "i=47");
+        setAttribute(refAttributes, 1, "IsForward", "false");
+        ref = Nodeset_newReference(nodeset, node, 2, refAttributes);
+        if(i == 0) {
+            snprintf(parentId, sizeof(parentId), "i=85");
+        } else {
+            snprintf(parentId, sizeof(parentId), "ns=1;i=%u",
+                     (unsigned)((i - 1) / 4 + 1));
+        }
+        Nodeset_newReference_finish(nodeset, ref, parentId);
+    }
+    free(order);
+    return nodeset;
+}
+
+/* Nodeset_findByNodeId for every reference target */
+static UA_DateTime
+benchResolve(size_t iterations) {
+    Nodeset *nodeset = newGraph(iterations);
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    Nodeset_resolveReferences(nodeset);
+    UA_DateTime end = UA_DateTime_nowMonotonic();
+    Nodeset_cleanup(nodeset);
+    return end - start;
+}
+
+static UA_DateTime
+benchSort(size_t iterations) {
+    Nodeset *nodeset = newGraph(iterations);
+    Nodeset_resolveReferences(nodeset);
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    bool done = Nodeset_sort(nodeset);
+    UA_DateTime end = UA_DateTime_nowMonotonic();
+    Nodeset_cleanup(nodeset);
+    return done ? end - start : -1;
+}
+
+/* Values as they are stored from the nodeset file */
+static UA_DateTime
+benchDecodeXml(size_t iterations) {
+    static const char *const values[] = {
+        "<Value><Int32>42</Int32></Value>",
+        "<Value><Double>3.1415</Double></Value>",
+        "<Value><LocalizedText><Locale>en</Locale><Text>Temperature</Text>"
+        "</LocalizedText></Value>",
+        "<Value><ListOfString><String>a</String><String>b</String>"
+        "<String>c</String></ListOfString></Value>",
+        "<Value><ExtensionObject><TypeId><Identifier>i=886</Identifier></TypeId>"
+        "<Body><Range><Low>0</Low><High>100</High></Range></Body>"
+        "</ExtensionObject></Value>"};
+    size_t valuesSize = sizeof(values) / sizeof(values[0]);
+    UA_DecodeXmlOptions opts;
+    memset(&opts, 0, sizeof(UA_DecodeXmlOptions));
+    opts.unwrapped = true;
+    UA_StatusCode res = UA_STATUSCODE_GOOD;
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    for(size_t i = 0; i < iterations; i++) {
+        UA_ByteString xml = UA_STRING((char *)(uintptr_t)values[i % valuesSize]);
+        UA_Variant v;
+        res |= UA_decodeXml(&xml, &v, &UA_TYPES[UA_TYPES_VARIANT], &opts);
+        UA_Variant_clear(&v);
+    }
+    UA_DateTime end = UA_DateTime_nowMonotonic();
+    return (res == UA_STATUSCODE_GOOD) ? end - start : -1;
+}
+
+typedef struct {
+    const char *name;
+    BenchFunc fn;
+    size_t iterations;
+} Bench;
+
+static const Bench benches[] = {
+    {"CharArenaAllocator_malloc", benchArenaMalloc, 1000000},
+    {"CharArenaAllocator_realloc", benchArenaRealloc, 250000},
+    {"AliasList_getNodeId", benchAliasLookup, 1000000},
+    {"Nodeset_newNode", benchNewNode, 100000},
+    {"UA_NodeId_parseEx", benchParseNodeId, 500000},
+    {"Nodeset_resolveReferences", benchResolve, GRAPH_NODES},
+    {"Nodeset_sort", benchSort, GRAPH_NODES},
+    {"UA_decodeXml", benchDecodeXml, 100000}};
+
+int main(int argc, char *argv[]) {
+    int repetitions = 5;
+    if(argc > 1)
+        repetitions = atoi(argv[1]);
+    if(repetitions < 1) {
+        fprintf(stderr, "usage: nodesetBench [<repetitions>]\n");
+        return 1;
+    }
+
+    size_t benchesSize = sizeof(benches) / sizeof(benches[0]);
+    printf("{\"repetitions\": %d, \"benchmarks\": [", repetitions);
+    int ret = 0;
+    for(size_t b = 0; b < benchesSize; b++) {
+        const Bench *bench = &benches[b];
+        seed = 1; // Same input in every repetition
+        UA_DateTime best = -1;
+        for(int r = 0; r < repetitions; r++) {
+            seed = 1;
+            UA_DateTime t = bench->fn(bench->iterations);
+            if(t < 0) {
+                fprintf(stderr, "%s failed\n", bench->name);
+                ret = 1;
+                break;
+            }
+            if(best < 0 || t < best)
+                best = t;
+        }
+        double ns = (double)best * 100.0; // UA_DateTime ticks are 100 ns
+        printf("%s\n  {\"name\": \"%s\", \"iterations\": %lu, \"ns\": %.0f, "
+               "\"nsPerOp\": %.2f}", (b > 0) ? "," : "", bench->name,
+               (unsigned long)bench->iterations, ns,
+               ns / (double)bench->iterations);
+    }
+    printf("\n]}\n");
+    return ret;
+}
@@ -0,0 +1,368 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/* Writes a synthetic NodeSet2 file. Every object has four variables; the
+ * objects form a tree of the given depth below the Objects folder. Variables
+ * hold Double scalars, Double arrays or custom structures, and reference
+ * random other nodes with a non-hierarchical reference type. E.g.
+ * nodesetGenerator --nodes 100000 --types 20 --order shuffled big.xml */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VARIABLES_PER_OBJECT 4
+#define INSTANCE_OFFSET 1000
+#define MAX_TYPES 300
+#define MAX_NESTING 4
+#define ARRAY_LENGTH 8
+
+typedef enum { ORDER_SORTED, ORDER_REVERSE, ORDER_SHUFFLED } Order;
+
+typedef struct {
+    size_t nodes;
+    size_t depth;
+    size_t fanout;
+    size_t types;
+    unsigned arrayPercent;
+    bool stringIds;
+    Order order;
+    unsigned seed;
+} Config;
+
+typedef struct {
+    FILE *out;
+    const Config *config;
+    size_t objects;
+    size_t branching;
+    uint64_t state;
+} Generator;
+
+static unsigned
+nextRandom(Generator *g) {
+    g->state = g->state * 6364136223846793005ull + 1442695040888963407ull;
+    return (unsigned)(g->state >> 40);
+}
+
+// Random numbers that only depend on the node, so the output does not
+// depend on the order in which the nodes are written
+static unsigned
+nodeRandom(const Generator *g, size_t node, unsigned salt) {
+    uint64_t x = (uint64_t)node * 0x9e3779b97f4a7c15ull + (uint64_t)salt * 40503u +
+                 g->config->seed;
+    x ^= x >> 31;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 29;
+    return (unsigned)(x & 0xffffff);
+}
+
+// Objects in a tree with the given branching and depth, saturated at limit
+static size_t
+treeCapacity(size_t branching, size_t depth, size_t limit) {
+    size_t capacity = 0;
+    size_t level = 1;
+    for(size_t d = 0; d < depth && capacity < limit; d++) {
+        capacity += level;
+        level *= branching;
+    }
+    return capacity;
+}
+
+static void
+writeId(const Generator *g, size_t node) {
+    if(g->config->stringIds)
+        fprintf(g->out, "ns=1;s=Node%lu", (unsigned long)node);
+    else
+        fprintf(g->out, "ns=1;i=%lu", (unsigned long)(node + INSTANCE_OFFSET));
+}
+
+/* Custom types use the NodeIds below INSTANCE_OFFSET: the reference type is
+ * i=1, type t is i=10+3t with the encodings i=11+3t (binary) and i=12+3t
+ * (xml) */
+static size_t
+typeId(size_t type) {
+    return 10 + 3 * type;
+}
+
+static bool
+hasInner(size_t type) {
+    return type % MAX_NESTING != 0;
+}
+
+static void
+writeHeader(Generator *g) {
+    fprintf(g->out,
+            "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+            "<UANodeSet xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
+            "xmlns:uax=\"http://opcfoundation.org/UA/2008/02/Types.xsd\" "
+            "xmlns=\"http://opcfoundation.org/UA/2011/03/UANodeSet.xsd\">\n"
+            "    <NamespaceUris>\n"
+            "        <Uri>http://example.org/Generated/</Uri>\n"
+            "    </NamespaceUris>\n"
+            "    <Aliases>\n"
+            "        <Alias Alias=\"Int32\">i=6</Alias>\n"
+            "        <Alias Alias=\"Double\">i=11</Alias>\n"
+            "        <Alias Alias=\"String\">i=12</Alias>\n"
+            "        <Alias Alias=\"Organizes\">i=35</Alias>\n"
+            "        <Alias Alias=\"HasEncoding\">i=38</Alias>\n"
+            "        <Alias Alias=\"HasTypeDefinition\">i=40</Alias>\n"
+            "        <Alias Alias=\"HasSubtype\">i=45</Alias>\n"
+            "        <Alias Alias=\"HasComponent\">i=47</Alias>\n"
+            "        <Alias Alias=\"RelatesTo\">ns=1;i=1</Alias>\n"
+            "    </Aliases>\n"
+            "    <UAReferenceType NodeId=\"ns=1;i=1\" BrowseName=\"1:RelatesTo\" "
+            "Symmetric=\"true\">\n"
+            "        <DisplayName>RelatesTo</DisplayName>\n"
+            "        <References>\n"
+            "            <Reference ReferenceType=\"HasSubtype\" IsForward=\"false\">"
+            "i=32</Reference>\n"
+            "        </References>\n"
+            "    </UAReferenceType>\n");
+}
+
+static void
+writeType(Generator *g, size_t type) {
+    size_t id = typeId(type);
+    fprintf(g->out,
+            "    <UADataType NodeId=\"ns=1;i=%lu\" BrowseName=\"1:Struct%lu\">\n"
+            "        <DisplayName>Struct%lu</DisplayName>\n"
+            "        <References>\n"
+            "            <Reference ReferenceType=\"HasEncoding\">ns=1;i=%lu</Reference>\n"
+            "            <Reference ReferenceType=\"HasEncoding\">ns=1;i=%lu</Reference>\n"
+            "            <Reference ReferenceType=\"HasSubtype\" IsForward=\"false\">"
+            "i=22</Reference>\n"
+            "        </References>\n"
+            "        <Definition Name=\"1:Struct%lu\">\n"
+            "            <Field DataType=\"Double\" Name=\"Value\"/>\n"
+            "            <Field DataType=\"Int32\" Name=\"Count\"/>\n"
+            "            <Field DataType=\"String\" Name=\"Label\"/>\n"
+            "            <Field DataType=\"Double\" ValueRank=\"1\" Name=\"Samples\"/>\n",
+            (unsigned long)id, (unsigned long)type, (unsigned long)type,
+            (unsigned long)(id + 1), (unsigned long)(id + 2), (unsigned long)type);
+    if(hasInner(type))
+        fprintf(g->out, "            <Field DataType=\"ns=1;i=%lu\" Name=\"Inner\"/>\n",
+                (unsigned long)typeId(type - 1));
+    fprintf(g->out, "        </Definition>\n    </UADataType>\n");
+
+    const char *encodings[2] = {"Default Binary", "Default XML"};
+    for(size_t e = 0; e < 2; e++) {
+        fprintf(g->out,
+                "    <UAObject NodeId=\"ns=1;i=%lu\" BrowseName=\"%s\">\n"
+                "        <DisplayName>%s</DisplayName>\n"
+                "        <References>\n"
+                "            <Reference ReferenceType=\"HasEncoding\" IsForward=\"false\">"
+                "ns=1;i=%lu</Reference>\n"
+                "            <Reference ReferenceType=\"HasTypeDefinition\">i=76</Reference>\n"
+                "        </References>\n"
+                "    </UAObject>\n",
+                (unsigned long)(id + 1 + e), encodings[e], encodings[e],
+                (unsigned long)id);
+    }
+}
+
+static void
+writeStructFields(Generator *g, size_t type, size_t node) {
+    fprintf(g->out, "<Value>%u.5</Value><Count>%lu</Count><Label>Label %lu</Label>"
+            "<Samples>", nodeRandom(g, node, 3) % 1000, (unsigned long)type,
+            (unsigned long)node);
+    for(size_t i = 0; i < ARRAY_LENGTH; i++)
+        fprintf(g->out, "<Double>%lu</Double>", (unsigned long)i);
+    fprintf(g->out, "</Samples>");
+    if(hasInner(type)) {
+        fprintf(g->out, "<Inner>");
+        writeStructFields(g, type - 1, node);
+        fprintf(g->out, "</Inner>");
+    }
+}
+
+static void
+writeObject(Generator *g, size_t node) {
+    size_t object = node / (VARIABLES_PER_OBJECT + 1);
+    fprintf(g->out, "    <UAObject NodeId=\"");
+    writeId(g, node);
+    fprintf(g->out, "\" BrowseName=\"1:Object%lu\">\n"
+            "        <DisplayName>Object%lu</DisplayName>\n"
+            "        <References>\n"
+            "            <Reference ReferenceType=\"HasTypeDefinition\">i=58</Reference>\n"
+            "            <Reference ReferenceType=\"Organizes\" IsForward=\"false\">",
+            (unsigned long)object, (unsigned long)object);
+    if(object == 0) {
+        fprintf(g->out, "i=85");
+    } else {
+        size_t parent = (object - 1) / g->branching;
+        writeId(g, parent * (VARIABLES_PER_OBJECT + 1));
+    }
+    fprintf(g->out, "</Reference>\n        </References>\n    </UAObject>\n");
+}
+
+static void
+writeVariable(Generator *g, size_t node) {
+    const Config *c = g->config;
+    size_t parent = node - node % (VARIABLES_PER_OBJECT + 1);
+    bool isArray = nodeRandom(g, node, 1) % 100 < c->arrayPercent;
+    bool isStruct = !isArray && c->types > 0 && nodeRandom(g, node, 2) % 4 == 0;
+    size_t type = nodeRandom(g, node, 4) % (c->types > 0 ? c->types : 1);
+
+    fprintf(g->out, "    <UAVariable NodeId=\"");
+    writeId(g, node);
+    fprintf(g->out, "\" BrowseName=\"1:Variable%lu\"", (unsigned long)node);
+    if(isStruct)
+        fprintf(g->out, " DataType=\"ns=1;i=%lu\"", (unsigned long)typeId(type));
+    else
+        fprintf(g->out, " DataType=\"Double\"");
+    if(isArray)
+        fprintf(g->out, " ValueRank=\"1\" ArrayDimensions=\"%d\"", ARRAY_LENGTH);
+    fprintf(g->out, " AccessLevel=\"3\" UserAccessLevel=\"3\">\n"
+            "        <DisplayName>Variable%lu</DisplayName>\n"
+            "        <References>\n"
+            "            <Reference ReferenceType=\"HasTypeDefinition\">i=63</Reference>\n"
+            "            <Reference ReferenceType=\"HasComponent\" IsForward=\"false\">",
+            (unsigned long)node);
+    writeId(g, parent);
+    fprintf(g->out, "</Reference>\n");
+    for(size_t i = 0; i < c->fanout; i++) {
+        fprintf(g->out, "            <Reference ReferenceType=\"RelatesTo\">");
+        writeId(g, nodeRandom(g, node, 10 + (unsigned)i) % c->nodes);
+        fprintf(g->out, "</Reference>\n");
+    }
+    fprintf(g->out, "        </References>\n        <Value>\n            ");
+    if(isArray) {
+        fprintf(g->out, "<uax:ListOfDouble>");
+        for(size_t i = 0; i < ARRAY_LENGTH; i++)
+            fprintf(g->out, "<uax:Double>%lu.25</uax:Double>", (unsigned long)i);
+        fprintf(g->out, "</uax:ListOfDouble>");
+    } else if(isStruct) {
+        fprintf(g->out, "<uax:ExtensionObject><uax:TypeId><uax:Identifier>"
+                "ns=1;i=%lu</uax:Identifier></uax:TypeId><uax:Body><Struct%lu>",
+                (unsigned long)(typeId(type) + 2), (unsigned long)type);
+        writeStructFields(g, type, node);
+        fprintf(g->out, "</Struct%lu></uax:Body></uax:ExtensionObject>",
+                (unsigned long)type);
+    } else {
+        fprintf(g->out, "<uax:Double>%u.5</uax:Double>", nodeRandom(g, node, 3) % 1000);
+    }
+    fprintf(g->out, "\n        </Value>\n    </UAVariable>\n");
+}
+
+static void
+writeInstance(Generator *g, size_t node) {
+    if(node % (VARIABLES_PER_OBJECT + 1) == 0)
+        writeObject(g, node);
+    else
+        writeVariable(g, node);
+}
+
+/* The DataTypes and the instances are written in the configured order. The
+ * reverse and shuffled orders put children before their parents. */
+static bool
+generate(Generator *g) {
+    const Config *c = g->config;
+    size_t entries = c->types + c->nodes;
+    size_t *order = (size_t *)malloc(entries * sizeof(size_t));
+    if(!order)
+        return false;
+    for(size_t i = 0; i < entries; i++)
+        order[i] = (c->order == ORDER_REVERSE) ? entries - 1 - i : i;
+    if(c->order == ORDER_SHUFFLED) {
+        for(size_t i = entries - 1; i > 0; i--) {
+            size_t j = ((size_t)nextRandom(g) << 24 | nextRandom(g)) % (i + 1);
+            size_t tmp = order[i];
+            order[i] = order[j];
+            order[j] = tmp;
+        }
+    }
+
+    writeHeader(g);
+    for(size_t i = 0; i < entries; i++) {
+        if(order[i] < c->types)
+            writeType(g, order[i]);
+        else
+            writeInstance(g, order[i] - c->types);
+    }
+    fprintf(g->out, "</UANodeSet>\n");
+    free(order);
+    return !ferror(g->out);
+}
+
+static void
+usage(void) {
+    printf("usage: nodesetGenerator [options] <output.xml>\n"
+           "  --nodes <n>       objects and variables (default 10000)\n"
+           "  --depth <n>       depth of the object tree (default 4)\n"
+           "  --fanout <n>      RelatesTo references per variable (default 2)\n"
+           "  --types <n>       custom structure DataTypes (default 10, max %d)\n"
+           "  --arrays <p>      percentage of array values (default 20)\n"
+           "  --string-ids      string instead of numeric NodeIds\n"
+           "  --order <o>       sorted, reverse or shuffled (default sorted)\n"
+           "  --seed <n>        random seed (default 1)\n", MAX_TYPES);
+}
+
+int main(int argc, char *argv[]) {
+    Config config = {10000, 4, 2, 10, 20, false, ORDER_SORTED, 1};
+    const char *path = NULL;
+    for(int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if(!strcmp(arg, "--string-ids")) {
+            config.stringIds = true;
+        } else if(!strcmp(arg, "--nodes") && hasValue) {
+            config.nodes = strtoul(argv[++i], NULL, 10);
+        } else if(!strcmp(arg, "--depth") && hasValue) {
+            config.depth = strtoul(argv[++i], NULL, 10);
+        } else if(!strcmp(arg, "--fanout") && hasValue) {
+            config.fanout = strtoul(argv[++i], NULL, 10);
+        } else if(!strcmp(arg, "--types") && hasValue) {
+            config.types = strtoul(argv[++i], NULL, 10);
+        } else if(!strcmp(arg, "--arrays") && hasValue) {
+            config.arrayPercent = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if(!strcmp(arg, "--seed") && hasValue) {
+            config.seed = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if(!strcmp(arg, "--order") && hasValue) {
+            const char *order = argv[++i];
+            if(!strcmp(order, "sorted")) {
+                config.order = ORDER_SORTED;
+            } else if(!strcmp(order, "reverse")) {
+                config.order = ORDER_REVERSE;
+            } else if(!strcmp(order, "shuffled")) {
+                config.order = ORDER_SHUFFLED;
+            } else {
+                usage();
+                return 1;
+            }
+        } else if(arg[0] != '-' && !path) {
+            path = arg;
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if(!path || config.nodes == 0 || config.depth == 0 || config.types > MAX_TYPES) {
+        usage();
+        return 1;
+    }
+
+    Generator g;
+    memset(&g, 0, sizeof(Generator));
+    g.config = &config;
+    g.state = config.seed;
+    g.objects = (config.nodes + VARIABLES_PER_OBJECT) / (VARIABLES_PER_OBJECT + 1);
+    g.branching = 1;
+    while(treeCapacity(g.branching, config.depth, g.objects) < g.objects)
+        g.branching++;
+
+    g.out = fopen(path, "w");
+    if(!g.out) {
+        printf("cannot open %s\n", path);
+        return 1;
+    }
+    bool ok = generate(&g);
+    ok = (fclose(g.out) == 0) && ok;
+    if(!ok) {
+        printf("writing %s failed\n", path);
+        return 1;
+    }
+    return 0;
+}
@@ -15,7 +15,8 @@ enum NodesetLoader_LogLevel
 {
     NODESETLOADER_LOGLEVEL_DEBUG,
     NODESETLOADER_LOGLEVEL_WARNING,
-    NODESETLOADER_LOGLEVEL_ERROR
+    NODESETLOADER_LOGLEVEL_ERROR,
+    NODESETLOADER_LOGLEVEL_INFO
 };
 
 typedef void (*NodesetLoader_Logger_log)(void *context,
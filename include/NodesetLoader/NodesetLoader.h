@@ -37,7 +37,7 @@ typedef enum {
     NODECLASS_VIEW = 7
 } NL_NodeClass;
 
-LOADER_EXPORT extern const char *NL_NODECLASS_NAME[NL_NODECLASS_COUNT];
+LOADER_EXPORT extern const char *const NL_NODECLASS_NAME[NL_NODECLASS_COUNT];
 
 struct NL_Node;
 typedef struct NL_Node NL_Node;
@@ -48,6 +48,7 @@ typedef struct NL_Reference {
     UA_NodeId refType;
     UA_NodeId target;
     NL_Node *targetPtr;
+    bool isImplied; /* already created with the node or another reference */
     struct NL_Reference *next;
 } NL_Reference;
 
@@ -59,6 +60,8 @@ typedef struct NL_Reference {
     UA_LocalizedText description;                                       \
     char *writeMask;                                                    \
     NL_Reference *refs;                                                 \
+    NL_Reference *parentRef; /* inverse HasChild reference, set by sort */ \
+    size_t sortIndex; /* position in the sorted order, set by sort */   \
     void *extension;                                                    \
     bool isDone; /* the node was successfully added in the backend */
 
@@ -120,6 +123,12 @@ typedef struct NL_DataTypeNode {
     NL_NODE_ATTRIBUTES
     NL_DataTypeDefinition *definition;
     char *isAbstract;
+    /* Targets of the HasEncoding references, classified by the browse name
+     * of the encoding node. Set by sort, null if there is no such encoding.
+     * The NodeIds are shallow copies of the reference targets. */
+    UA_NodeId binaryEncodingId;
+    UA_NodeId xmlEncodingId;
+    UA_NodeId jsonEncodingId;
 } NL_DataTypeNode;
 
 typedef struct NL_MethodNode {
@@ -151,6 +160,10 @@ typedef struct NL_FileContext {
     NL_addNamespaceCallback addNamespace;
     NodesetLoader_ExtensionInterface *extensionHandling;
     UA_NamespaceMapping *nsMapping;
+    /* Do not call the extensionHandling while parsing. Instead, the extension
+     * of a node is a UA_String* with the raw <Extensions> xml, owned by the
+     * application. See NodesetLoader_parseExtensions. */
+    bool captureRawExtensions;
 } NL_FileContext;
 
 struct NodesetLoader;
@@ -163,12 +176,53 @@ LOADER_EXPORT bool
 NodesetLoader_importFile(NodesetLoader *loader,
                          const NL_FileContext *fileContext);
 
+/* Resumable import of a file, e.g. for an event loop without threads.
+ * importBegin reads the file, every importStep parses the next part of it
+ * and importEnd finishes the import with the result of importFile. The
+ * fileContext must stay valid until importEnd. One file is imported at a
+ * time; importEnd before the file is parsed aborts it and returns false.
+ * The nodes of a file that failed or was aborted are not removed, so the
+ * loader cannot import or sort anymore afterwards, only be deleted. */
+typedef enum {
+    NL_IMPORTSTEP_ERROR,    /* parse error or canceled, call importEnd */
+    NL_IMPORTSTEP_CONTINUE, /* call importStep again */
+    NL_IMPORTSTEP_DONE      /* the file is parsed, call importEnd */
+} NL_ImportStepResult;
+
+LOADER_EXPORT bool
+NodesetLoader_importBegin(NodesetLoader *loader,
+                          const NL_FileContext *fileContext);
+
+/* Parses up to maxBytes of the file, or until at least maxNodes more nodes
+ * were created (checked every few kilobytes). 0 is no limit. */
+LOADER_EXPORT NL_ImportStepResult
+NodesetLoader_importStep(NodesetLoader *loader, size_t maxBytes,
+                         size_t maxNodes);
+
+LOADER_EXPORT bool
+NodesetLoader_importEnd(NodesetLoader *loader);
+
 LOADER_EXPORT void
 NodesetLoader_delete(NodesetLoader *loader);
 
+/* Parse raw <Extensions> xml that was captured with captureRawExtensions.
+ * The callbacks are called as during the import. Returns the data of the
+ * last <Extension>, NULL if there is none. */
+LOADER_EXPORT void *
+NodesetLoader_parseExtensions(const UA_String *xml,
+                              const NodesetLoader_ExtensionInterface *extIf);
+
 LOADER_EXPORT bool
 NodesetLoader_sort(NodesetLoader *loader);
 
+/* Register a ReferenceType that points from a node to its parent, i.e. a
+ * subtype of HasChild. HasChild, its well-known ns0 subtypes and all subtypes
+ * defined in the imported files are detected during sort. Use this for
+ * subtypes that only exist in the target address space. */
+LOADER_EXPORT bool
+NodesetLoader_addParentReferenceType(NodesetLoader *loader,
+                                     const UA_NodeId *refType);
+
 typedef bool (*NodesetLoader_forEachNode_Func)(void *context, NL_Node *node);
 
 // Returns false in case of an error
@@ -176,6 +230,190 @@ LOADER_EXPORT bool
 NodesetLoader_forEachNode(NodesetLoader *loader, void *context,
                           NodesetLoader_forEachNode_Func fn);
 
+// Iterates all parsed nodes in no particular order, also those that were not
+// sorted because the import or the sort failed. E.g. to free the raw
+// extensions. Returns false in case of an error
+LOADER_EXPORT bool
+NodesetLoader_forEachParsedNode(NodesetLoader *loader, void *context,
+                                NodesetLoader_forEachNode_Func fn);
+
+typedef bool (*NodesetLoader_forEachWindow_Func)(void *context,
+                                                NL_Node **nodes,
+                                                size_t nodesSize);
+
+// Iterates the sorted nodes in consecutive windows. No reference (in either
+// direction) connects a node of a window with a node of a later window,
+// except references to an earlier type and implied references from a type.
+// So a window can be completely added to the backend before the next one.
+// Returns false in case of an error
+LOADER_EXPORT bool
+NodesetLoader_forEachWindow(NodesetLoader *loader, void *context,
+                            NodesetLoader_forEachWindow_Func fn);
+
+typedef bool (*NodesetLoader_forEachAlias_Func)(void *context,
+                                               const char *alias,
+                                               const UA_NodeId *id);
+
+// Iterates the aliases of all imported files in the order of the files. An
+// alias name can appear more than once, the first one is used for the lookup.
+// Returns false in case of an error
+LOADER_EXPORT bool
+NodesetLoader_forEachAlias(NodesetLoader *loader, void *context,
+                           NodesetLoader_forEachAlias_Func fn);
+
+/* Phases of an import that are timed in NL_Stats. The backend times its
+ * phases with NodesetLoader_startPhase / NodesetLoader_stopPhase. */
+#define NL_PHASE_COUNT 10
+typedef enum {
+    NL_PHASE_READ = 0,         /* read the files into memory */
+    NL_PHASE_PARSE = 1,        /* xml parsing without the attribute extraction */
+    NL_PHASE_ATTRIBUTES = 2,   /* create nodes, references and aliases */
+    NL_PHASE_RESOLVE = 3,      /* resolve the reference targets */
+    NL_PHASE_SORT = 4,
+    NL_PHASE_DATATYPES = 5,    /* backend: DataType import */
+    NL_PHASE_VALUES = 6,       /* backend: value decoding */
+    NL_PHASE_ADDNODES = 7,     /* backend: add the nodes */
+    NL_PHASE_ADDREFS = 8,      /* backend: add the references */
+    NL_PHASE_FINISHNODES = 9   /* backend: finish the nodes */
+} NL_Phase;
+
+LOADER_EXPORT extern const char *const NL_PHASE_NAME[NL_PHASE_COUNT];
+
+typedef struct {
+    double wallTime; /* seconds */
+    double cpuTime;  /* seconds of process cpu time */
+} NL_PhaseTime;
+
+/* Categories of the heap memory that is accounted during an import */
+#define NL_MEMORY_COUNT 8
+typedef enum {
+    NL_MEMORY_FILEBUFFER = 0,  /* the nodeset file read into memory */
+    NL_MEMORY_ARENA = 1,       /* regions of the string arena */
+    NL_MEMORY_NODES = 2,       /* node structs, see NL_Stats.nodeBytes */
+    NL_MEMORY_REFERENCES = 3,
+    NL_MEMORY_DATATYPES = 4,   /* DataType definitions and fields */
+    NL_MEMORY_VALUES = 5,      /* copies of the Variable values */
+    NL_MEMORY_DECODE = 6,      /* backend: value decoding temporaries */
+    NL_MEMORY_EXTENSIONS = 7   /* raw <Extensions> xml, see NL_FileContext */
+} NL_MemoryCategory;
+
+LOADER_EXPORT extern const char *const NL_MEMORY_NAME[NL_MEMORY_COUNT];
+
+typedef struct {
+    size_t live; /* bytes */
+    size_t peak; /* bytes */
+} NL_MemoryUsage;
+
+typedef struct {
+    /* accumulated over all files, 0 without NodesetLoader_enableTiming */
+    NL_PhaseTime phases[NL_PHASE_COUNT];
+    size_t nodes[NL_NODECLASS_COUNT];
+    size_t references;
+    size_t aliases;
+    size_t charArenaBytes; /* strings from the xml attributes and text */
+    NL_MemoryUsage memory[NL_MEMORY_COUNT];
+    size_t nodeBytes[NL_NODECLASS_COUNT]; /* node structs per class */
+    /* Live bytes of nodes, arena, DataTypes and values per node, and of
+     * the references per reference */
+    double bytesPerNode;
+    double bytesPerReference;
+    /* Peak resident set size of the process at the last end of each phase.
+     * 0 if the phase did not run or the platform does not report it. */
+    size_t peakRssKb[NL_PHASE_COUNT];
+} NL_Stats;
+
+LOADER_EXPORT void
+NodesetLoader_getStats(const NodesetLoader *loader, NL_Stats *stats);
+
+/* Take the phase times and the peak rss of NL_Stats. Without it (or a trace)
+ * they stay 0 and the parser callbacks read no clocks. The counts and the
+ * memory are always accounted. */
+LOADER_EXPORT void
+NodesetLoader_enableTiming(NodesetLoader *loader);
+
+LOADER_EXPORT bool
+NodesetLoader_timesPhases(const NodesetLoader *loader);
+
+/* Time a phase. The time between start and stop is added to the phase.
+ * Nothing is timed unless the timing is enabled. */
+LOADER_EXPORT void
+NodesetLoader_startPhase(NodesetLoader *loader, NL_Phase phase);
+
+LOADER_EXPORT void
+NodesetLoader_stopPhase(NodesetLoader *loader, NL_Phase phase);
+
+/* Add a time that the backend took itself, e.g. the sum over the windows of
+ * the fused insertion. Records the peak rss but no trace event. */
+LOADER_EXPORT void
+NodesetLoader_addPhaseTime(NodesetLoader *loader, NL_Phase phase,
+                           const NL_PhaseTime *time);
+
+/* Account heap memory of the backend, e.g. decoding temporaries */
+LOADER_EXPORT void
+NodesetLoader_trackAlloc(NodesetLoader *loader, NL_MemoryCategory category,
+                         size_t bytes);
+
+LOADER_EXPORT void
+NodesetLoader_trackFree(NodesetLoader *loader, NL_MemoryCategory category,
+                        size_t bytes);
+
+/* Record begin/end events for the phases, the files and the sort passes.
+ * The backend steps of nodes that take at least slowNodeThreshold are
+ * recorded as well (0 records no nodes). Without tracing started, no events
+ * are recorded and no extra clocks are read. */
+LOADER_EXPORT bool
+NodesetLoader_startTrace(NodesetLoader *loader, UA_DateTime slowNodeThreshold);
+
+/* True if the backend shall time the nodes for NodesetLoader_traceNode */
+LOADER_EXPORT bool
+NodesetLoader_tracesNodes(const NodesetLoader *loader);
+
+/* Record the node if its step that started at begin took long enough */
+LOADER_EXPORT void
+NodesetLoader_traceNode(NodesetLoader *loader, const NL_Node *node,
+                        NL_Phase phase, UA_DateTime begin);
+
+/* Write the events as Chrome trace JSON, e.g. to load them into Perfetto.
+ * The timestamps are in microseconds of UA_DateTime_nowMonotonic. */
+LOADER_EXPORT bool
+NodesetLoader_writeTrace(const NodesetLoader *loader, const char *path);
+
+/* Progress of an import. The counters accumulate over all files of the
+ * loader. bytesTotal grows with every file that is read, nodesCreated is the
+ * total for sorting and insertion once the files are parsed. */
+typedef struct {
+    size_t bytesParsed;
+    size_t bytesTotal;
+    size_t nodesCreated;
+    size_t nodesSorted;
+    size_t nodesInserted; /* counted by the backend */
+} NL_Progress;
+
+/* Called every few hundred nodes of the parser, the sort and the backend and
+ * at the end of the parsing and the sort. Return false to cancel the import:
+ * the running stage stops at the next check and the following steps of the
+ * loader fail. The loader memory is released with NodesetLoader_delete as
+ * usual. */
+typedef bool (*NL_ProgressCallback)(void *context, const NL_Progress *progress);
+
+LOADER_EXPORT void
+NodesetLoader_setProgressCallback(NodesetLoader *loader,
+                                  NL_ProgressCallback callback, void *context);
+
+/* Count a backend step of a node for the progress. nodesInserted are the
+ * nodes that are complete with the step. Returns false if the import is
+ * canceled. */
+LOADER_EXPORT bool
+NodesetLoader_reportStep(NodesetLoader *loader, size_t nodesInserted);
+
+/* Report the progress now, e.g. at the end of the insertion. Returns false if
+ * the import is canceled. */
+LOADER_EXPORT bool
+NodesetLoader_reportProgress(NodesetLoader *loader);
+
+LOADER_EXPORT bool
+NodesetLoader_isCanceled(const NodesetLoader *loader);
+
 #ifdef __cplusplus
 }
 #endif
@@ -57,6 +57,17 @@ const UA_NodeId *
     return NULL;
 }
 
+bool AliasList_forEach(const AliasList *list, void *context,
+                       NodesetLoader_forEachAlias_Func fn)
+{
+    for(size_t i = 0; i < list->size; i++)
+    {
+        if(!fn(context, list->data[i].name, &list->data[i].id))
+            return false;
+    }
+    return true;
+}
+
 void AliasList_delete(AliasList *list)
 {
     free(list->data);
@@ -19,6 +19,8 @@ struct Alias {
 AliasList *AliasList_new(void);
 Alias *AliasList_newAlias(AliasList *list, char *name);
 const UA_NodeId *AliasList_getNodeId(const AliasList *list, const char *alias);
+bool AliasList_forEach(const AliasList *list, void *context,
+                       NodesetLoader_forEachAlias_Func fn);
 void AliasList_delete(AliasList *list);
 
 #endif
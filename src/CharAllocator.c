@@ -25,6 +25,8 @@ struct CharArenaAllocator
 {
     size_t initialSize;
     struct Region *current;
+    size_t allocatedBytes;
+    size_t regionBytes;
 };
 
 static struct Region *Region_new(size_t capacity)
@@ -55,6 +57,10 @@ CharArenaAllocator *CharArenaAllocator_new(size_t initialSize)
     }
     arena->initialSize = initialSize;
     arena->current = Region_new(arena->initialSize);
+    if(arena->current)
+    {
+        arena->regionBytes = arena->current->capacity;
+    }
     return arena;
 }
 
@@ -79,10 +85,12 @@ char *CharArenaAllocator_malloc(CharArenaAllocator *arena, size_t size)
         }
         newRegion->next = arena->current;
         arena->current = newRegion;
+        arena->regionBytes += newRegion->capacity;
     }
     arena->current->userPtr = arena->current->mem + arena->current->size;
     arena->current->size += size;
     arena->current->userSize = size;
+    arena->allocatedBytes += size;
     return arena->current->userPtr;
 }
 
@@ -103,9 +111,11 @@ char *CharArenaAllocator_realloc(CharArenaAllocator *arena, size_t size)
         newRegion->next = arena->current;
         newRegion->size = newRegion->userSize;
         arena->current = newRegion;
+        arena->regionBytes += newRegion->capacity;
     }
     arena->current->userSize += size;
     arena->current->size += size;
+    arena->allocatedBytes += size;
     return arena->current->userPtr;
 }
 
@@ -121,3 +131,13 @@ void CharArenaAllocator_delete(CharArenaAllocator *arena)
     }
     free(arena);
 }
+
+size_t CharArenaAllocator_allocatedBytes(const CharArenaAllocator *arena)
+{
+    return arena->allocatedBytes;
+}
+
+size_t CharArenaAllocator_regionBytes(const struct CharArenaAllocator *arena)
+{
+    return arena->regionBytes;
+}
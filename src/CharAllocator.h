@@ -16,5 +16,9 @@ CharArenaAllocator *CharArenaAllocator_new(size_t initialSize);
 char *CharArenaAllocator_malloc(struct CharArenaAllocator *arena, size_t size);
 char *CharArenaAllocator_realloc(struct CharArenaAllocator *arena, size_t size);
 void CharArenaAllocator_delete(struct CharArenaAllocator *arena);
+/* Bytes handed out by malloc and realloc */
+size_t CharArenaAllocator_allocatedBytes(const struct CharArenaAllocator *arena);
+/* Bytes of the allocated regions */
+size_t CharArenaAllocator_regionBytes(const struct CharArenaAllocator *arena);
 
 #endif
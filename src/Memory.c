@@ -0,0 +1,74 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "Memory.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+void
+MemoryAccount_alloc(MemoryAccount *account, NL_MemoryCategory category,
+                    size_t bytes) {
+    if(!account)
+        return;
+    NL_MemoryUsage *u = &account->usage[category];
+    u->live += bytes;
+    if(u->live > u->peak)
+        u->peak = u->live;
+}
+
+void
+MemoryAccount_free(MemoryAccount *account, NL_MemoryCategory category,
+                   size_t bytes) {
+    if(!account)
+        return;
+    NL_MemoryUsage *u = &account->usage[category];
+    u->live = (bytes < u->live) ? u->live - bytes : 0;
+}
+
+void
+MemoryAccount_set(MemoryAccount *account, NL_MemoryCategory category,
+                  size_t bytes) {
+    if(!account)
+        return;
+    NL_MemoryUsage *u = &account->usage[category];
+    u->live = bytes;
+    if(u->live > u->peak)
+        u->peak = u->live;
+}
+
+void
+MemoryAccount_allocNode(MemoryAccount *account, NL_NodeClass nodeClass,
+                        size_t bytes) {
+    if(!account)
+        return;
+    account->nodeBytes[nodeClass] += bytes;
+    MemoryAccount_alloc(account, NL_MEMORY_NODES, bytes);
+}
+
+size_t
+Memory_peakRssKb(void) {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return (size_t)(counters.PeakWorkingSetSize / 1024);
+#elif defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return (size_t)usage.ru_maxrss / 1024; // Bytes on macOS
+#else
+    return (size_t)usage.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
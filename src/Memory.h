@@ -0,0 +1,33 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include "NodesetLoader/NodesetLoader.h"
+
+/* Live and peak bytes per category. The functions accept a NULL account, so
+ * components can be used without accounting. Memory that is only released
+ * with the loader is not subtracted. */
+
+typedef struct {
+    NL_MemoryUsage usage[NL_MEMORY_COUNT];
+    size_t nodeBytes[NL_NODECLASS_COUNT];
+} MemoryAccount;
+
+void MemoryAccount_alloc(MemoryAccount *account, NL_MemoryCategory category,
+                         size_t bytes);
+void MemoryAccount_free(MemoryAccount *account, NL_MemoryCategory category,
+                        size_t bytes);
+/* Sets the live bytes of a category that is measured instead of tracked */
+void MemoryAccount_set(MemoryAccount *account, NL_MemoryCategory category,
+                       size_t bytes);
+void MemoryAccount_allocNode(MemoryAccount *account, NL_NodeClass nodeClass,
+                             size_t bytes);
+
+/* Peak resident set size of the process, 0 if unknown */
+size_t Memory_peakRssKb(void);
+
+#endif
@@ -45,39 +45,36 @@ NodeContainer_clear(NodeContainer *container) {
     memset(container, 0, sizeof(NodeContainer));
 }
 
-NL_Node *
-Node_new(NL_NodeClass nodeClass) {
-    void *node = NULL;
+size_t
+Node_size(NL_NodeClass nodeClass) {
     switch (nodeClass)
     {
     case NODECLASS_VARIABLE:
-        node = calloc(1, sizeof(NL_VariableNode));
-        break;
+        return sizeof(NL_VariableNode);
     case NODECLASS_OBJECT:
-        node = calloc(1, sizeof(NL_ObjectNode));
-        break;
+        return sizeof(NL_ObjectNode);
     case NODECLASS_OBJECTTYPE:
-        node = calloc(1, sizeof(NL_ObjectTypeNode));
-        break;
+        return sizeof(NL_ObjectTypeNode);
     case NODECLASS_REFERENCETYPE:
-        node = calloc(1, sizeof(NL_ReferenceTypeNode));
-        break;
+        return sizeof(NL_ReferenceTypeNode);
     case NODECLASS_VARIABLETYPE:
-        node = calloc(1, sizeof(NL_VariableTypeNode));
-        break;
+        return sizeof(NL_VariableTypeNode);
     case NODECLASS_DATATYPE:
-        node = calloc(1, sizeof(NL_DataTypeNode));
-        break;
+        return sizeof(NL_DataTypeNode);
     case NODECLASS_METHOD:
-        node = calloc(1, sizeof(NL_MethodNode));
-        break;
+        return sizeof(NL_MethodNode);
     case NODECLASS_VIEW:
-        node = calloc(1, sizeof(NL_ViewNode));
-        break;
+        return sizeof(NL_ViewNode);
     }
-    if(!node)
+    return 0;
+}
+
+NL_Node *
+Node_new(NL_NodeClass nodeClass) {
+    size_t size = Node_size(nodeClass);
+    if(size == 0)
         return NULL;
-    return (NL_Node*)node;
+    return (NL_Node *)calloc(1, size);
 }
 
 static void
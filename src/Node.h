@@ -21,6 +21,8 @@ void NodeContainer_clear(NodeContainer *container);
 bool NodeContainer_add(NodeContainer *container, NL_Node *node);
 void NodeContainer_remove(NodeContainer *container, size_t index);
 
+/* Size of the node struct of the class */
+size_t Node_size(NL_NodeClass nodeClass);
 NL_Node *Node_new(NL_NodeClass nodeClass);
 void Node_delete(NL_Node *node);
 
@@ -0,0 +1,101 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "NodeIdMap.h"
+
+static size_t
+roundUpPow2(size_t n) {
+    size_t c = 16;
+    while(c < n)
+        c *= 2;
+    return c;
+}
+
+static NodeIdMapEntry *
+findEntry(NodeIdMapEntry *entries, size_t capacity,
+          const UA_NodeId *key, UA_UInt32 hash) {
+    size_t mask = capacity - 1;
+    for(size_t i = hash & mask;; i = (i + 1) & mask) {
+        NodeIdMapEntry *e = &entries[i];
+        if(!e->used)
+            return e;
+        if(e->hash == hash && UA_NodeId_equal(&e->key, key))
+            return e;
+    }
+}
+
+bool
+NodeIdMap_init(NodeIdMap *map, size_t initialSize) {
+    memset(map, 0, sizeof(NodeIdMap));
+    size_t capacity = roundUpPow2(initialSize * 2);
+    map->entries = (NodeIdMapEntry *)calloc(capacity, sizeof(NodeIdMapEntry));
+    if(!map->entries)
+        return false;
+    map->capacity = capacity;
+    return true;
+}
+
+void
+NodeIdMap_clear(NodeIdMap *map) {
+    for(size_t i = 0; i < map->capacity; i++) {
+        if(map->entries[i].used)
+            UA_NodeId_clear(&map->entries[i].key);
+    }
+    free(map->entries);
+    memset(map, 0, sizeof(NodeIdMap));
+}
+
+static bool
+grow(NodeIdMap *map) {
+    size_t capacity = (map->capacity > 0) ? map->capacity * 2 : 16;
+    NodeIdMapEntry *entries =
+        (NodeIdMapEntry *)calloc(capacity, sizeof(NodeIdMapEntry));
+    if(!entries)
+        return false;
+    for(size_t i = 0; i < map->capacity; i++) {
+        NodeIdMapEntry *old = &map->entries[i];
+        if(!old->used)
+            continue;
+        *findEntry(entries, capacity, &old->key, old->hash) = *old;
+    }
+    free(map->entries);
+    map->entries = entries;
+    map->capacity = capacity;
+    return true;
+}
+
+bool
+NodeIdMap_insert(NodeIdMap *map, const UA_NodeId *key, void *value) {
+    /* Keep the load factor below 1/2 */
+    if((map->size + 1) * 2 > map->capacity && !grow(map))
+        return false;
+    UA_UInt32 hash = UA_NodeId_hash(key);
+    NodeIdMapEntry *e = findEntry(map->entries, map->capacity, key, hash);
+    if(!e->used) {
+        if(UA_NodeId_copy(key, &e->key) != UA_STATUSCODE_GOOD)
+            return false;
+        e->hash = hash;
+        e->used = true;
+        map->size++;
+    }
+    e->value = value;
+    return true;
+}
+
+bool
+NodeIdMap_contains(const NodeIdMap *map, const UA_NodeId *key) {
+    if(map->size == 0)
+        return false;
+    return findEntry(map->entries, map->capacity, key,
+                     UA_NodeId_hash(key))->used;
+}
+
+void *
+NodeIdMap_get(const NodeIdMap *map, const UA_NodeId *key) {
+    if(map->size == 0)
+        return NULL;
+    return findEntry(map->entries, map->capacity, key,
+                     UA_NodeId_hash(key))->value;
+}
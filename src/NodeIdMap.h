@@ -0,0 +1,35 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef NODEIDMAP_H
+#define NODEIDMAP_H
+
+#include "NodesetLoader/NodesetLoader.h"
+
+/* Open-addressing hash map from UA_NodeId to an opaque pointer. The keys are
+ * copied into the map. Also used as a plain set (with NULL values). */
+
+typedef struct {
+    UA_NodeId key;
+    void *value;
+    UA_UInt32 hash;
+    bool used;
+} NodeIdMapEntry;
+
+typedef struct {
+    NodeIdMapEntry *entries;
+    size_t size;
+    size_t capacity; /* always a power of two */
+} NodeIdMap;
+
+bool NodeIdMap_init(NodeIdMap *map, size_t initialSize);
+void NodeIdMap_clear(NodeIdMap *map);
+/* Inserts or replaces the value for the key */
+bool NodeIdMap_insert(NodeIdMap *map, const UA_NodeId *key, void *value);
+bool NodeIdMap_contains(const NodeIdMap *map, const UA_NodeId *key);
+/* Returns NULL if the key is not contained */
+void *NodeIdMap_get(const NodeIdMap *map, const UA_NodeId *key);
+
+#endif
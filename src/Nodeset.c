@@ -85,6 +85,18 @@ alias2Id(const Nodeset *nodeset, char *name) {
     return *alias;
 }
 
+// HasChild and its subtypes defined in ns0. Subtypes from the imported files
+// are added while sorting the ReferenceTypes.
+static const UA_UInt32 knownParentRefTypes[] = {
+    UA_NS0ID_HASCHILD,
+    UA_NS0ID_AGGREGATES,
+    UA_NS0ID_HASSUBTYPE,
+    UA_NS0ID_HASPROPERTY,
+    UA_NS0ID_HASCOMPONENT,
+    UA_NS0ID_HASORDEREDCOMPONENT,
+    UA_NS0ID_HASHISTORICALCONFIGURATION
+};
+
 Nodeset *
 Nodeset_new(NL_addNamespaceCallback nsCallback,
             NodesetLoader_Logger *logger) {
@@ -104,10 +116,20 @@ Nodeset_new(NL_addNamespaceCallback nsCallback,
     NodeContainer_init(&nodeset->nodes[NODECLASS_VIEW], 10);
     NodeContainer_init(&nodeset->allNodes, 10000);
     NodeContainer_init(&nodeset->sortedNodes, 10000);
+    NodeIdMap_init(&nodeset->parentRefTypes, 32);
+    for(size_t i = 0; i < sizeof(knownParentRefTypes) / sizeof(UA_UInt32); i++) {
+        UA_NodeId refType = UA_NODEID_NUMERIC(0, knownParentRefTypes[i]);
+        NodeIdMap_insert(&nodeset->parentRefTypes, &refType, NULL);
+    }
     nodeset->logger = logger;
     return nodeset;
 }
 
+bool
+Nodeset_addParentReferenceType(Nodeset *nodeset, const UA_NodeId *refType) {
+    return NodeIdMap_insert(&nodeset->parentRefTypes, refType, NULL);
+}
+
 static int
 compareNodeByNodeId(const void *a, const void *b) {
     const NL_Node *na = *(const NL_Node * const *)a;
@@ -134,7 +156,10 @@ Nodeset_findByNodeId(Nodeset *nodeset, const UA_NodeId *key) {
     return NULL;
 }
 
-static UA_NodeId hasTypeDef = {0, UA_NODEIDTYPE_NUMERIC, {40}};
+#define SORTINDEX_NONE ((size_t)-1)
+
+static const UA_NodeId hasTypeDef = {0, UA_NODEIDTYPE_NUMERIC, {UA_NS0ID_HASTYPEDEFINITION}};
+static const UA_NodeId hasSubtype = {0, UA_NODEIDTYPE_NUMERIC, {UA_NS0ID_HASSUBTYPE}};
 
 static bool
 nodeRefsReady(NL_Node *node) {
@@ -154,11 +179,14 @@ nodeRefsReady(NL_Node *node) {
     return true;
 }
 
-// Returns true if all nodes could be added
+// Returns true if all nodes could be added. Stops when the import is canceled.
 static bool
 Nodeset_sortNodeClass(Nodeset *nodeset, NL_NodeClass nodeClass) {
     NodeContainer *nc = &nodeset->nodes[nodeClass];
     size_t oldSize;
+    UA_DateTime begin = 0;
+    if(nodeset->trace)
+        begin = UA_DateTime_nowMonotonic();
 
     // Check all nodes if they can be inserted now.
     // Retry until all nodes have been added or a fixpoint was reached.
@@ -168,19 +196,90 @@ Nodeset_sortNodeClass(Nodeset *nodeset, NL_NodeClass nodeClass) {
         NL_Node *node = nc->nodes[i];
         if(!nodeRefsReady(node))
             continue;
+        node->sortIndex = nodeset->sortedNodes.size;
         NodeContainer_add(&nodeset->sortedNodes, node);
         NodeContainer_remove(nc, i);
         i--;
         node->isDone = true;
+        if(nodeset->progress) {
+            nodeset->progress->progress.nodesSorted++;
+            if(!Progress_step(nodeset->progress))
+                break;
+        }
     }
 
-    if(oldSize != nc->size)
+    if(oldSize != nc->size && !Progress_canceled(nodeset->progress))
         goto retry;
 
-    return (nc->size == 0);
+    if(nodeset->trace)
+        Trace_add(nodeset->trace, "sortNodeClass", NL_NODECLASS_NAME[nodeClass],
+                  begin, UA_DateTime_nowMonotonic());
+    return (nc->size == 0 && !Progress_canceled(nodeset->progress));
 }
 
-bool Nodeset_sort(Nodeset *nodeset) {
+// Add the ReferenceTypes from sortedNodes[begin, end) that are subtypes of
+// HasChild to the parentRefTypes. Retry until a fixpoint is reached, as the
+// HasSubtype reference can be defined in either direction.
+static void
+Nodeset_collectParentRefTypes(Nodeset *nodeset, size_t begin, size_t end) {
+    size_t oldSize;
+    do {
+        oldSize = nodeset->parentRefTypes.size;
+        for(size_t i = begin; i < end; i++) {
+            NL_Node *node = nodeset->sortedNodes.nodes[i];
+            for(NL_Reference *ref = node->refs; ref != NULL; ref = ref->next) {
+                if(!UA_NodeId_equal(&hasSubtype, &ref->refType))
+                    continue;
+                if(ref->isForward) {
+                    if(NodeIdMap_contains(&nodeset->parentRefTypes, &node->id))
+                        NodeIdMap_insert(&nodeset->parentRefTypes, &ref->target, NULL);
+                } else {
+                    if(NodeIdMap_contains(&nodeset->parentRefTypes, &ref->target))
+                        NodeIdMap_insert(&nodeset->parentRefTypes, &node->id, NULL);
+                }
+            }
+        }
+    } while(oldSize != nodeset->parentRefTypes.size);
+}
+
+// The first inverse reference with a subtype of HasChild points to the parent
+static NL_Reference *
+Nodeset_findParentRef(const Nodeset *nodeset, const NL_Node *node) {
+    for(NL_Reference *ref = node->refs; ref != NULL; ref = ref->next) {
+        if(ref->isForward)
+            continue;
+        if(NodeIdMap_contains(&nodeset->parentRefTypes, &ref->refType))
+            return ref;
+    }
+    return NULL;
+}
+
+static const UA_NodeId hasEncoding = {0, UA_NODEIDTYPE_NUMERIC, {UA_NS0ID_HASENCODING}};
+
+// Classify the HasEncoding targets of a DataType by their browse name
+static void
+Nodeset_resolveEncodings(NL_DataTypeNode *node) {
+    UA_String binaryName = UA_STRING("Default Binary");
+    UA_String xmlName = UA_STRING("Default XML");
+    UA_String jsonName = UA_STRING("Default JSON");
+    node->binaryEncodingId = UA_NODEID_NULL;
+    node->xmlEncodingId = UA_NODEID_NULL;
+    node->jsonEncodingId = UA_NODEID_NULL;
+    for(NL_Reference *ref = node->refs; ref != NULL; ref = ref->next) {
+        if(!ref->isForward || !ref->targetPtr ||
+           !UA_NodeId_equal(&ref->refType, &hasEncoding))
+            continue;
+        const UA_String *name = &ref->targetPtr->browseName.name;
+        if(UA_String_equal(name, &binaryName))
+            node->binaryEncodingId = ref->target;
+        else if(UA_String_equal(name, &xmlName))
+            node->xmlEncodingId = ref->target;
+        else if(UA_String_equal(name, &jsonName))
+            node->jsonEncodingId = ref->target;
+    }
+}
+
+void Nodeset_resolveReferences(Nodeset *nodeset) {
     // Make allNodes a sorted list
     qsort(nodeset->allNodes.nodes, nodeset->allNodes.size,
           sizeof(NL_Node *), compareNodeByNodeId);
@@ -193,16 +292,26 @@ bool Nodeset_sort(Nodeset *nodeset) {
             ref->targetPtr = Nodeset_findByNodeId(nodeset, &ref->target);
         }
     }
+}
 
+// Nodeset_resolveReferences must be called before
+bool Nodeset_sort(Nodeset *nodeset) {
     // Add ReferenceTypes
+    size_t refTypesBegin = nodeset->sortedNodes.size;
     bool done = Nodeset_sortNodeClass(nodeset, NODECLASS_REFERENCETYPE);
+    if(Progress_canceled(nodeset->progress))
+        goto finish;
     if(!done) {
         nodeset->logger->log(nodeset->logger->context, NODESETLOADER_LOGLEVEL_ERROR,
                              "Cannot add ReferenceType hierarchy");
     }
+    Nodeset_collectParentRefTypes(nodeset, refTypesBegin,
+                                  nodeset->sortedNodes.size);
 
     // Add DataTypes
     done = Nodeset_sortNodeClass(nodeset, NODECLASS_DATATYPE);
+    if(Progress_canceled(nodeset->progress))
+        goto finish;
     if(!done) {
         nodeset->logger->log(nodeset->logger->context, NODESETLOADER_LOGLEVEL_ERROR,
                              "Cannot add DataType hierarchy");
@@ -210,6 +319,8 @@ bool Nodeset_sort(Nodeset *nodeset) {
 
     // Add VariableTypes
     done = Nodeset_sortNodeClass(nodeset, NODECLASS_VARIABLETYPE);
+    if(Progress_canceled(nodeset->progress))
+        goto finish;
     if(!done) {
         nodeset->logger->log(nodeset->logger->context, NODESETLOADER_LOGLEVEL_ERROR,
                              "Cannot add VariableType hierarchy");
@@ -217,6 +328,8 @@ bool Nodeset_sort(Nodeset *nodeset) {
 
     // Add Views
     done = Nodeset_sortNodeClass(nodeset, NODECLASS_VIEW);
+    if(Progress_canceled(nodeset->progress))
+        goto finish;
     if(!done) {
         nodeset->logger->log(nodeset->logger->context, NODESETLOADER_LOGLEVEL_ERROR,
                              "Cannot add Views");
@@ -231,7 +344,7 @@ bool Nodeset_sort(Nodeset *nodeset) {
     done &= Nodeset_sortNodeClass(nodeset, NODECLASS_OBJECT);
     done &= Nodeset_sortNodeClass(nodeset, NODECLASS_METHOD);
     done &= Nodeset_sortNodeClass(nodeset, NODECLASS_VARIABLE);
-    if(done)
+    if(done || Progress_canceled(nodeset->progress))
         goto finish;
     if(totalSorted == nodeset->sortedNodes.size) {
         nodeset->logger->log(nodeset->logger->context, NODESETLOADER_LOGLEVEL_ERROR,
@@ -241,10 +354,15 @@ bool Nodeset_sort(Nodeset *nodeset) {
     goto retry;
 
  finish:
-    // Set isDone to false again
+    // Set isDone to false again and resolve the parent of every node
     for(size_t i = 0; i < nodeset->allNodes.size; i++) {
         NL_Node *node = nodeset->allNodes.nodes[i];
+        if(!node->isDone)
+            node->sortIndex = SORTINDEX_NONE; // Could not be sorted
         node->isDone = false;
+        node->parentRef = Nodeset_findParentRef(nodeset, node);
+        if(node->nodeClass == NODECLASS_DATATYPE)
+            Nodeset_resolveEncodings((NL_DataTypeNode *)node);
     }
     return done;
 }
@@ -260,6 +378,7 @@ void Nodeset_cleanup(Nodeset *nodeset) {
     }
     NodeContainer_clear(&nodeset->allNodes);
     NodeContainer_clear(&nodeset->sortedNodes);
+    NodeIdMap_clear(&nodeset->parentRefTypes);
     free(nodeset);
 }
 
@@ -369,6 +488,7 @@ Nodeset_newNode(Nodeset *nodeset, NL_NodeClass nodeClass,
                 size_t nb_attributes, const char **attributes) {
     NL_Node *node = Node_new(nodeClass);
     node->nodeClass = nodeClass;
+    MemoryAccount_allocNode(nodeset->memory, nodeClass, Node_size(nodeClass));
     extractAttributes(nodeset, node, nb_attributes, attributes);
     NodeContainer_add(&nodeset->nodes[node->nodeClass], node);
     NodeContainer_add(&nodeset->allNodes, node);
@@ -379,6 +499,7 @@ NL_Reference *
 Nodeset_newReference(Nodeset *nodeset, NL_Node *node,
                      size_t attributeSize, const char **attributes) {
     NL_Reference *newRef = (NL_Reference *)calloc(1, sizeof(NL_Reference));
+    MemoryAccount_alloc(nodeset->memory, NL_MEMORY_REFERENCES, sizeof(NL_Reference));
 
     char *isForwardString =
         getAttributeValue(nodeset, &attrIsForward, attributes, attributeSize);
@@ -394,6 +515,7 @@ Nodeset_newReference(Nodeset *nodeset, NL_Node *node,
 
     newRef->next = node->refs;
     node->refs = newRef;
+    nodeset->referencesSize++;
     return newRef;
 }
 
@@ -418,6 +540,8 @@ void Nodeset_addDataTypeDefinition(Nodeset *nodeset, NL_Node *node,
     NL_DataTypeNode *dataTypeNode = (NL_DataTypeNode *)node;
     dataTypeNode->definition = (NL_DataTypeDefinition *)
         calloc(1, sizeof(NL_DataTypeDefinition));
+    MemoryAccount_alloc(nodeset->memory, NL_MEMORY_DATATYPES,
+                        sizeof(NL_DataTypeDefinition));
     dataTypeNode->definition->isUnion =
         !strcmp("true", getAttributeValue(nodeset, &dataTypeDefinition_IsUnion,
                                           attributes, attributeSize));
@@ -433,6 +557,8 @@ void Nodeset_addDataTypeField(Nodeset *nodeset, NL_Node *node,
     NL_DataTypeDefinitionField *newField =
         DataTypeNode_addDefinitionField(dataTypeNode->definition);
     memset(newField, 0, sizeof(NL_DataTypeDefinitionField));
+    MemoryAccount_alloc(nodeset->memory, NL_MEMORY_DATATYPES,
+                        sizeof(NL_DataTypeDefinitionField));
 
     newField->name = getAttributeValue(nodeset, &dataTypeField_Name, attributes,
                                        attributeSize);
@@ -457,6 +583,7 @@ void Nodeset_addDataTypeField(Nodeset *nodeset, NL_Node *node,
 
 Alias *
 Nodeset_newAlias(Nodeset *nodeset, size_t attributeSize, const char **attributes) {
+    nodeset->aliasesSize++;
     return AliasList_newAlias(nodeset->aliasList,
                               getAttributeValue(nodeset, &attrAlias,
                                                 attributes, attributeSize));
@@ -514,15 +641,86 @@ Nodeset_InverseNameFinish(const Nodeset *nodeset, NL_Node *node, char *text) {
         ((NL_ReferenceTypeNode *)node)->inverseName.text = UA_STRING(text);
 }
 
+static bool
+forEachIn(NodeContainer *c, void *context, NodesetLoader_forEachNode_Func fn) {
+    for(size_t i = 0; i < c->size; i++) {
+        NL_Node *node = c->nodes[i];
+        bool res = fn(context, node);
+        if(!res)
+            return false;
+    }
+    return true;
+}
+
 bool
 Nodeset_forEachNode(Nodeset *nodeset, void *context,
                     NodesetLoader_forEachNode_Func fn) {
+    return forEachIn(&nodeset->sortedNodes, context, fn);
+}
+
+bool
+Nodeset_forEachParsedNode(Nodeset *nodeset, void *context,
+                          NodesetLoader_forEachNode_Func fn) {
+    return forEachIn(&nodeset->allNodes, context, fn);
+}
+
+static bool
+isTypeNode(const NL_Node *node) {
+    return node->nodeClass == NODECLASS_OBJECTTYPE ||
+           node->nodeClass == NODECLASS_VARIABLETYPE ||
+           node->nodeClass == NODECLASS_DATATYPE ||
+           node->nodeClass == NODECLASS_REFERENCETYPE;
+}
+
+bool
+Nodeset_forEachWindow(Nodeset *nodeset, void *context,
+                      NodesetLoader_forEachWindow_Func fn) {
     NodeContainer *c = &nodeset->sortedNodes;
+    if(c->size == 0)
+        return true;
+
+    // For every reference between two sorted nodes, count where it opens
+    // (the lower sortIndex) and where it closes (the higher sortIndex). The
+    // finish of a type does not depend on its instances, subtypes and
+    // children, so a reference from a later node to a type (HasTypeDefinition,
+    // HasSubtype, the parent of an instance declaration) does not cross. Nor
+    // does an implied reference from a type to a later node, as it is not
+    // added on its own.
+    size_t *opens = (size_t *)calloc(2 * c->size, sizeof(size_t));
+    if(!opens)
+        return false;
+    size_t *closes = opens + c->size;
     for(size_t i = 0; i < c->size; i++) {
         NL_Node *node = c->nodes[i];
-        bool res = fn(context, node);
+        for(NL_Reference *ref = node->refs; ref != NULL; ref = ref->next) {
+            if(!ref->targetPtr || ref->targetPtr->sortIndex == SORTINDEX_NONE)
+                continue;
+            size_t other = ref->targetPtr->sortIndex;
+            if(other == i)
+                continue;
+            if(other < i && isTypeNode(ref->targetPtr))
+                continue;
+            if(other > i && isTypeNode(node) && ref->isImplied)
+                continue;
+            opens[(other < i) ? other : i]++;
+            closes[(other < i) ? i : other]++;
+        }
+    }
+
+    // A window ends where no reference crosses the boundary
+    bool res = true;
+    size_t begin = 0;
+    size_t crossing = 0;
+    for(size_t i = 0; i < c->size; i++) {
+        crossing += opens[i];
+        crossing -= closes[i];
+        if(crossing > 0)
+            continue;
+        res = fn(context, &c->nodes[begin], i + 1 - begin);
         if(!res)
-            return false;
+            break;
+        begin = i + 1;
     }
-    return true;
+    free(opens);
+    return res;
 }
@@ -11,6 +11,10 @@
 #include "NodesetLoader/NodesetLoader.h"
 #include "CharAllocator.h"
 #include "Node.h"
+#include "Memory.h"
+#include "NodeIdMap.h"
+#include "Progress.h"
+#include "Trace.h"
 
 #include <stdbool.h>
 #include <stddef.h>
@@ -28,6 +32,15 @@ typedef struct {
     NodeContainer allNodes; // gets sorted according to the nodeid
     NodeContainer sortedNodes; // in the order to add to the server
 
+    NodeIdMap parentRefTypes; // HasChild and its subtypes
+
+    size_t referencesSize;
+    size_t aliasesSize;
+
+    Trace *trace; // Can be NULL, owned by the loader
+    MemoryAccount *memory; // Can be NULL, owned by the loader
+    Progress *progress; // Can be NULL, owned by the loader
+
     NL_FileContext *fc;
     NodesetLoader_Logger* logger;
 } Nodeset;
@@ -35,7 +48,9 @@ typedef struct {
 Nodeset *Nodeset_new(NL_addNamespaceCallback nsCallback,
                      NodesetLoader_Logger* logger);
 void Nodeset_cleanup(Nodeset *nodeset);
+void Nodeset_resolveReferences(Nodeset *nodeset);
 bool Nodeset_sort(Nodeset *nodeset);
+bool Nodeset_addParentReferenceType(Nodeset *nodeset, const UA_NodeId *refType);
 NL_Node *Nodeset_newNode(Nodeset *nodeset, NL_NodeClass nodeClass,
                          size_t attributeSize, const char **attributes);
 NL_Reference *Nodeset_newReference(Nodeset *nodeset, NL_Node *node,
@@ -63,5 +78,9 @@ void Nodeset_setInverseName(Nodeset *nodeset, NL_Node *node, size_t attributeSiz
 void Nodeset_InverseNameFinish(const Nodeset *nodeset, NL_Node *node, char *text);
 bool Nodeset_forEachNode(Nodeset *nodeset, void *context,
                          NodesetLoader_forEachNode_Func fn);
+bool Nodeset_forEachParsedNode(Nodeset *nodeset, void *context,
+                               NodesetLoader_forEachNode_Func fn);
+bool Nodeset_forEachWindow(Nodeset *nodeset, void *context,
+                           NodesetLoader_forEachWindow_Func fn);
 
 #endif
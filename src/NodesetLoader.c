@@ -7,13 +7,23 @@
  */
 
 #include "Nodeset.h"
+#include "AliasList.h"
+#include "Progress.h"
 #include <assert.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 
 #include <libxml/parser.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
 #define OBJECT "UAObject"
 #define METHOD "UAMethod"
 #define OBJECTTYPE "UAObjectType"
@@ -34,13 +44,34 @@
 #define EXTENSION "Extension"
 #define INVERSENAME "InverseName"
 
-const char *NL_NODECLASS_NAME[NL_NODECLASS_COUNT] = {
+const char *const NL_NODECLASS_NAME[NL_NODECLASS_COUNT] = {
     "Object", "ObjectType", "Variable", "DataType",
     "Method", "ReferenceType", "VariableType", "View"};
 
+const char *const NL_PHASE_NAME[NL_PHASE_COUNT] = {
+    "read", "parse", "attributes", "resolve", "sort",
+    "datatypes", "values", "addNodes", "addReferences", "finishNodes"};
+
+const char *const NL_MEMORY_NAME[NL_MEMORY_COUNT] = {
+    "fileBuffer", "arena", "nodes", "references", "dataTypes", "values",
+    "decode", "extensions"};
+
 struct NodesetLoader {
     Nodeset *nodeset;
     NodesetLoader_Logger *logger;
+    NL_PhaseTime times[NL_PHASE_COUNT];
+    UA_DateTime wallStart[NL_PHASE_COUNT];
+    clock_t cpuStart[NL_PHASE_COUNT];
+    Trace *trace; // NULL unless tracing was started
+    xmlParserCtxtPtr xmlCtxt; // Reused for the files of the loader
+    MemoryAccount memory;
+    size_t peakRssKb[NL_PHASE_COUNT];
+    Progress progress;
+    struct FileImport *import; // From importBegin until importEnd
+    bool timePhases; // See NodesetLoader_enableTiming
+    // A file was not imported completely, a part of its nodes is in the
+    // nodeset. The loader refuses to import or sort.
+    bool failed;
 };
 
 typedef enum {
@@ -57,6 +88,7 @@ typedef enum {
     PARSER_STATE_VALUE,
     PARSER_STATE_EXTENSION,
     PARSER_STATE_EXTENSIONS,
+    PARSER_STATE_EXTENSIONS_RAW,
     PARSER_STATE_DATATYPE_DEFINITION,
     PARSER_STATE_DATATYPE_DEFINITION_FIELD
 } TParserState;
@@ -72,21 +104,40 @@ typedef struct {
     char *onCharacters;
     size_t onCharLength;
     long valueBegin;
+    long extensionsBegin;
+    bool captureRawExtensions;
     void *extensionData;
     NodesetLoader_ExtensionInterface *extIf;
     NL_Reference *ref;
     Nodeset *nodeset;
     xmlParserCtxtPtr ctxt;
     char *buf;
+    bool timeCallbacks; /* only with the phase timing enabled */
+    UA_DateTime callbackTime; /* spent in the sax callbacks */
+    Progress *progress;
+    size_t bytesBefore; /* parsed in the previous files */
 } TParserCtx;
 
+/* Offset of the parser in the file. The push parser discards the consumed
+ * input when it is fed in chunks, input->consumed counts it. */
+static long
+parserOffset(const TParserCtx *pctx) {
+    const xmlParserInput *input = pctx->ctxt->input;
+    return (long)input->consumed + (input->cur - input->base);
+}
+
+/* Offset of the '<' of the element that was just started */
+static long
+currentOffset(const TParserCtx *pctx) {
+    long offset = parserOffset(pctx);
+    while(pctx->buf[offset] != '<')
+        offset--;
+    return offset;
+}
+
 static void
-OnStartElementNs(void *ctx, const char *localname,
-                 const char *prefix, const char *URI,
-                 int nb_namespaces, const char **namespaces,
-                 int nb_attributes, int nb_defaulted,
-                 const char **attributes) {
-    TParserCtx *pctx = (TParserCtx*)ctx;
+startElement(TParserCtx *pctx, const char *localname,
+             int nb_attributes, const char **attributes) {
 
     /* We are below an unknown element */
     if(pctx->unknown_depth > 0) {
@@ -178,9 +229,10 @@ OnStartElementNs(void *ctx, const char *localname,
         } else if (!strcmp(localname, VALUE)) {
             pctx->state = PARSER_STATE_VALUE;
             pctx->value_depth++;
-            pctx->valueBegin = pctx->ctxt->input->cur - pctx->ctxt->input->base;
-            while(pctx->buf[pctx->valueBegin] != '<')
-                pctx->valueBegin--;
+            pctx->valueBegin = currentOffset(pctx);
+        } else if (!strcmp(localname, EXTENSIONS) && pctx->captureRawExtensions) {
+            pctx->state = PARSER_STATE_EXTENSIONS_RAW;
+            pctx->extensionsBegin = currentOffset(pctx);
         } else if (!strcmp(localname, EXTENSIONS)) {
             pctx->state = PARSER_STATE_EXTENSIONS;
         } else if (!strcmp(localname, "Definition")) {
@@ -230,6 +282,10 @@ OnStartElementNs(void *ctx, const char *localname,
         }
         break;
 
+    case PARSER_STATE_EXTENSIONS_RAW:
+        pctx->unknown_depth++; /* Skipped until </Extensions> */
+        return;
+
     case PARSER_STATE_REFERENCES:
         if(!strcmp(localname, REFERENCE)) {
             pctx->state = PARSER_STATE_REFERENCE;
@@ -249,10 +305,7 @@ OnStartElementNs(void *ctx, const char *localname,
 }
 
 static void
-OnEndElementNs(void *ctx, const char *localname,
-               const char *prefix, const char *URI) {
-    TParserCtx *pctx = (TParserCtx*)ctx;
-    
+endElement(TParserCtx *pctx, const char *localname) {
     if(pctx->unknown_depth > 0) {
         pctx->unknown_depth--;
         return;
@@ -274,6 +327,11 @@ OnEndElementNs(void *ctx, const char *localname,
         break;
     case PARSER_STATE_NODE:
         pctx->state = PARSER_STATE_INIT;
+        pctx->progress->progress.nodesCreated++;
+        pctx->progress->progress.bytesParsed =
+            pctx->bytesBefore + (size_t)parserOffset(pctx);
+        if(!Progress_step(pctx->progress))
+            xmlStopParser(pctx->ctxt); /* Canceled */
         break;
     case PARSER_STATE_DISPLAYNAME:
         Nodeset_DisplayNameFinish(pctx->nodeset, pctx->node,
@@ -293,11 +351,13 @@ OnEndElementNs(void *ctx, const char *localname,
             if(pctx->value_depth == 0) {
                 /* Leaving the value element. Store the value */
                 if(pctx->node->nodeClass == NODECLASS_VARIABLE) {
-                    long valueEnd = pctx->ctxt->input->cur - pctx->ctxt->input->base;
+                    long valueEnd = parserOffset(pctx);
                     UA_String xmlValue;
                     xmlValue.data = (UA_Byte*)pctx->buf + pctx->valueBegin;
                     xmlValue.length = (size_t)(valueEnd - pctx->valueBegin);
                     UA_String_copy(&xmlValue, &((NL_VariableNode *)pctx->node)->value);
+                    MemoryAccount_alloc(pctx->nodeset->memory, NL_MEMORY_VALUES,
+                                        xmlValue.length);
                 }
                 pctx->state = PARSER_STATE_NODE;
             }
@@ -319,6 +379,25 @@ OnEndElementNs(void *ctx, const char *localname,
     case PARSER_STATE_EXTENSIONS:
         pctx->state = PARSER_STATE_NODE;
         break;
+    case PARSER_STATE_EXTENSIONS_RAW: {
+        /* Store the span from <Extensions> to </Extensions> */
+        long end = parserOffset(pctx);
+        UA_String xml;
+        xml.data = (UA_Byte*)pctx->buf + pctx->extensionsBegin;
+        xml.length = (size_t)(end - pctx->extensionsBegin);
+        UA_String *raw = UA_String_new();
+        if(raw && UA_String_copy(&xml, raw) != UA_STATUSCODE_GOOD) {
+            UA_String_delete(raw);
+            raw = NULL;
+        }
+        if(raw) {
+            pctx->node->extension = raw;
+            MemoryAccount_alloc(pctx->nodeset->memory, NL_MEMORY_EXTENSIONS,
+                                sizeof(UA_String) + xml.length);
+        }
+        pctx->state = PARSER_STATE_NODE;
+        break;
+    }
     case PARSER_STATE_DESCRIPTION:
         Nodeset_DescriptionFinish(pctx->nodeset, pctx->node, pctx->onCharacters);
         pctx->state = PARSER_STATE_NODE;
@@ -339,8 +418,10 @@ OnEndElementNs(void *ctx, const char *localname,
 }
 
 static void
-OnCharacters(void *ctx, const char *ch, int len) {
-    TParserCtx *pctx = (TParserCtx*)ctx;
+characters(TParserCtx *pctx, const char *ch, int len) {
+    /* The text is part of the raw span */
+    if(pctx->state == PARSER_STATE_EXTENSIONS_RAW)
+        return;
     if(pctx->onCharacters == NULL) {
         char *newValue = CharArenaAllocator_malloc(pctx->nodeset->charArena,
                                                    (size_t) len + 1);
@@ -353,48 +434,180 @@ OnCharacters(void *ctx, const char *ch, int len) {
     pctx->onCharLength += (size_t)len;
 }
 
-static int
-Parser_run(TParserCtx *context, FILE *file) {
+/* The time spent in the callbacks is the attribute extraction, the rest of
+ * the parsing is spent in libxml2. The clocks are only read with the phase
+ * timing enabled. */
+
+static void
+OnStartElementNs(void *ctx, const char *localname,
+                 const char *prefix, const char *URI,
+                 int nb_namespaces, const char **namespaces,
+                 int nb_attributes, int nb_defaulted,
+                 const char **attributes) {
+    TParserCtx *pctx = (TParserCtx*)ctx;
+    if(!pctx->timeCallbacks) {
+        startElement(pctx, localname, nb_attributes, attributes);
+        return;
+    }
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    startElement(pctx, localname, nb_attributes, attributes);
+    pctx->callbackTime += UA_DateTime_nowMonotonic() - start;
+}
+
+static void
+OnEndElementNs(void *ctx, const char *localname,
+               const char *prefix, const char *URI) {
+    TParserCtx *pctx = (TParserCtx*)ctx;
+    if(!pctx->timeCallbacks) {
+        endElement(pctx, localname);
+        return;
+    }
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    endElement(pctx, localname);
+    pctx->callbackTime += UA_DateTime_nowMonotonic() - start;
+}
+
+static void
+OnCharacters(void *ctx, const char *ch, int len) {
+    TParserCtx *pctx = (TParserCtx*)ctx;
+    if(!pctx->timeCallbacks) {
+        characters(pctx, ch, len);
+        return;
+    }
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    characters(pctx, ch, len);
+    pctx->callbackTime += UA_DateTime_nowMonotonic() - start;
+}
+
+/* libxml2 is initialized once per process and never cleaned up by the loader,
+ * as xmlCleanupParser would pull the global state from under loaders in other
+ * threads. All other parser state is per loader. */
+#ifdef _WIN32
+static INIT_ONCE xmlInitOnce = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK
+initXmlOnce(PINIT_ONCE once, PVOID param, PVOID *context) {
+    xmlInitParser();
+    return TRUE;
+}
+
+static void
+initXml(void) {
+    InitOnceExecuteOnce(&xmlInitOnce, initXmlOnce, NULL, NULL);
+}
+#else
+static pthread_once_t xmlInitOnce = PTHREAD_ONCE_INIT;
+
+static void
+initXmlOnce(void) {
+    xmlInitParser();
+}
+
+static void
+initXml(void) {
+    pthread_once(&xmlInitOnce, initXmlOnce);
+}
+#endif
+
+/* The push parser context is created with the first file of the loader and
+ * reset for the following files */
+static xmlParserCtxtPtr
+getParserCtxt(NodesetLoader *loader, TParserCtx *context) {
+    if(loader->xmlCtxt) {
+        if(xmlCtxtResetPush(loader->xmlCtxt, NULL, 0, NULL, NULL) != 0)
+            return NULL;
+        loader->xmlCtxt->userData = context;
+    } else {
+        initXml();
+        xmlSAXHandler hdl;
+        memset(&hdl, 0, sizeof(hdl));
+        hdl.initialized = XML_SAX2_MAGIC;
+        hdl.startElementNs = (startElementNsSAX2Func)OnStartElementNs;
+        hdl.endElementNs = (endElementNsSAX2Func)OnEndElementNs;
+        hdl.characters = (charactersSAXFunc)OnCharacters;
+        loader->xmlCtxt = xmlCreatePushParserCtxt(&hdl, context, NULL, 0, NULL);
+        if(!loader->xmlCtxt)
+            return NULL;
+    }
+    xmlCtxtUseOptions(loader->xmlCtxt, XML_PARSE_HUGE);
+    return loader->xmlCtxt;
+}
+
+/* A file that is parsed in steps, see NodesetLoader_importBegin. The file is
+ * read into memory at the begin and fed to the push parser in chunks. */
+typedef struct FileImport {
+    TParserCtx ctx; /* userData of the xml parser */
+    const char *file;
+    size_t bufSize; /* allocated for ctx.buf */
+    size_t size;    /* bytes of the file */
+    size_t fed;     /* bytes passed to the parser */
+    bool done;      /* the last chunk was passed */
+    bool failed;
+    UA_DateTime traceBegin;
+} FileImport;
+
+/* Bytes fed between the checks of maxNodes */
+#define IMPORT_NODE_CHUNK 4096
+
+static bool
+readFile(NodesetLoader *loader, FileImport *fi, FILE *file) {
     /* Read entire file into memory */
+    NodesetLoader_startPhase(loader, NL_PHASE_READ);
     fseek(file, 0, SEEK_END);
     long fsize = ftell(file);
     fseek(file, 0, SEEK_SET);
 
     char *buf = (char*)malloc((size_t)(fsize + 1));
-    if(!buf)
-        return 1;
+    if(!buf) {
+        NodesetLoader_stopPhase(loader, NL_PHASE_READ);
+        return false;
+    }
+
+    fi->bufSize = (size_t)fsize + 1;
+    MemoryAccount_alloc(&loader->memory, NL_MEMORY_FILEBUFFER, fi->bufSize);
 
     size_t elems = fread(buf, 1, (size_t)fsize, file);
     buf[elems] = 0; /* Ensure null terminated */
-    context->buf = buf;
-
-    xmlInitParser();
-
-    xmlSAXHandler hdl;
-    memset(&hdl, 0, sizeof(hdl));
-    hdl.initialized = XML_SAX2_MAGIC;
-    hdl.startElementNs = (startElementNsSAX2Func)OnStartElementNs;
-    hdl.endElementNs = (endElementNsSAX2Func)OnEndElementNs;
-    hdl.characters = (charactersSAXFunc)OnCharacters;
-
-    context->ctxt = xmlCreatePushParserCtxt(&hdl, context, NULL, 0, NULL);
-    xmlCtxtUseOptions(context->ctxt, XML_PARSE_HUGE);
+    fi->ctx.buf = buf;
+    fi->size = elems;
+    NodesetLoader_stopPhase(loader, NL_PHASE_READ);
+    return true;
+}
 
-    /* single-chunk feed */
-    int ret = xmlParseChunk(context->ctxt, buf, (int)elems, 1);
+static void
+FileImport_delete(NodesetLoader *loader, FileImport *fi) {
+    if(fi->ctx.buf) {
+        free(fi->ctx.buf);
+        MemoryAccount_free(&loader->memory, NL_MEMORY_FILEBUFFER, fi->bufSize);
+    }
+    free(fi);
+}
 
-    xmlFreeParserCtxt(context->ctxt);
-    free(buf);
-    xmlCleanupParser();
+static void
+FileImport_trace(NodesetLoader *loader, const FileImport *fi) {
+    if(loader->trace)
+        Trace_add(loader->trace, "importFile", fi->file, fi->traceBegin,
+                  UA_DateTime_nowMonotonic());
+}
 
-    if(ret < 0)
-        return 1;
-    return 0;
+/* Move the time of the callbacks to the attribute extraction. The cpu time
+ * is split in the same ratio as the wall time. */
+static void
+moveCallbackTime(NodesetLoader *loader, const NL_PhaseTime *before,
+                 UA_DateTime callbackTime) {
+    double attrWall = (double)callbackTime / UA_DATETIME_SEC;
+    double parseWall = loader->times[NL_PHASE_PARSE].wallTime - before->wallTime;
+    double parseCpu = loader->times[NL_PHASE_PARSE].cpuTime - before->cpuTime;
+    double attrCpu = (parseWall > 0) ? parseCpu * attrWall / parseWall : 0;
+    loader->times[NL_PHASE_PARSE].wallTime -= attrWall;
+    loader->times[NL_PHASE_PARSE].cpuTime -= attrCpu;
+    loader->times[NL_PHASE_ATTRIBUTES].wallTime += attrWall;
+    loader->times[NL_PHASE_ATTRIBUTES].cpuTime += attrCpu;
 }
 
 bool
-NodesetLoader_importFile(NodesetLoader *loader,
-                         const NL_FileContext *fileHandler) {
+NodesetLoader_importBegin(NodesetLoader *loader,
+                          const NL_FileContext *fileHandler) {
     if(!fileHandler) {
         loader->logger->log(loader->logger->context,
                             NODESETLOADER_LOGLEVEL_ERROR,
@@ -409,45 +622,210 @@ NodesetLoader_importFile(NodesetLoader *loader,
         return false;
     }
 
+    if(loader->import) {
+        loader->logger->log(loader->logger->context,
+                            NODESETLOADER_LOGLEVEL_ERROR,
+                            "NodesetLoader: the previous import was not ended");
+        return false;
+    }
+
+    if(loader->failed) {
+        loader->logger->log(loader->logger->context,
+                            NODESETLOADER_LOGLEVEL_ERROR,
+                            "NodesetLoader: a previous import failed");
+        return false;
+    }
+
+    if(Progress_canceled(&loader->progress)) {
+        loader->logger->log(loader->logger->context,
+                            NODESETLOADER_LOGLEVEL_ERROR,
+                            "NodesetLoader: import canceled");
+        return false;
+    }
+
     if(!loader->nodeset) {
         loader->nodeset = Nodeset_new(fileHandler->addNamespace, loader->logger);
+        loader->nodeset->trace = loader->trace;
+        loader->nodeset->memory = &loader->memory;
+        loader->nodeset->progress = &loader->progress;
     }
 
-    TParserCtx ctx;
-    bool retStatus = true;
-    FILE *f = fopen(fileHandler->file, "r");
-    memset(&ctx, 0, sizeof(TParserCtx));
+    FileImport *fi = (FileImport *)calloc(1, sizeof(FileImport));
+    if(!fi)
+        return false;
+    fi->file = fileHandler->file;
+    if(loader->trace)
+        fi->traceBegin = UA_DateTime_nowMonotonic();
 
+    FILE *f = fopen(fileHandler->file, "r");
     if(!f) {
         loader->logger->log(loader->logger->context,
                             NODESETLOADER_LOGLEVEL_ERROR,
                             "NodesetLoader: file open error");
-        retStatus = false;
-        goto cleanup;
+        FileImport_trace(loader, fi);
+        FileImport_delete(loader, fi);
+        return false;
     }
 
-    ctx.nodeset = loader->nodeset;
-    ctx.state = PARSER_STATE_INIT;
-    ctx.userContext = fileHandler->userContext;
-    ctx.extIf = fileHandler->extensionHandling;
-    ctx.nodeset = loader->nodeset;
-    ctx.nodeset->fc = (NL_FileContext*)(uintptr_t)fileHandler;
+    TParserCtx *ctx = &fi->ctx;
+    ctx->state = PARSER_STATE_INIT;
+    ctx->userContext = fileHandler->userContext;
+    ctx->extIf = fileHandler->extensionHandling;
+    ctx->captureRawExtensions = fileHandler->captureRawExtensions;
+    ctx->nodeset = loader->nodeset;
+    ctx->nodeset->fc = (NL_FileContext*)(uintptr_t)fileHandler;
+    ctx->progress = &loader->progress;
+    ctx->bytesBefore = loader->progress.progress.bytesParsed;
+    ctx->timeCallbacks = loader->timePhases;
 
-    if(Parser_run(&ctx, f)) {
+    bool ok = readFile(loader, fi, f);
+    fclose(f);
+    if(ok) {
+        ctx->ctxt = getParserCtxt(loader, ctx);
+        ok = (ctx->ctxt != NULL);
+    }
+    if(!ok) {
         loader->logger->log(loader->logger->context,
                             NODESETLOADER_LOGLEVEL_ERROR, "xml parsing error");
-        retStatus = false;
+        FileImport_trace(loader, fi);
+        FileImport_delete(loader, fi);
+        return false;
+    }
+    loader->progress.progress.bytesTotal += fi->size;
+    loader->import = fi;
+    return true;
+}
+
+NL_ImportStepResult
+NodesetLoader_importStep(NodesetLoader *loader, size_t maxBytes,
+                         size_t maxNodes) {
+    FileImport *fi = loader->import;
+    if(!fi || fi->failed)
+        return NL_IMPORTSTEP_ERROR;
+    if(fi->done)
+        return NL_IMPORTSTEP_DONE;
+
+    size_t budget = (maxBytes > 0) ? maxBytes : fi->size - fi->fed;
+    size_t nodesEnd = loader->progress.progress.nodesCreated + maxNodes;
+    NL_PhaseTime before = loader->times[NL_PHASE_PARSE];
+    UA_DateTime callbackBefore = fi->ctx.callbackTime;
+    NodesetLoader_startPhase(loader, NL_PHASE_PARSE);
+    do {
+        size_t chunk = fi->size - fi->fed;
+        if(chunk > budget)
+            chunk = budget;
+        if(maxNodes > 0 && chunk > IMPORT_NODE_CHUNK)
+            chunk = IMPORT_NODE_CHUNK;
+        if(chunk > INT_MAX)
+            chunk = INT_MAX;
+        fi->done = (fi->fed + chunk == fi->size);
+        int ret = xmlParseChunk(fi->ctx.ctxt, fi->ctx.buf + fi->fed, (int)chunk,
+                                fi->done);
+        fi->fed += chunk;
+        budget -= chunk;
+        if(ret < 0 || Progress_canceled(&loader->progress))
+            fi->failed = true;
+    } while(!fi->done && !fi->failed && budget > 0 &&
+            (maxNodes == 0 || loader->progress.progress.nodesCreated < nodesEnd));
+    NodesetLoader_stopPhase(loader, NL_PHASE_PARSE);
+    moveCallbackTime(loader, &before, fi->ctx.callbackTime - callbackBefore);
+
+    if(fi->failed)
+        return NL_IMPORTSTEP_ERROR;
+    return fi->done ? NL_IMPORTSTEP_DONE : NL_IMPORTSTEP_CONTINUE;
+}
+
+bool
+NodesetLoader_importEnd(NodesetLoader *loader) {
+    FileImport *fi = loader->import;
+    if(!fi)
+        return false;
+    loader->import = NULL;
+
+    bool status = (fi->done && !fi->failed);
+    if(status) {
+        loader->progress.progress.bytesParsed = fi->ctx.bytesBefore + fi->size;
+        status = Progress_report(&loader->progress);
+    }
+    if(!status) {
+        loader->failed = true;
+        const char *msg = "xml parsing error";
+        if(Progress_canceled(&loader->progress))
+            msg = "NodesetLoader: import canceled";
+        else if(!fi->failed)
+            msg = "NodesetLoader: import ended before the file was parsed";
+        loader->logger->log(loader->logger->context,
+                            NODESETLOADER_LOGLEVEL_ERROR, msg);
     }
+    FileImport_trace(loader, fi);
+    FileImport_delete(loader, fi);
+    return status;
+}
 
-cleanup:
-    if(f)
-        fclose(f);
-    return retStatus;
+bool
+NodesetLoader_importFile(NodesetLoader *loader,
+                         const NL_FileContext *fileHandler) {
+    if(!NodesetLoader_importBegin(loader, fileHandler))
+        return false;
+    /* single-chunk feed */
+    NodesetLoader_importStep(loader, 0, 0);
+    return NodesetLoader_importEnd(loader);
 }
 
 bool
 NodesetLoader_sort(NodesetLoader *loader) {
-    return Nodeset_sort(loader->nodeset);
+    if(Progress_canceled(&loader->progress) || loader->failed)
+        return false;
+    NodesetLoader_startPhase(loader, NL_PHASE_RESOLVE);
+    Nodeset_resolveReferences(loader->nodeset);
+    NodesetLoader_stopPhase(loader, NL_PHASE_RESOLVE);
+    NodesetLoader_startPhase(loader, NL_PHASE_SORT);
+    bool res = Nodeset_sort(loader->nodeset);
+    NodesetLoader_stopPhase(loader, NL_PHASE_SORT);
+    if(!Progress_report(&loader->progress)) {
+        loader->logger->log(loader->logger->context,
+                            NODESETLOADER_LOGLEVEL_ERROR,
+                            "NodesetLoader: import canceled");
+        return false;
+    }
+    return res;
+}
+
+void
+NodesetLoader_setProgressCallback(NodesetLoader *loader,
+                                  NL_ProgressCallback callback, void *context) {
+    loader->progress.callback = callback;
+    loader->progress.context = context;
+}
+
+bool
+NodesetLoader_reportStep(NodesetLoader *loader, size_t nodesInserted) {
+    loader->progress.progress.nodesInserted += nodesInserted;
+    return Progress_step(&loader->progress);
+}
+
+bool
+NodesetLoader_reportProgress(NodesetLoader *loader) {
+    return Progress_report(&loader->progress);
+}
+
+bool
+NodesetLoader_isCanceled(const NodesetLoader *loader) {
+    return Progress_canceled(&loader->progress);
+}
+
+bool
+NodesetLoader_addParentReferenceType(NodesetLoader *loader,
+                                     const UA_NodeId *refType) {
+    if(!loader->nodeset) {
+        loader->nodeset = Nodeset_new(NULL, loader->logger);
+        if(!loader->nodeset)
+            return false;
+        loader->nodeset->trace = loader->trace;
+        loader->nodeset->memory = &loader->memory;
+        loader->nodeset->progress = &loader->progress;
+    }
+    return Nodeset_addParentReferenceType(loader->nodeset, refType);
 }
 
 NodesetLoader *
@@ -464,12 +842,275 @@ NodesetLoader_new(NodesetLoader_Logger *logger) {
 
 void
 NodesetLoader_delete(NodesetLoader *loader) {
+    if(loader->import)
+        FileImport_delete(loader, loader->import);
+    if(loader->xmlCtxt)
+        xmlFreeParserCtxt(loader->xmlCtxt);
     Nodeset_cleanup(loader->nodeset);
+    Trace_delete(loader->trace);
     free(loader);
 }
 
+/* Replays the callbacks of the extension interface for raw <Extensions> xml.
+ * Prefixes that were declared in the nodeset are unbound in the span. libxml2
+ * reports them as namespace errors and continues with the local names. */
+typedef struct {
+    const NodesetLoader_ExtensionInterface *extIf;
+    void *extensionData;
+    void *result;
+    bool inExtension;
+    CharArenaAllocator *text;
+    char *onCharacters;
+    size_t onCharLength;
+} ExtensionParserCtx;
+
+static void
+OnExtensionStart(void *ctx, const char *localname, const char *prefix,
+                 const char *URI, int nb_namespaces, const char **namespaces,
+                 int nb_attributes, int nb_defaulted, const char **attributes) {
+    ExtensionParserCtx *ectx = (ExtensionParserCtx *)ctx;
+    if(ectx->inExtension) {
+        ectx->extIf->start(ectx->extensionData, localname, nb_attributes,
+                           attributes);
+    } else if(!strcmp(localname, EXTENSION)) {
+        ectx->extensionData = ectx->extIf->newExtension();
+        ectx->inExtension = true;
+    }
+    ectx->onCharacters = NULL;
+    ectx->onCharLength = 0;
+}
+
+static void
+OnExtensionEnd(void *ctx, const char *localname, const char *prefix,
+               const char *URI) {
+    ExtensionParserCtx *ectx = (ExtensionParserCtx *)ctx;
+    if(ectx->inExtension && !strcmp(localname, EXTENSION)) {
+        ectx->extIf->finish(ectx->extensionData);
+        ectx->result = ectx->extensionData;
+        ectx->inExtension = false;
+    } else if(ectx->inExtension) {
+        ectx->extIf->end(ectx->extensionData, localname, ectx->onCharacters);
+    }
+    ectx->onCharacters = NULL;
+    ectx->onCharLength = 0;
+}
+
+static void
+OnExtensionCharacters(void *ctx, const char *ch, int len) {
+    ExtensionParserCtx *ectx = (ExtensionParserCtx *)ctx;
+    if(!ectx->onCharacters) {
+        ectx->onCharacters =
+            CharArenaAllocator_malloc(ectx->text, (size_t)len + 1);
+    } else {
+        ectx->onCharacters =
+            CharArenaAllocator_realloc(ectx->text, (size_t)len + 1);
+    }
+    if(!ectx->onCharacters)
+        return;
+    memcpy(ectx->onCharacters + ectx->onCharLength, ch, (size_t)len);
+    ectx->onCharLength += (size_t)len;
+}
+
+static void
+ignoreXmlError(void *ctx, const void *error) {}
+
+void *
+NodesetLoader_parseExtensions(const UA_String *xml,
+                              const NodesetLoader_ExtensionInterface *extIf) {
+    if(!xml || xml->length == 0 || !extIf || xml->length > INT_MAX)
+        return NULL;
+    ExtensionParserCtx ectx;
+    memset(&ectx, 0, sizeof(ExtensionParserCtx));
+    ectx.extIf = extIf;
+    ectx.text = CharArenaAllocator_new(1024);
+    if(!ectx.text)
+        return NULL;
+
+    xmlSAXHandler hdl;
+    memset(&hdl, 0, sizeof(hdl));
+    hdl.initialized = XML_SAX2_MAGIC;
+    hdl.startElementNs = (startElementNsSAX2Func)OnExtensionStart;
+    hdl.endElementNs = (endElementNsSAX2Func)OnExtensionEnd;
+    hdl.characters = (charactersSAXFunc)OnExtensionCharacters;
+    hdl.serror = (xmlStructuredErrorFunc)ignoreXmlError;
+
+    initXml();
+    xmlParserCtxtPtr ctxt = xmlCreatePushParserCtxt(&hdl, &ectx, NULL, 0, NULL);
+    if(ctxt) {
+        xmlParseChunk(ctxt, (const char *)xml->data, (int)xml->length, 1);
+        xmlFreeParserCtxt(ctxt);
+    }
+    CharArenaAllocator_delete(ectx.text);
+    return ectx.result;
+}
+
 bool
 NodesetLoader_forEachNode(NodesetLoader *loader, void *context,
                           NodesetLoader_forEachNode_Func fn) {
     return Nodeset_forEachNode(loader->nodeset, context, fn);
 }
+
+bool
+NodesetLoader_forEachParsedNode(NodesetLoader *loader, void *context,
+                                NodesetLoader_forEachNode_Func fn) {
+    if(!loader->nodeset)
+        return true;
+    return Nodeset_forEachParsedNode(loader->nodeset, context, fn);
+}
+
+bool
+NodesetLoader_forEachWindow(NodesetLoader *loader, void *context,
+                            NodesetLoader_forEachWindow_Func fn) {
+    return Nodeset_forEachWindow(loader->nodeset, context, fn);
+}
+
+bool
+NodesetLoader_forEachAlias(NodesetLoader *loader, void *context,
+                           NodesetLoader_forEachAlias_Func fn) {
+    if(!loader->nodeset)
+        return true;
+    return AliasList_forEach(loader->nodeset->aliasList, context, fn);
+}
+
+void
+NodesetLoader_startPhase(NodesetLoader *loader, NL_Phase phase) {
+    if(!loader->timePhases)
+        return;
+    loader->wallStart[phase] = UA_DateTime_nowMonotonic();
+    loader->cpuStart[phase] = clock();
+}
+
+void
+NodesetLoader_stopPhase(NodesetLoader *loader, NL_Phase phase) {
+    if(loader->nodeset)
+        MemoryAccount_set(&loader->memory, NL_MEMORY_ARENA,
+                          CharArenaAllocator_regionBytes(loader->nodeset->charArena));
+    if(!loader->timePhases)
+        return;
+    clock_t cpu = clock() - loader->cpuStart[phase];
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    UA_DateTime wall = now - loader->wallStart[phase];
+    loader->times[phase].wallTime += (double)wall / UA_DATETIME_SEC;
+    loader->times[phase].cpuTime += (double)cpu / CLOCKS_PER_SEC;
+    loader->peakRssKb[phase] = Memory_peakRssKb();
+    if(loader->trace)
+        Trace_add(loader->trace, NL_PHASE_NAME[phase], NULL,
+                  loader->wallStart[phase], now);
+}
+
+void
+NodesetLoader_addPhaseTime(NodesetLoader *loader, NL_Phase phase,
+                           const NL_PhaseTime *time) {
+    if(!loader->timePhases)
+        return;
+    loader->times[phase].wallTime += time->wallTime;
+    loader->times[phase].cpuTime += time->cpuTime;
+    loader->peakRssKb[phase] = Memory_peakRssKb();
+}
+
+bool
+NodesetLoader_startTrace(NodesetLoader *loader, UA_DateTime slowNodeThreshold) {
+    if(loader->trace) {
+        loader->trace->slowNodeThreshold = slowNodeThreshold;
+        return true;
+    }
+    loader->trace = Trace_new(slowNodeThreshold);
+    if(!loader->trace)
+        return false;
+    loader->timePhases = true;
+    if(loader->nodeset)
+        loader->nodeset->trace = loader->trace;
+    return true;
+}
+
+void
+NodesetLoader_enableTiming(NodesetLoader *loader) {
+    loader->timePhases = true;
+}
+
+bool
+NodesetLoader_timesPhases(const NodesetLoader *loader) {
+    return loader->timePhases;
+}
+
+bool
+NodesetLoader_tracesNodes(const NodesetLoader *loader) {
+    return loader->trace && loader->trace->slowNodeThreshold > 0;
+}
+
+void
+NodesetLoader_traceNode(NodesetLoader *loader, const NL_Node *node,
+                        NL_Phase phase, UA_DateTime begin) {
+    if(!NodesetLoader_tracesNodes(loader))
+        return;
+    UA_DateTime end = UA_DateTime_nowMonotonic();
+    if(end - begin < loader->trace->slowNodeThreshold)
+        return;
+    char buf[128];
+    memset(buf, 0, sizeof(buf));
+    UA_String idBuf = {sizeof(buf) - 1, (UA_Byte *)buf};
+    UA_NodeId_print(&node->id, &idBuf);
+    Trace_add(loader->trace, NL_PHASE_NAME[phase], buf, begin, end);
+}
+
+bool
+NodesetLoader_writeTrace(const NodesetLoader *loader, const char *path) {
+    if(!loader->trace)
+        return false;
+    FILE *f = fopen(path, "w");
+    if(!f)
+        return false;
+    bool res = Trace_write(loader->trace, f);
+    if(fclose(f) != 0)
+        res = false;
+    return res;
+}
+
+void
+NodesetLoader_getStats(const NodesetLoader *loader, NL_Stats *stats) {
+    memset(stats, 0, sizeof(NL_Stats));
+    memcpy(stats->phases, loader->times, sizeof(loader->times));
+    memcpy(stats->memory, loader->memory.usage, sizeof(loader->memory.usage));
+    memcpy(stats->nodeBytes, loader->memory.nodeBytes,
+           sizeof(loader->memory.nodeBytes));
+    memcpy(stats->peakRssKb, loader->peakRssKb, sizeof(loader->peakRssKb));
+    const Nodeset *nodeset = loader->nodeset;
+    if(!nodeset)
+        return;
+    // The sort moves the nodes out of the per class containers
+    const NodeContainer *all = &nodeset->allNodes;
+    for(size_t i = 0; i < all->size; i++)
+        stats->nodes[all->nodes[i]->nodeClass]++;
+    size_t nodes = all->size;
+    stats->references = nodeset->referencesSize;
+    stats->aliases = nodeset->aliasesSize;
+    stats->charArenaBytes = CharArenaAllocator_allocatedBytes(nodeset->charArena);
+
+    // The arena is measured, as it is not tracked per allocation
+    NL_MemoryUsage *arena = &stats->memory[NL_MEMORY_ARENA];
+    arena->live = CharArenaAllocator_regionBytes(nodeset->charArena);
+    if(arena->live > arena->peak)
+        arena->peak = arena->live;
+    if(nodes > 0) {
+        size_t nodeMemory = stats->memory[NL_MEMORY_NODES].live + arena->live +
+                            stats->memory[NL_MEMORY_DATATYPES].live +
+                            stats->memory[NL_MEMORY_VALUES].live;
+        stats->bytesPerNode = (double)nodeMemory / (double)nodes;
+    }
+    if(stats->references > 0)
+        stats->bytesPerReference =
+            (double)stats->memory[NL_MEMORY_REFERENCES].live /
+            (double)stats->references;
+}
+
+void
+NodesetLoader_trackAlloc(NodesetLoader *loader, NL_MemoryCategory category,
+                         size_t bytes) {
+    MemoryAccount_alloc(&loader->memory, category, bytes);
+}
+
+void
+NodesetLoader_trackFree(NodesetLoader *loader, NL_MemoryCategory category,
+                        size_t bytes) {
+    MemoryAccount_free(&loader->memory, category, bytes);
+}
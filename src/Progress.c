@@ -0,0 +1,32 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "Progress.h"
+
+bool
+Progress_report(Progress *p) {
+    if(!p)
+        return true;
+    p->steps = 0;
+    if(p->canceled)
+        return false;
+    if(p->callback && !p->callback(p->context, &p->progress))
+        p->canceled = true;
+    return !p->canceled;
+}
+
+bool
+Progress_step(Progress *p) {
+    if(!p)
+        return true;
+    if(++p->steps < PROGRESS_INTERVAL)
+        return !p->canceled;
+    return Progress_report(p);
+}
+
+bool
+Progress_canceled(const Progress *p) {
+    return (p && p->canceled);
+}
@@ -0,0 +1,32 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include "NodesetLoader/NodesetLoader.h"
+
+/* Progress of an import and its cancellation. The counters are updated by
+ * the components, the callback is called every PROGRESS_INTERVAL steps. The
+ * functions accept a NULL progress, so components can be used without it. */
+
+#define PROGRESS_INTERVAL 256
+
+typedef struct {
+    NL_ProgressCallback callback; /* NULL: nothing is reported */
+    void *context;
+    NL_Progress progress;
+    size_t steps; /* since the last report */
+    bool canceled;
+} Progress;
+
+/* Counts a step and reports every PROGRESS_INTERVAL steps. Returns false
+ * once the import is canceled. */
+bool Progress_step(Progress *p);
+/* Reports now. Returns false once the import is canceled. */
+bool Progress_report(Progress *p);
+bool Progress_canceled(const Progress *p);
+
+#endif
@@ -0,0 +1,90 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "Trace.h"
+
+Trace *
+Trace_new(UA_DateTime slowNodeThreshold) {
+    Trace *trace = (Trace *)calloc(1, sizeof(Trace));
+    if(!trace)
+        return NULL;
+    trace->slowNodeThreshold = slowNodeThreshold;
+    return trace;
+}
+
+void
+Trace_delete(Trace *trace) {
+    if(!trace)
+        return;
+    for(size_t i = 0; i < trace->eventsSize; i++)
+        free(trace->events[i].detail);
+    free(trace->events);
+    free(trace);
+}
+
+bool
+Trace_add(Trace *trace, const char *name, const char *detail,
+          UA_DateTime begin, UA_DateTime end) {
+    if(trace->eventsSize == trace->eventsCapacity) {
+        size_t capacity =
+            (trace->eventsCapacity > 0) ? trace->eventsCapacity * 2 : 256;
+        TraceEvent *events = (TraceEvent *)
+            realloc(trace->events, capacity * sizeof(TraceEvent));
+        if(!events)
+            return false;
+        trace->events = events;
+        trace->eventsCapacity = capacity;
+    }
+    TraceEvent *e = &trace->events[trace->eventsSize];
+    e->name = name;
+    e->detail = NULL;
+    e->begin = begin;
+    e->end = end;
+    if(detail) {
+        size_t len = strlen(detail);
+        e->detail = (char *)malloc(len + 1);
+        if(!e->detail)
+            return false;
+        memcpy(e->detail, detail, len + 1);
+    }
+    trace->eventsSize++;
+    return true;
+}
+
+static void
+writeEscaped(FILE *file, const char *s) {
+    for(; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if(c == '"' || c == '\\')
+            fprintf(file, "\\%c", c);
+        else if(c < 0x20)
+            fprintf(file, "\\u%04x", c);
+        else
+            fputc(c, file);
+    }
+}
+
+bool
+Trace_write(const Trace *trace, FILE *file) {
+    fprintf(file, "{\"traceEvents\":[");
+    for(size_t i = 0; i < trace->eventsSize; i++) {
+        const TraceEvent *e = &trace->events[i];
+        // Complete events with the timestamps in microseconds
+        fprintf(file,
+                "%s\n{\"name\":\"%s\",\"cat\":\"nodesetloader\",\"ph\":\"X\","
+                "\"ts\":%.1f,\"dur\":%.1f,\"pid\":1,\"tid\":1",
+                (i > 0) ? "," : "", e->name,
+                (double)e->begin / UA_DATETIME_USEC,
+                (double)(e->end - e->begin) / UA_DATETIME_USEC);
+        if(e->detail) {
+            fprintf(file, ",\"args\":{\"detail\":\"");
+            writeEscaped(file, e->detail);
+            fprintf(file, "\"}");
+        }
+        fprintf(file, "}");
+    }
+    fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    return !ferror(file);
+}
@@ -0,0 +1,36 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "NodesetLoader/NodesetLoader.h"
+
+/* Recorded begin/end events of an import. Written as Chrome trace JSON that
+ * can be loaded into Perfetto or chrome://tracing. The timestamps are taken
+ * from UA_DateTime_nowMonotonic. */
+
+typedef struct {
+    const char *name; /* static string */
+    char *detail;     /* optional, owned */
+    UA_DateTime begin;
+    UA_DateTime end;
+} TraceEvent;
+
+typedef struct {
+    TraceEvent *events;
+    size_t eventsSize;
+    size_t eventsCapacity;
+    UA_DateTime slowNodeThreshold; /* 0: no node events */
+} Trace;
+
+Trace *Trace_new(UA_DateTime slowNodeThreshold);
+void Trace_delete(Trace *trace);
+/* The detail is copied */
+bool Trace_add(Trace *trace, const char *name, const char *detail,
+               UA_DateTime begin, UA_DateTime end);
+bool Trace_write(const Trace *trace, FILE *file);
+
+#endif
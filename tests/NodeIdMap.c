@@ -0,0 +1,65 @@
+#include "NodeIdMap.h"
+#include "NodesetLoader/NodesetLoader.h"
+#include "check.h"
+#include <stdio.h>
+
+START_TEST(emptyMap) {
+    NodeIdMap map;
+    NodeIdMap_init(&map, 10);
+    UA_NodeId id = UA_NODEID_NUMERIC(0, 34);
+    ck_assert(!NodeIdMap_contains(&map, &id));
+    ck_assert(NodeIdMap_get(&map, &id) == NULL);
+    NodeIdMap_clear(&map);
+}
+END_TEST
+
+START_TEST(insertAndGrow) {
+    NodeIdMap map;
+    NodeIdMap_init(&map, 1);
+    int values[1000];
+    for(int i = 0; i < 1000; i++) {
+        UA_NodeId id = UA_NODEID_NUMERIC(1, (UA_UInt32)i);
+        ck_assert(NodeIdMap_insert(&map, &id, &values[i]));
+    }
+    ck_assert(map.size == 1000);
+    for(int i = 0; i < 1000; i++) {
+        UA_NodeId id = UA_NODEID_NUMERIC(1, (UA_UInt32)i);
+        ck_assert(NodeIdMap_get(&map, &id) == &values[i]);
+    }
+    UA_NodeId other = UA_NODEID_NUMERIC(2, 1);
+    ck_assert(!NodeIdMap_contains(&map, &other));
+    NodeIdMap_clear(&map);
+}
+END_TEST
+
+START_TEST(stringKeysAreCopied) {
+    NodeIdMap map;
+    NodeIdMap_init(&map, 10);
+    char name[] = "nodeA";
+    UA_NodeId id = UA_NODEID_STRING(1, name);
+    ck_assert(NodeIdMap_insert(&map, &id, NULL));
+    ck_assert(NodeIdMap_insert(&map, &id, NULL));
+    ck_assert(map.size == 1);
+    name[0] = 'x';
+    UA_NodeId lookup = UA_NODEID_STRING(1, "nodeA");
+    ck_assert(NodeIdMap_contains(&map, &lookup));
+    NodeIdMap_clear(&map);
+}
+END_TEST
+
+int main(void) {
+    Suite *s = suite_create("NodeIdMap tests");
+    TCase *tc = tcase_create("test cases");
+    tcase_add_test(tc, emptyMap);
+    tcase_add_test(tc, insertAndGrow);
+    tcase_add_test(tc, stringKeysAreCopied);
+    suite_add_tcase(s, tc);
+
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? 0 : -1;
+}